@@ -30,6 +30,8 @@
 #include "db/db.h"
 #include "nsrr-remap.h"
 #include "helper/token-eval.h"
+#include "helper/mapped.h"
+#include "helper/threads.h"
 
 #include <string>
 #include <fstream>
@@ -475,6 +477,57 @@ bool annot_t::process_special( const std::string & , const std::string & )
   return true;
 }
 
+//
+// Read-ahead of annotation files (e.g. all files in an annotation
+// folder) by parallel workers; load() then parses from memory
+//
+
+static std::map<std::string,mapped_file_t*> prefetched;
+
+void annot_t::prefetch( const std::vector<std::string> & files )
+{
+
+  // drop anything not consumed from a prior call (e.g. skipped .ftr)
+  std::map<std::string,mapped_file_t*>::iterator pp = prefetched.begin();
+  while ( pp != prefetched.end() ) { delete pp->second; ++pp; }
+  prefetched.clear();
+  
+  std::vector<mapped_file_t*> m( files.size() , NULL );
+  
+  Helper::parallel_for( files.size() , [&]( int i ) {
+      // XML is handled separately (tinyxml), so skip here
+      if ( Helper::file_extension( files[i] , "xml" ) ) return;
+      mapped_file_t * mf = new mapped_file_t;
+      if ( mf->open( files[i] ) ) { mf->touch(); m[i] = mf; } 
+      else delete mf;
+    } );
+
+  for (int i=0; i<files.size(); i++)
+    if ( m[i] != NULL )
+      {
+	if ( prefetched.find( files[i] ) != prefetched.end() ) delete m[i];
+	else prefetched[ files[i] ] = m[i];
+      }
+}
+
+// take a prefetched file (caller then owns it), otherwise open now
+static mapped_file_t * open_mapped( const std::string & f )
+{
+  std::map<std::string,mapped_file_t*>::iterator ii = prefetched.find( f );
+  if ( ii != prefetched.end() )
+    {
+      mapped_file_t * mf = ii->second;
+      prefetched.erase( ii );
+      return mf;
+    }
+  
+  mapped_file_t * mf = new mapped_file_t;
+  if ( ! mf->open( f ) )
+    Helper::halt( "could not open " + f );
+  return mf;
+}
+
+
 bool annot_t::load( const std::string & f , edf_t & parent_edf )
 {
 
@@ -522,19 +575,23 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
   if ( is_eannot && ! parent_edf.header.continuous ) 
     Helper::halt( "cannot use .eannot files with discontinuous (EDF+) files" );
 
+  //
+  // whole file in memory (mapped), to be parsed line-by-line below
+  //
+
+  mapped_file_t * mf = open_mapped( f );
+  
   // otherwise, need to figure this out by looking at the file?
   
   if ( ! ( is_eannot || is_annot ) )
     {
-      std::ifstream IN1( f.c_str() , std::ios::in );
 
       while ( 1 )
 	{
 	  
 	  std::string x;
-	  Helper::safe_getline( IN1 , x );
 
-	  if ( IN1.eof() ) break;
+	  if ( ! mf->getline( x ) ) break;
 
 	  // no blank lines allowed for .eannot, so assume .annot if so
 	  // which is more flexible
@@ -565,7 +622,7 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
 	    }
 	}
 
-      IN1.close();
+      mf->rewind();
 
       // hmm, not sure what this file is...
       if ( is_annot == is_eannot )
@@ -582,12 +639,9 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
     {
       std::vector<std::string> a;
       
-      std::ifstream IN1( f.c_str() , std::ios::in );
-      while ( ! IN1.eof() )
+      std::string x;
+      while ( mf->getline( x ) )
 	{
-	  std::string x;
-	  Helper::safe_getline( IN1 , x );
-	  if ( IN1.eof() ) break;
 	  if ( x == "" ) continue;
 
 	  // sanitize?
@@ -605,7 +659,8 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
 	  // store
 	  a.push_back( y );
 	}
-      IN1.close();
+
+      delete mf;
 
       annot_t::map_epoch_annotations( parent_edf , 
 				      a , 
@@ -625,8 +680,6 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
   // Otherwise, this is an .annot file   
   //
 
-  
-  std::ifstream FIN( f.c_str() , std::ios::in );
 
   // header with # character
   
@@ -681,24 +734,27 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
   // to allow '...' in the second line, we need to read ahead
   // and so store the read line here
   std::string buffer = "";
+
+  // current line, and its fields: reused across rows, so that
+  // (once they have grown) parsing a row does not allocate
+  std::string line;
+  std::vector<std::string> tok;
+  std::vector<std::string> ntok;
   
-  while ( ! FIN.eof() )
+  while ( 1 )
     {
       
-      if ( FIN.bad() ) continue;
-      std::string line;      
-
-      // read from buffer or disk?
+      // read from buffer or file?
       if ( buffer != "" )
 	{
-	  line = buffer;
+	  line.swap( buffer );
 	  // now clear buffer
-	  buffer = "";
+	  buffer.clear();
 	}
-      else // get fresh line from disk
-	Helper::safe_getline( FIN , line );      
+      else if ( ! mf->getline( line ) ) // get fresh line
+	break;
 
-      if ( FIN.eof() || line == "" ) continue;
+      if ( line == "" ) continue;
       
       //
       // header or data row? , or type header (optionally, this is skipped)  
@@ -889,9 +945,10 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
 	  
 	  // data-rows are tab-delimited typically, but optionally allow spaces; also allow these to be quoted
 	  
-	  std::vector<std::string> tok = globals::allow_space_delim ? 
-	    Helper::quoted_parse( line , " \t" ) :
-	    Helper::parse( line , "\t" );
+	  if ( globals::allow_space_delim ) 
+	    tok = Helper::quoted_parse( line , " \t" );
+	  else
+	    Helper::char_split( line , '\t' , &tok );
 	  
 	  if ( tok.size() == 0 ) continue; 
 
@@ -1135,14 +1192,9 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
 	  if ( readon )
 	    {
 	      
-	      if ( FIN.bad() )
-		Helper::halt( "problem reading from " + f );
-
 	      // read into the read-ahead buffer
-	      Helper::safe_getline( FIN , buffer );
-	      
 	      // was this the last line?
-	      if ( FIN.eof() )
+	      if ( ! mf->getline( buffer ) )
 		{		  
 		  // setting stop to 1 time-point past the last accessible
 		  // time-point in the EDF/EDF+
@@ -1150,7 +1202,10 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
 		}
 	      else
 		{
-		  std::vector<std::string> ntok = Helper::parse( buffer , globals::allow_space_delim ? " \t" : "\t" );
+		  if ( globals::allow_space_delim ) 
+		    ntok = Helper::parse( buffer , " \t" );
+		  else
+		    Helper::char_split( buffer , '\t' , &ntok );
 		  
 		  if ( ntok.size() == 0 ) 
 		    Helper::halt( "invalid line following '...' end timepoint" );
@@ -1362,7 +1417,7 @@ bool annot_t::load( const std::string & f , edf_t & parent_edf )
       
     } // next line
 
-  FIN.close();
+  delete mf;
   
   return line_count;
 }
@@ -1552,16 +1607,14 @@ interval_t annot_t::get_interval( const std::string & line ,
       std::string stop_str = is_elapsed_hhmmss_stop ? 
 	tok[4].substr(2) : tok[4] ;
       
-      // get :-delimited hh:mm:ss values ( potentially stripping [ and ] from start/end
-      std::vector<std::string> tok_start_hms = Helper::parse( start_str , ":" );
+      // count :-delimited hh:mm:ss values ( potentially stripping [ and ] from start/end
+      const int n_start_hms = Helper::char_count_fields( start_str , ':' );
 
-      std::vector<std::string> tok_stop_hms;
-      if ( ! ( *readon || col2dur ) ) 
-	tok_stop_hms = Helper::parse( stop_str  , ":" );
+      const int n_stop_hms = ( *readon || col2dur ) ? 0 : Helper::char_count_fields( stop_str , ':' );
       
       // does this look like hh:mm:ss or dd:hh:mm:ss?   (nb can be hh:mm:ss.ssss) 
-      bool is_hms1 = tok_start_hms.size() == 3 || tok_start_hms.size() == 4; 
-      bool is_hms2 = ( *readon || col2dur ) ? false : ( tok_stop_hms.size() == 3 || tok_stop_hms.size() == 4 );
+      bool is_hms1 = n_start_hms == 3 || n_start_hms == 4; 
+      bool is_hms2 = ( *readon || col2dur ) ? false : ( n_stop_hms == 3 || n_stop_hms == 4 );
 
       // if so, check that there is a valid EDF header starttime
       if ( is_hms1 && (!is_elapsed_hhmmss_start) && ( !starttime.valid) )
@@ -1704,7 +1757,7 @@ int annot_t::load_features( const std::string & f )
   
   // logger << " attaching feature-list file " << f << "\n";
   
-  std::ifstream FIN( f.c_str() , std::ios::in );
+  mapped_file_t * mf = open_mapped( f );
   
   int line_count = 0;
   
@@ -1714,16 +1767,15 @@ int annot_t::load_features( const std::string & f )
   // with special values  _rgb=255,255,255
   //                      _value={float}
 
-  while ( ! FIN.eof() )
+  std::string line;
+  std::vector<std::string> tok;
+  
+  while ( mf->getline( line ) )
     {
       
-      if ( FIN.bad() ) continue;
-      std::string line;      
-      Helper::safe_getline( FIN , line );      
-      if ( FIN.eof() || line == "" ) continue;
+      if ( line == "" ) continue;
       
-      std::vector<std::string> tok = Helper::parse( line , "\t" );
-      const int n = tok.size();
+      const int n = Helper::char_split( line , '\t' , &tok );
       if ( n < 3 ) continue;
       
       feature_t feature;
@@ -1791,7 +1843,7 @@ int annot_t::load_features( const std::string & f )
   
   //  logger << "  processed " << line_count << " lines\n";
   
-  FIN.close();
+  delete mf;
   
   return line_count;
 
@@ -2121,32 +2173,114 @@ void annot_t::dumpxml( const std::string & filename , bool basic_dumper )
  
 }
 
-bool annot_t::loadxml( const std::string & filename , edf_t * edf )
-{
-
-  XML xml( filename );
+//
+// XML annotations are read with a streaming parser (xml_stream_t):
+// each ScoredEvent / SleepStage (NSRR, Profusion) or Class / Instance
+// (Luna) is processed as soon as its end-tag is reached, and then
+// freed, i.e. no document tree is built for the whole file
+//
 
-  if ( ! xml.valid() ) Helper::halt( "invalid annotation file: " + filename );
+struct xml_annot_loader_t : public xml_handler_t 
+{
 
-  //
-  // Determine format: Profusion or NSRR or Luna ? 
-  //
+  enum format_t { UNKNOWN , NSRR , PROFUSION , LUNA } ; 
   
-  std::vector<element_t*> nsrr_format_test = xml.children( "PSGAnnotation" );
-  std::vector<element_t*> luna_format_test = xml.children( "Annotations" );
-  
-  bool profusion_format = nsrr_format_test.size() == 0 ;
-  bool luna_format = luna_format_test.size() > 0 ;
+  xml_annot_loader_t( const std::string & filename , edf_t * edf , format_t format = UNKNOWN ) 
+    : filename( filename ) , edf( edf ) , format( format ) , classes_done( false ) , start_sec( 0 ) , epoch_sec( 30 ) 
+  { } 
 
-  if ( globals::param.has( "profusion" ) ) profusion_format = true;
+  const std::string filename;
   
-  if ( luna_format ) return loadxml_luna( filename , edf );
+  edf_t * edf;
 
-  const std::string EventConcept = profusion_format ? "Name"           : "EventConcept" ;
-  const std::string epoch_parent = profusion_format ? "CMPStudyConfig" : "PSGAnnotation" ;
-  
+  format_t format;
+
+  // annotations added (NSRR/Profusion)
+  std::set<std::string> added;
+
+  // Luna format: Instances seen before the Classes are defined
+  bool classes_done;
+  std::vector<element_t*> deferred;
+
+  // Profusion sleep-stages: assume 30-second epochs, starting from 0...
+  int start_sec;
+  int epoch_sec;
   
-  std::vector<element_t*> scored = xml.children( "ScoredEvents" );
+  void open( const element_t * e )
+  {
+    
+    if ( format != UNKNOWN ) return;
+
+    //
+    // Determine format from the root element: Profusion or NSRR or Luna ? 
+    //
+    
+    if ( Helper::iequals( e->name , "Annotations" ) ) format = LUNA;
+    else if ( Helper::iequals( e->name , "PSGAnnotation" ) ) format = NSRR;
+    else format = PROFUSION;
+
+    if ( format == NSRR && globals::param.has( "profusion" ) ) format = PROFUSION;
+    
+  }
+
+  bool close( element_t * e )
+  {
+
+    const element_t * parent = e->parent;
+    
+    if ( parent == NULL ) return true;
+    
+    if ( format == LUNA )
+      {
+	
+	if ( Helper::iequals( parent->name , "Classes" ) && Helper::iequals( e->name , "Class" ) )
+	  {
+	    luna_class( e );
+	    return false;
+	  }
+
+	if ( Helper::iequals( e->name , "Classes" ) ) 
+	  classes_done = true;
+	
+	if ( Helper::iequals( parent->name , "Instances" ) )
+	  {
+	    if ( ! classes_done ) return true;
+	    luna_instance( e );
+	    return false;
+	  }
+	
+	if ( Helper::iequals( e->name , "Instances" ) && e->child.size() ) 
+	  deferred.push_back( e );
+
+	return true;
+      }
+
+    //
+    // NSRR / Profusion
+    //
+    
+    if ( Helper::iequals( parent->name , "ScoredEvents" ) ) 
+      {
+	if ( Helper::iequals( e->name , "ScoredEvent" ) ) scored_event( e );
+	return false;
+      }
+    
+    if ( format == PROFUSION && Helper::iequals( parent->name , "SleepStages" ) )
+      {
+	if ( e->name == "SleepStage" ) sleep_stage( e );
+	return false;
+      }
+    
+    return true;
+  }
+
+  void finish( element_t * root )
+  {
+    // Luna format instances preceding the class definitions
+    for (int i=0; i<deferred.size(); i++)
+      for (int j=0; j<deferred[i]->child.size(); j++)
+	luna_instance( deferred[i]->child[j] );
+  }
   
 
   //
@@ -2168,324 +2302,443 @@ bool annot_t::loadxml( const std::string & filename , edf_t * edf )
   // children elements 'SleepStage' == integer
   // ASSUME these are 30-s epochs, starting at 0
   
+  void scored_event( element_t * e )
+  {
 
-  //
-  // First pass through all 'ScoredEvent's,, creating each annotation
-  //
+    const std::string EventConcept = format == PROFUSION ? "Name" : "EventConcept" ;
+    
+    element_t * concept  = (*e)( EventConcept );
+    if ( concept == NULL ) concept = (*e)( "name" );
+    
+    if ( concept == NULL ) return;
+    
+    // skip this..
+    if ( concept->value == "Recording Start Time" ) return;
+    
+    // annotation remap?
+    std::string original_label = concept->value;
+    concept->value = nsrr_t::remap( concept->value );
+    if ( concept->value == "" ) return;
+    
+    // are we checking whether to add this file or no? 
+    if ( globals::specified_annots.size() > 0 && 
+	 globals::specified_annots.find( concept->value ) == globals::specified_annots.end() ) return;
+    
+    // not already found? add 
+    
+    if ( added.find( concept->value ) == added.end() ) 
+      {
+	if ( original_label != concept->value )
+	  edf->timeline.annotations.aliasing[ concept->value ] = original_label ;
+	
+	annot_t * a = edf->timeline.annotations.add( concept->value );
+	a->description = "XML-derived";
+	a->file = filename;
+	a->type = globals::A_FLAG_T; // not expecting any meta-data
+	added.insert( concept->value );
+      }
+
+    //
+    // now add this instance
+    //
+    
+    element_t * start    = (*e)( "Start" );
+    if ( start == NULL ) start = (*e)( "time" );
+    
+    element_t * duration = (*e)( "Duration" );
+    element_t * notes    = (*e)( "Notes" );
+    element_t * signal   = (*e)( "SignalLocation" );
+    
+    if ( start == NULL || duration == NULL ) return;
+    
+    // Luna format XML can also specify the channel
+    element_t * channel = (*e)( "Channel" );
+    
+    // otherwise, add 
+    double start_sec, duration_sec;
+    if ( ! Helper::str2dbl( start->value , &start_sec ) ) Helper::halt( "bad value in annotation" );
+    if ( ! Helper::str2dbl( duration->value , &duration_sec ) ) Helper::halt( "bad value in annotation" );
+    
+    uint64_t start_tp = Helper::sec2tp( start_sec );
+    
+    // stop is defined as 1 unit past the end of the interval
+    uint64_t stop_tp  = duration_sec > 0 
+      ? start_tp + Helper::sec2tp( duration_sec )
+      : start_tp ; // for zero-point interval (starts and stops at same place)
+    
+    interval_t interval( start_tp , stop_tp );
+    
+    annot_t * a = edf->timeline.annotations.add( concept->value );
+    
+    if ( a == NULL ) Helper::halt( "internal error in loadxml()");
+    
+    std::string sigstr = signal != NULL ? signal->value : ( channel != NULL ? channel->value : "." ) ; 
+    
+    // swap spaces from sigstr (channel label)?
+    if ( globals::replace_channel_spaces )
+      sigstr = Helper::search_replace( sigstr , ' ' , globals::space_replacement );
+    
+    // class name is <ConceptValue> tag, so make instance ID null
+    instance_t * instance = a->add( "."  , interval , sigstr );
+    
+    // any notes?  set as TXT, otherwise it will be listed as a FLAG
+    if ( notes ) 
+      {
+	instance->set( concept->value , notes->value );  
+      }
+    
+    //
+    // any other children of ScoredEvent?  add as string key/value meta-data
+    //
+    
+    const std::vector<element_t*> & kids = e->child;
+    
+    for (int i=0;i<kids.size();i++)
+      {
+	element_t * ee = kids[i];
+	if ( ee->name == "EventConcept" ) continue;
+	if ( ee->name == "EventType" ) continue;
+	if ( ee->name == "Notes" ) continue;
+	if ( ee->name == "Channel" ) continue;
+	if ( ee->name == "SignalLocation" ) continue;
+	if ( ee->name == "Start" ) continue;
+	if ( ee->name == "Duration" ) continue;
+	if ( ee->name == "name" ) continue;
+	if ( ee->name == "time" ) continue;
+	
+	// add as meta-data to this instance
+	instance->set( ee->name , ee->value );
+      }
+    
+  }
 
-  std::set<std::string> added;
   
-  for (int i=0;i<scored.size();i++)
-    {
-      
-      element_t * e = scored[i];
-      
-      if ( ! Helper::iequals( e->name , "ScoredEvent" ) ) continue;
-      
-      element_t * concept  = (*e)( EventConcept );
-      if ( concept == NULL ) concept = (*e)( "name" );
-      
-      if ( concept == NULL ) continue;
-      
-      // skip this..
-      if ( concept->value == "Recording Start Time" ) continue;
-      
-      
-      // annotation remap?
-      std::string original_label = concept->value;
-      concept->value = nsrr_t::remap( concept->value );
-      if ( concept->value == "" ) continue;
-      
-      // are we checking whether to add this file or no? 
-      if ( globals::specified_annots.size() > 0 && 
-	   globals::specified_annots.find( concept->value ) == globals::specified_annots.end() ) continue;
-      
-      // already found?
-      if ( added.find( concept->value ) != added.end() ) continue;
-
-      // otherwise, add
-
-      if ( original_label != concept->value )
-	  edf->timeline.annotations.aliasing[ concept->value ] = original_label ;
+  void sleep_stage( element_t * e )
+  {
 
-      annot_t * a = edf->timeline.annotations.add( concept->value );
-      a->description = "XML-derived";
-      a->file = filename;
-      a->type = globals::A_FLAG_T; // not expecting any meta-data
-      added.insert( concept->value );
-    }
+    std::string ss = "Unscored";
+    if      ( e->value == "0" ) ss = "wake";
+    else if ( e->value == "1" ) ss = "NREM1";
+    else if ( e->value == "2" ) ss = "NREM2";
+    else if ( e->value == "3" ) ss = "NREM3";
+    else if ( e->value == "4" ) ss = "NREM4";
+    else if ( e->value == "5" ) ss = "REM";	 
+    
+    // annotation remap?
+    ss = nsrr_t::remap( ss );
+    if ( ss == "" ) return;
+    
+    // are we checking whether to add this file or no? 
+    
+    if ( globals::specified_annots.size() > 0 && 
+	 globals::specified_annots.find( ss ) == globals::specified_annots.end() ) return;
+    
+    // not already found? add
+    if ( added.find( ss ) == added.end() ) 
+      {
+	annot_t * a = edf->timeline.annotations.add( ss );
+	a->description = "XML-derived";
+	a->file = filename;
+	a->type = globals::A_FLAG_T; // not expecting any meta-data from XML
+	added.insert( ss );
+      }
+    
+    uint64_t start_tp = Helper::sec2tp( start_sec );
+    uint64_t stop_tp  = start_tp + Helper::sec2tp( epoch_sec ) ; // 1-past-end encoding
+    
+    // advance to the next epoch
+    start_sec += epoch_sec;
+    
+    interval_t interval( start_tp , stop_tp );	  
+    
+    annot_t * a = edf->timeline.annotations.add( ss );
+    
+    // . indicates no associated channel
+    instance_t * instance = a->add( ss , interval , "." );      
+    
+    instance->set( ss );
+    
+  }
 
+  
   //
-  // Profusion-formatted sleep-stages?
+  // Luna format: annotation classes
   //
   
-  if ( profusion_format )
-    {
-      
-      std::vector<element_t*> scored = xml.children( "SleepStages" );
-      
-      for (int i=0;i<scored.size();i++)
-	{
-	  element_t * e = scored[i];
+  void luna_class( element_t * cls )
+  {
+    
+    
+    if ( ! Helper::iequals( cls->name , "Class" ) ) return;
+    
+    std::string cls_name = cls->attr.value( "name" );
+    
+    //
+    // alias remapping?
+    //
 
-	  if ( e->name != "SleepStage" ) continue;
-	  
-	  std::string ss = "Unscored";
-	  if      ( e->value == "0" ) ss = "wake";
-	  else if ( e->value == "1" ) ss = "NREM1";
-	  else if ( e->value == "2" ) ss = "NREM2";
-	  else if ( e->value == "3" ) ss = "NREM3";
-	  else if ( e->value == "4" ) ss = "NREM4";
-	  else if ( e->value == "5" ) ss = "REM";	 
+    std::string original_label = cls_name;
+    cls_name = nsrr_t::remap( cls_name );
+    if ( cls_name == "" ) return;
+    
+    //
+    // ignore this annotation?
+    //
+    
+    if ( globals::specified_annots.size() > 0 && 
+	 globals::specified_annots.find( cls_name )
+	 == globals::specified_annots.end() ) return;
 
-	  // annotation remap?
-	  ss = nsrr_t::remap( ss );
-	  if ( ss == "" ) continue;
-	  
-	  // are we checking whether to add this file or no? 
-	  
-	  if ( globals::specified_annots.size() > 0 && 
-	       globals::specified_annots.find( ss ) == globals::specified_annots.end() ) continue;
-	  
-	  // already found?
-	  if ( added.find( ss ) != added.end() ) continue;
-	  
-	  // otherwise, add
-	  annot_t * a = edf->timeline.annotations.add( ss );
-	  a->description = "XML-derived";
-	  a->file = filename;
-	  a->type = globals::A_FLAG_T; // not expecting any meta-data from XML
-	  added.insert( ss );
-	  
-	}
-    }
+    //
+    // track aliasing
+    //
+    
+    if ( cls_name != original_label )
+      edf->timeline.annotations.aliasing[ cls_name ] = original_label ;
+    
+    std::string desc = "";
+    std::map<std::string,std::string> atypes;
 
+    std::vector<element_t*> kids = cls->child;
+    
+    for (int j=0; j<kids.size(); j++)
+      {
+        
+	const std::string & key = kids[j]->name;
+
+	if ( key == "Description" ) 
+	  {
+	    desc = kids[j]->value;
+	  }
+	else if ( key == "Variable" ) 
+	  {
+	    atypes[ kids[j]->value ] = kids[j]->attr.value( "type" );
+	  }
+        
+      }
+
+    
+    //       <Class name="a3">
+    // 	  <Name>a3</Name>
+    // 	  <Description>This annotation also specifies meta-data types</Description>
+    // 	  <Variable type="txt">val1</Variable>
+    // 	  <Variable type="num">val2</Variable>
+    // 	  <Variable type="bool">val3</Variable>
+    //       </Class>
+    
+    //
+    // add this annotation
+    //
+    
+    annot_t * a = edf->timeline.annotations.add( cls_name );
+    
+    a->description = desc;
+    a->file = filename;
+    a->type = globals::A_FLAG_T; // not expecting any meta-data (unless changed below)
+
+    std::map<std::string,std::string>::const_iterator aa = atypes.begin();
+    while ( aa != atypes.end() )
+      {
+	// if a recognizable type, add
+	if ( globals::name_type.find( aa->second ) != globals::name_type.end() )
+	  a->types[ aa->first ] = globals::name_type[ aa->second ];
+	++aa;
+      }
+    
+    // as with .annot files; if only one variable, set annot_t equal to the one instance type
+    // otherwise, set as A_NULL_T ; in practice, don't think we'll ever use annot_t::type 
+    // i.e. will always use annot_t::atypes[]
+
+    if ( a->types.size() == 1 ) a->type = a->types.begin()->second;
+    else if ( a->type > 1 ) a->type = globals::A_NULL_T; 
+    // i.e. multiple variables/types set, so set overall one to null
+  }
 
   
   //
-  // Back through, adding instances now we've added all annotations
+  // Luna format: annotation instances
   //
 
-  for (int i=0;i<scored.size();i++)
-    {
-      
-      element_t * e = scored[i];
-      
-      if ( ! Helper::iequals( e->name , "ScoredEvent" ) ) continue;
-      
-      element_t * concept  = (*e)( EventConcept );
-      if ( concept == NULL ) concept = (*e)( "name" );
-
-      // skip if we are not interested in this element
-      if ( added.find( concept->value ) == added.end() ) continue;
-      
-      element_t * start    = (*e)( "Start" );
-      if ( start == NULL ) start = (*e)( "time" );
-
-      element_t * duration = (*e)( "Duration" );
-      element_t * notes    = (*e)( "Notes" );
-      element_t * signal   = (*e)( "SignalLocation" );
-
-      if ( concept == NULL || start == NULL || duration == NULL ) continue;
-      
+  void luna_instance( element_t * ii )
+  {
 
-      // Luna format XML can also specify the channel
-      element_t * channel = (*e)( "Channel" );
-      
-      // otherwise, add 
-      double start_sec, duration_sec;
-      if ( ! Helper::str2dbl( start->value , &start_sec ) ) Helper::halt( "bad value in annotation" );
-      if ( ! Helper::str2dbl( duration->value , &duration_sec ) ) Helper::halt( "bad value in annotation" );
+    
+    std::string cls_name = ii->attr.value( "class" );
 
-      uint64_t start_tp = Helper::sec2tp( start_sec );
+    //
+    // alias remapping?
+    //
 
-//       uint64_t stop_tp  = duration_sec > 0 
-// 	? start_tp + (uint64_t)( duration_sec * globals::tp_1sec ) - 1LLU 
-// 	: start_tp;
+    std::string original_label = cls_name;
+    cls_name = nsrr_t::remap( cls_name );
+    if ( cls_name == "" ) return;
 
-      // std::cout << "xxx " <<  concept->value << "\t" << start_sec << "\t" << duration_sec << "\t"
-      // 		<< duration_sec * globals::tp_1sec  << "\t" <<  (uint64_t)( duration_sec ) * globals::tp_1sec  << "\n";
-      
-      // stop is defined as 1 unit past the end of the interval
-      uint64_t stop_tp  = duration_sec > 0 
-	? start_tp + Helper::sec2tp( duration_sec )
-	: start_tp ; // for zero-point interval (starts and stops at same place)
-      
-      interval_t interval( start_tp , stop_tp );
-      
-      annot_t * a = edf->timeline.annotations.add( concept->value );
-      
-      if ( a == NULL ) Helper::halt( "internal error in loadxml()");
+    
+    //
+    // ignore this annotation?
+    //
+         
+    if ( globals::specified_annots.size() > 0 && 
+	 globals::specified_annots.find( cls_name ) 
+	 == globals::specified_annots.end() ) return;
 
-      std::string sigstr = signal != NULL ? signal->value : ( channel != NULL ? channel->value : "." ) ; 
+    if ( cls_name != original_label )
+      edf->timeline.annotations.aliasing[ cls_name ] = original_label ;
 
-      // swap spaces from sigstr (channel label)?
-      if ( globals::replace_channel_spaces )
-	sigstr = Helper::search_replace( sigstr , ' ' , globals::space_replacement );
-      
-      //instance_t * instance = a->add( concept->value , interval , sigstr );
-      // class name is <ConceptValue> tag, so make instance ID null
-      instance_t * instance = a->add( "."  , interval , sigstr );
-      
-      // any notes?  set as TXT, otherwise it will be listed as a FLAG
-      if ( notes ) 
-	{
-	  instance->set( concept->value , notes->value );  
-	}
+  
+    //
+    // get a pointer to this class
+    //
 
-      //
-      // any other children of ScoredEvent?  add as string key/value meta-data
-      //
-      
-      const std::vector<element_t*> & kids = e->child;
-      
-      for (int i=0;i<kids.size();i++)
-	{
-          element_t * ee = kids[i];
-	  if ( ee->name == "EventConcept" ) continue;
-	  if ( ee->name == "EventType" ) continue;
-	  if ( ee->name == "Notes" ) continue;
-	  if ( ee->name == "Channel" ) continue;
-	  if ( ee->name == "SignalLocation" ) continue;
-	  if ( ee->name == "Start" ) continue;
-	  if ( ee->name == "Duration" ) continue;
-	  if ( ee->name == "name" ) continue;
-	  if ( ee->name == "time" ) continue;
-
-	  // add as meta-data to this instance
-	  instance->set( ee->name , ee->value );
+    annot_t * a = edf->timeline.annotations.find( cls_name );
+    
+    if ( a == NULL ) return;
+    
+    // pull information for this instance:
+    
+    element_t * name     = (*ii)( "Name" );
+    
+    element_t * start    = (*ii)( "Start" );
+    
+    element_t * duration = (*ii)( "Duration" );
 
-	}
+    element_t * channel  = (*ii)( "Channel" );
+    
+    //
+    // Get time interval
+    //
 
-	       
-      
-    }
+    double dbl_start = 0 , dbl_dur = 0 , dbl_stop = 0;
   
+    if ( ! Helper::str2dbl( start->value , &dbl_start ) )
+      Helper::halt( "invalid interval: " + start->value );
   
-  //
-  // Profusion-formatted sleep-stages?
-  //
-  
-  if ( profusion_format )
-    {
-  
-      std::vector<element_t*> scored = xml.children( "SleepStages" );
-      
-      int start_sec = 0;
-      int epoch_sec = 30;
-
-      // assume 30-second epochs, starting from 0...
-
-      for (int i=0;i<scored.size();i++)
-	{
-	  element_t * e = scored[i];
-
-	  if ( e->name != "SleepStage" ) continue;
-	  
-	  std::string ss = "Unscored";
-	  if      ( e->value == "0" ) ss = "wake";
-	  else if ( e->value == "1" ) ss = "NREM1";
-	  else if ( e->value == "2" ) ss = "NREM2";
-	  else if ( e->value == "3" ) ss = "NREM3";
-	  else if ( e->value == "4" ) ss = "NREM4";
-	  else if ( e->value == "5" ) ss = "REM";	 
-
-	  // annotation remap?
-	  ss = nsrr_t::remap( ss );
-	  if ( ss == "" ) continue;
-	  
-	  // skip if we are not interested in this element
-	  
-	  if ( added.find( ss ) == added.end() ) continue;
-	  
-	  // otherwise, add
-	  
-	  uint64_t start_tp = Helper::sec2tp( start_sec );
-	  uint64_t stop_tp  = start_tp + Helper::sec2tp( epoch_sec ) ; // 1-past-end encoding
-	  
-	  // advance to the next epoch
-	  start_sec += epoch_sec;
-	  
-	  interval_t interval( start_tp , stop_tp );	  
-	  
-	  annot_t * a = edf->timeline.annotations.add( ss );
-		  
-	  // . indicates no associated channel
-	  instance_t * instance = a->add( ss , interval , "." );      
-      
-	  instance->set( ss );
-	  
-	}
+    if ( ! Helper::str2dbl( duration->value , &dbl_dur ) ) 
+      Helper::halt( "invalid interval: " +  duration->value );
+    
+    dbl_stop = dbl_start + dbl_dur; 
             
-    }
+    if ( dbl_start < 0 ) Helper::halt( filename + " contains row(s) with negative time points" ) ;
 
+    if ( dbl_dur < 0 ) Helper::halt( filename + " contains row(s) with negative durations" );
+    
+    // convert to uint64_t time-point units
+    
+    interval_t interval;
 
+    interval.start = Helper::sec2tp( dbl_start );
+    
+    // assume stop is already specified as 1 past the end, e.g. 30 60
+    // *unless* it is a single point, e.g. 5 5 
+    // which is handled below
+    
+    interval.stop  = Helper::sec2tp( dbl_stop );
 
-  //
-  // Misc. test code: have signal descriptions in XMLs
-  //
+    
+    // given interval encoding, we always want one past the end
+    // if a single time-point given (0 duration)
+    //
+    // otherwise, assume 30 second duration means up to 
+    // but not including 30 .. i..e  0-30   30-60   60-90 
+    // in each case, start + duration is the correct value
 
-  if ( false )
-    {
-      std::vector<element_t*> signals = xml.children( "Signals" );
+    if ( interval.start == interval.stop ) ++interval.stop;
 
-      //std::cout << "signals size = " << signals.size() << "\n";
-      
-      for (int i=0; i<signals.size(); i++)
-	{
-	  
-	  element_t * e = signals[i];
-	  
-	  //       cmd_t::signal_alias( str )
-	  // 	"canonical|alias1|alias2"
-	  
-	  element_t * label = (*e)("Label");
-	  element_t * canonical_label = (*e)("CanonicalLabel");
-	  element_t * desc = (*e)("Description");
-	  
-	  if ( label ) std::cout << "label = " << label->value << "\n";
-	  if ( canonical_label ) std::cout << "canon " << canonical_label->value << "\n";
-	  if ( desc ) std::cout << "Desc " << desc->value << "\n";
-	  
-	  if ( label->value != "" && 
-	       canonical_label->value != "" && 
-	       label->value != canonical_label->value )
-	    {
-	      logger << "  changing " << label->value << " to canonical label " << canonical_label->value << "\n";
-	      edf->header.rename_channel( label->value , canonical_label->value );
-	      cmd_t::signal_alias( canonical_label->value + "|" + label->value ); // include this????
-	    }
-	  
-	  std::vector<element_t*> attr = e->children( "Attributes" );
-	  
-	  for (int j=0;j<attr.size();j++)
-	    {
+    //
+    // Create the instance; only add the instance ID/Name if it is different from the class ID
+    //
+  
+    instance_t * instance = a->add( name ? ( name->value != cls_name ? name->value : "." ) : "." , 
+      			      interval ,
+      			      channel ? channel->value : "." );
 
-	      element_t * ee = attr[j];
-	      
-	      if ( ee->name != "Attribute" ) continue;
-	      
-	      element_t * aname = (*ee)( "AttributeKey" );
-	      element_t * aval  = (*ee)( "AttributeValue" );
-	      if ( aname != NULL && aval != NULL ) 
-		std::cout << aname->value << " = " << aval->value << "\n";
-	      
-	    }
-	
-	  // Signal
-	  //  -Label
-	  //  -CanonicalLabel
-	  //  -Description
-	  //  -Attributes
-	  //    Attribute
-	  //     -AttrinuteKey 
-	  //     -AttributeLabel      
-	  
-	}
-    }
+    //
+    // Add any additional data members
+    //
+
+    std::vector<element_t*> kids = ii->child;
+    
+    for (int j=0; j<kids.size(); j++) 
+      {
+        
+	const std::string & key = kids[j]->name;
+        
+	if ( key == "Value" ) 
+	  {
+	    std::string var = kids[j]->attr.value( "name" );
+	    std::string val = kids[j]->value;
+            
+	    if ( a->types.find( var ) != a->types.end() ) 
+      	{
+      	  
+      	  globals::atype_t t = a->types[ var ];
+            
+      	  if ( t == globals::A_FLAG_T ) 
+      	    {
+      	      instance->set( var );
+      	    }
+      	  
+      	  else if ( t == globals::A_MASK_T )
+      	    {
+      	      if ( var != "." )
+      		{
+      		  // accepts F and T as well as long forms (false, true)
+      		  instance->set_mask( var , Helper::yesno( val ) );
+      		}
+      	    }
+      	  
+      	  else if ( t == globals::A_BOOL_T )
+      	    {
+      	      if ( val != "." )
+      		{
+      		  // accepts F and T as well as long forms (false, true)
+      		  instance->set( var , Helper::yesno( val ) );
+      		}
+      	    }
+      	  
+      	  else if ( t == globals::A_INT_T )
+      	    {
+      	      int value = 0;
+      	      if ( ! Helper::str2int( val , &value ) )
+      		Helper::halt( "bad numeric value in " + filename );
+      	      instance->set( var , value );
+      	    }
+
+      	  else if ( t == globals::A_DBL_T )
+      	    {
+      	      double value = 0;
+      	      
+      	      if ( Helper::str2dbl( val , &value ) )		    
+      		instance->set( var , value );
+      	      else
+      		if ( var != "." && var != "NA" ) 
+      		  Helper::halt( "bad numeric value in " + filename );		  
+      	    }
+      	  
+      	  else if ( t == globals::A_TXT_T )
+      	    {
+      	      instance->set( var , val );
+      	    }
+      	  
+      	}
+
+	  } // added this data member
+        
+      }
+   
+  }
+  
+};
 
 
+bool annot_t::loadxml( const std::string & filename , edf_t * edf )
+{
 
+  xml_annot_loader_t loader( filename , edf );
+  
+  if ( ! xml_stream_t::read( filename , &loader ) )
+    Helper::halt( "invalid annotation file: " + filename );
+  
   return true;
 }
 
@@ -3468,300 +3721,18 @@ void annotation_set_t::write( const std::string & filename , param_t & param , e
 
 bool annot_t::loadxml_luna( const std::string & filename , edf_t * edf )
 {
-  
-  XML xml( filename );
-  
-  if ( ! xml.valid() ) Helper::halt( "invalid annotation file: " + filename );
-
-  //
-  // Annotation classes
-  //
-  
-  std::vector<element_t*> classes = xml.children( "Classes" );
-
-  std::set<std::string> added;
-  
-  for (int i=0;i<classes.size();i++)
-    {
-      
-      element_t * cls = classes[i];
-      
-      if ( ! Helper::iequals( cls->name , "Class" ) ) continue;
-      
-      std::string cls_name = cls->attr.value( "name" );
-      
-      //
-      // alias remapping?
-      //
-
-      std::string original_label = cls_name;
-      cls_name = nsrr_t::remap( cls_name );
-      if ( cls_name == "" ) continue;
-      
-      //
-      // ignore this annotation?
-      //
-      
-      if ( globals::specified_annots.size() > 0 && 
-	   globals::specified_annots.find( cls_name )
-	   == globals::specified_annots.end() ) continue;
-
-      //
-      // track aliasing
-      //
-      
-      if ( cls_name != original_label )
-	edf->timeline.annotations.aliasing[ cls_name ] = original_label ;
-      
-      std::string desc = "";
-      std::map<std::string,std::string> atypes;
-
-      std::vector<element_t*> kids = cls->child;
-      
-      for (int j=0; j<kids.size(); j++)
-        {
-	  
-          const std::string & key = kids[j]->name;
-
-	  if ( key == "Description" ) 
-	    {
-	      desc = kids[j]->value;
-	    }
-	  else if ( key == "Variable" ) 
-	    {
-	      atypes[ kids[j]->value ] = kids[j]->attr.value( "type" );
-	    }
-	  
-        }
-
-      
-      //       <Class name="a3">
-      // 	  <Name>a3</Name>
-      // 	  <Description>This annotation also specifies meta-data types</Description>
-      // 	  <Variable type="txt">val1</Variable>
-      // 	  <Variable type="num">val2</Variable>
-      // 	  <Variable type="bool">val3</Variable>
-      //       </Class>
-      
-      //
-      // add this annotation
-      //
-      
-      annot_t * a = edf->timeline.annotations.add( cls_name );
-      
-      a->description = desc;
-      a->file = filename;
-      a->type = globals::A_FLAG_T; // not expecting any meta-data (unless changed below)
-
-      std::map<std::string,std::string>::const_iterator aa = atypes.begin();
-      while ( aa != atypes.end() )
-	{
-	  // if a recognizable type, add
-	  if ( globals::name_type.find( aa->second ) != globals::name_type.end() )
-	    a->types[ aa->first ] = globals::name_type[ aa->second ];
-	  ++aa;
-	}
-      
-      // as with .annot files; if only one variable, set annot_t equal to the one instance type
-      // otherwise, set as A_NULL_T ; in practice, don't think we'll ever use annot_t::type 
-      // i.e. will always use annot_t::atypes[]
-
-      if ( a->types.size() == 1 ) a->type = a->types.begin()->second;
-      else if ( a->type > 1 ) a->type = globals::A_NULL_T; 
-      // i.e. multiple variables/types set, so set overall one to null
-
-    }
-
 
-  //
-  // Annotation Instances
-  //
+  xml_annot_loader_t loader( filename , edf , xml_annot_loader_t::LUNA );
   
-  std::vector<element_t*> instances = xml.children( "Instances" );
-  
-
-  //
-  // First pass through all instances
-  //
-  
-  for (int i=0; i<instances.size(); i++) 
-    {
-      
-      element_t * ii = instances[i];
-      
-      std::string cls_name = ii->attr.value( "class" );
-
-      //
-      // alias remapping?
-      //
-
-      std::string original_label = cls_name;
-      cls_name = nsrr_t::remap( cls_name );
-      if ( cls_name == "" ) continue;
-
-      
-      //
-      // ignore this annotation?
-      //
-           
-      if ( globals::specified_annots.size() > 0 && 
-	   globals::specified_annots.find( cls_name ) 
-	   == globals::specified_annots.end() ) continue;
-
-      if ( cls_name != original_label )
-	edf->timeline.annotations.aliasing[ cls_name ] = original_label ;
-
-    
-      //
-      // get a pointer to this class
-      //
-
-      annot_t * a = edf->timeline.annotations.find( cls_name );
-      
-      if ( a == NULL ) continue;
-      
-      // pull information for this instance:
-      
-      element_t * name     = (*ii)( "Name" );
-      
-      element_t * start    = (*ii)( "Start" );
-      
-      element_t * duration = (*ii)( "Duration" );
-
-      element_t * channel  = (*ii)( "Channel" );
-      
-      //
-      // Get time interval
-      //
-
-      double dbl_start = 0 , dbl_dur = 0 , dbl_stop = 0;
-    
-      if ( ! Helper::str2dbl( start->value , &dbl_start ) )
-	Helper::halt( "invalid interval: " + start->value );
-    
-      if ( ! Helper::str2dbl( duration->value , &dbl_dur ) ) 
-	Helper::halt( "invalid interval: " +  duration->value );
-      
-      dbl_stop = dbl_start + dbl_dur; 
-	      
-      if ( dbl_start < 0 ) Helper::halt( filename + " contains row(s) with negative time points" ) ;
-
-      if ( dbl_dur < 0 ) Helper::halt( filename + " contains row(s) with negative durations" );
-      
-      // convert to uint64_t time-point units
-      
-      interval_t interval;
-
-      interval.start = Helper::sec2tp( dbl_start );
-      
-      // assume stop is already specified as 1 past the end, e.g. 30 60
-      // *unless* it is a single point, e.g. 5 5 
-      // which is handled below
-      
-      interval.stop  = Helper::sec2tp( dbl_stop );
-
-      
-      // given interval encoding, we always want one past the end
-      // if a single time-point given (0 duration)
-      //
-      // otherwise, assume 30 second duration means up to 
-      // but not including 30 .. i..e  0-30   30-60   60-90 
-      // in each case, start + duration is the correct value
-
-      if ( interval.start == interval.stop ) ++interval.stop;
-
-      //
-      // Create the instance; only add the instance ID/Name if it is different from the class ID
-      //
-    
-      instance_t * instance = a->add( name ? ( name->value != cls_name ? name->value : "." ) : "." , 
-				      interval ,
-				      channel ? channel->value : "." );
-
-      //
-      // Add any additional data members
-      //
-
-      std::vector<element_t*> kids = ii->child;
-      
-      for (int j=0; j<kids.size(); j++) 
-	{
-	  
-	  const std::string & key = kids[j]->name;
-	  
-	  if ( key == "Value" ) 
-	    {
-	      std::string var = kids[j]->attr.value( "name" );
-	      std::string val = kids[j]->value;
-	      
-	      if ( a->types.find( var ) != a->types.end() ) 
-		{
-		  
-		  globals::atype_t t = a->types[ var ];
-	      
-		  if ( t == globals::A_FLAG_T ) 
-		    {
-		      instance->set( var );
-		    }
-		  
-		  else if ( t == globals::A_MASK_T )
-		    {
-		      if ( var != "." )
-			{
-			  // accepts F and T as well as long forms (false, true)
-			  instance->set_mask( var , Helper::yesno( val ) );
-			}
-		    }
-		  
-		  else if ( t == globals::A_BOOL_T )
-		    {
-		      if ( val != "." )
-			{
-			  // accepts F and T as well as long forms (false, true)
-			  instance->set( var , Helper::yesno( val ) );
-			}
-		    }
-		  
-		  else if ( t == globals::A_INT_T )
-		    {
-		      int value = 0;
-		      if ( ! Helper::str2int( val , &value ) )
-			Helper::halt( "bad numeric value in " + filename );
-		      instance->set( var , value );
-		    }
-
-		  else if ( t == globals::A_DBL_T )
-		    {
-		      double value = 0;
-		      
-		      if ( Helper::str2dbl( val , &value ) )		    
-			instance->set( var , value );
-		      else
-			if ( var != "." && var != "NA" ) 
-			  Helper::halt( "bad numeric value in " + filename );		  
-		    }
-		  
-		  else if ( t == globals::A_TXT_T )
-		    {
-		      instance->set( var , val );
-		    }
-		  
-		}
-
-	    } // added this data member
-	  
-	}
-     
-      //
-      // Next instance
-      //
-    }
+  if ( ! xml_stream_t::read( filename , &loader ) )
+    Helper::halt( "invalid annotation file: " + filename );
   
   return true;
 }
 
 
 
+
 void annotation_set_t::clear() 
 { 
   std::map<std::string,annot_t*>::iterator ii = annots.begin();
@@ -139,6 +139,9 @@ struct annot_t
 
   static bool load( const std::string & , edf_t & edf );  
 
+  // read files into memory in parallel, ahead of load()/load_features()
+  static void prefetch( const std::vector<std::string> & );
+
   static interval_t get_interval( const std::string & ,
 				  const std::vector<std::string> & ,
 				  std::string * , 
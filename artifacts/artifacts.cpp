@@ -28,6 +28,7 @@
 #include "pdc/pdc.h"
 
 #include "helper/helper.h"
+#include "helper/threads.h"
 #include "helper/logger.h"
 #include "eval.h"
 #include "db/db.h"
@@ -440,160 +441,138 @@ void  rms_per_epoch( edf_t & edf , param_t & param )
   int ne = edf.timeline.first_epoch();
 
   if ( ne == 0 ) return;
-  
-  
+
   //
-  // For each signal
+  // Epochs to consider (the same for all signals)
   //
 
-  int si = -1;
-
-  for (int s=0;s<ns_all;s++)
+  std::vector<int> epochs;
+  
+  while ( 1 ) 
     {
+      int epoch = edf.timeline.next_epoch();
+      if ( epoch == -1 ) break;
+      epochs.push_back( epoch );
+    }
+  
+  const int nep = epochs.size();
 
-      //
-      // only consider data tracks
-      //
-      
-      if ( edf.header.is_annotation_channel( signals(s) ) ) continue;
+  //
+  // Sampling rates (data channels)
+  //
 
-      //
-      // and any SR requirements
-      //
+  std::vector<int> sr( ns );
+  for (int si=0; si<ns; si++)
+    sr[si] = edf.header.sampling_freq( signals( sdata[si] ) );
+  
+  //
+  // Per channel/epoch statistics
+  //
+  
+  std::vector<std::vector<MiscMath::sigstats_t> > stats( ns , std::vector<MiscMath::sigstats_t>( nep ) );
 
-      if ( required_sr != 0 && edf.header.sampling_freq( signals( s ) ) < required_sr ) continue;
+  std::vector<std::vector<std::vector<double> > > pe;
+  if ( calc_pe ) pe.resize( ns , std::vector<std::vector<double> >( nep , std::vector<double>( pe_m.size() ) ) );
 
-      //
-      // what's left here should match the stores defined above
-      //
+  std::vector<std::vector<std::vector<double> > > hjorth2;
+  if ( calc_hjorth2 ) hjorth2.resize( ns , std::vector<std::vector<double> >( nep , std::vector<double>( 9 , 0 ) ) );
+  
+  //
+  // Epochs are pulled (for all channels) in blocks of up to ~4M sample
+  // points; the fused kernel then runs over all channel/epoch pairs of
+  // the block in parallel
+  //
 
-      ++si;
+  double pts_per_epoch = 0;
+  for (int si=0; si<ns; si++) pts_per_epoch += sr[si] * edf.timeline.epoch_length();
+  
+  const int block = pts_per_epoch < 1 ? nep : std::max( 1 , (int)( 4e6 / pts_per_epoch ) );
 
-      //
-      // output stratifier (only needed at this stage if verbose, epoch-level output will
-      // also be written)
-      //
+  std::vector<std::vector<double> > d;
+  
+  for (int e0 = 0 ; e0 < nep ; e0 += block )
+    {
 
-      if ( verbose ) 
-	writer.level( signals.label(s) , globals::signal_strat );
+      const int e1 = std::min( nep , e0 + block );
 
-      //
-      // reset to first epoch
-      //
-      
-      edf.timeline.first_epoch();
+      const int nb = e1 - e0;
 
+      // channel-major: si * nb + (e - e0)
+      d.resize( ns * nb );
+      
+      for (int si=0; si<ns; si++)
+	for (int e = e0 ; e < e1 ; e++ )
+	  {
+	    interval_t interval = edf.timeline.epoch( epochs[e] );
+	    slice_t slice( edf , signals(sdata[si]) , interval );
+	    d[ si * nb + e - e0 ].swap( *slice.nonconst_pdata() );
+	  }
 
       //
-      // Get sampling rate
+      // clipped, flat and/or maxxed points (each is a proportion of points in the epoch);
+      // mean-centre, RMS, PFD and Hjorth parameters
       //
-    
-      int sr = edf.header.sampling_freq( signals( s ) );
+
+      Helper::parallel_for( ns * nb , [&]( int j ) {
+	  const int si = j / nb;
+	  const int e = e0 + j % nb;
+	  MiscMath::sigstats( d[j].data() , d[j].size() , &stats[si][e] ,
+			      calc_clipped , calc_flat , flat_eps ,
+			      calc_maxxed , max_value , calc_pfd );
+	} );
       
       //
-      // for each each epoch 
+      // Permutation entropy, 'second-order' Hjorth (on the mean-centred data)
       //
-      
-      while ( 1 ) 
-	{
-	  
-	  //
-	  // Get next epoch
-	  //
-	  
-	  int epoch = edf.timeline.next_epoch();
-	  
-	  if ( epoch == -1 ) break;
-	  
-	  interval_t interval = edf.timeline.epoch( epoch );
-	  	  
-	  slice_t slice( edf , signals(s) , interval );
-	  
-	  std::vector<double> * d = slice.nonconst_pdata();
-
-	  //
-	  // get clipped, flat and/or maxxed points (each is a proportion of points in the epoch)
-	  //
-
-	  double c = calc_clipped ? MiscMath::clipped( *d ) : 0 ;
-
-	  double f = calc_flat ? MiscMath::flat( *d , flat_eps ) : 0 ;
-	  
-	  double m = calc_maxxed ? MiscMath::max( *d , max_value ) : 0 ; 
-
-
-	  //
-	  // Mean-centre 30-second window, calculate RMS
-	  //
-
-	  MiscMath::centre( d );
-	  
-	  double x = calc_rms ? MiscMath::rms( *d ) : 0 ;
-	  	  
 
-	  //
-	  // Permutation entropy
-	  //
-
-	  std::vector<double> pe( pe_m.size() );
-
-	  if ( calc_pe )
+      if ( calc_pe || calc_hjorth2 )
+	for (int si=0; si<ns; si++)
+	  for (int e = e0 ; e < e1 ; e++ )
 	    {
-	      for ( int p=0; p<pe_m.size(); p++)
+	      
+	      std::vector<double> * dd = &d[ si * nb + e - e0 ];
+
+	      if ( calc_pe )
 		{
-		  int sum1 = 1;
-		  std::vector<double> pd = pdc_t::calc_pd( *d , pe_m[p] , pe_t , &sum1 );
-		  pe[p] = pdc_t::permutation_entropy( pd );
+		  for ( int p=0; p<pe_m.size(); p++)
+		    {
+		      int sum1 = 1;
+		      std::vector<double> pd = pdc_t::calc_pd( *dd , pe_m[p] , pe_t , &sum1 );
+		      pe[si][e][p] = pdc_t::permutation_entropy( pd );
+		    }
 		}
+	      
+	      if ( calc_hjorth2 && sr[si] >= 50 )
+		MiscMath::hjorth2( dd , &(hjorth2[si][e][0]) , hjorth2_win * sr[si] , hjorth2_inc * sr[si] );
+	      
 	    }
 
-	  //
-	  // Fractal dimension
-	  //
-
-	  double pfd = 0;
-	  if ( calc_pfd )
-	    pfd = MiscMath::petrosian_FD( *d );
-	  
-	  //
-	  // Hjorth parameters
-	  //
-
-	  double activity = 0 , mobility = 0 , complexity = 0;
-	  
-	  MiscMath::hjorth( d , &activity , &mobility , &complexity );
-
-
-	  //
-	  // 'Second-order' Hjorth
-	  //
+      //
+      // Next block of epochs
+      //
+    }
+  
+  
+  //
+  // Report, for each signal
+  //
 
-	  double hjorth2[9];
+  for (int si=0; si<ns; si++)
+    {
 
-	  if ( calc_hjorth2 && sr >= 50 )
-	    {
-	      MiscMath::hjorth2( d , &(hjorth2)[0] , hjorth2_win * sr , hjorth2_inc * sr );
-	    }		    
+      //
+      // output stratifier (only needed at this stage if verbose, epoch-level output will
+      // also be written)
+      //
 
+      if ( verbose ) 
+	writer.level( signals.label(sdata[si]) , globals::signal_strat );
+      
+      for (int e=0; e<nep; e++)
+	{
 
-	  //
-	  // Turning rate
-	  //
+	  const MiscMath::sigstats_t & st = stats[si][e];
 	  
-	  // double turning_rate_mean = 0;
-
-	  // if ( turning_rate )
-	  //   {
-
-	  //     std::vector<double> subepoch_tr;
-	      
-	  //     turning_rate_mean = MiscMath::turning_rate( d , sr, tr_epoch_sec , tr_d , &subepoch_tr );
-	      
-	  //     for (int i=0;i<subepoch_tr.size();i++)
-	  // 	e_tr[s].push_back( subepoch_tr[i] );
-	  //   }
-
-
 	  //
 	  // Verbose output
 	  //
@@ -601,53 +580,53 @@ void  rms_per_epoch( edf_t & edf , param_t & param )
 	  if ( verbose )
 	    {
 
-	      writer.epoch( edf.timeline.display_epoch( epoch ) );
+	      writer.epoch( edf.timeline.display_epoch( epochs[e] ) );
 
 	      //
 	      // Report calculated values
 	      //
 	      
-	      writer.value( "H1" , activity );
-	      writer.value( "H2" , mobility );
-	      writer.value( "H3" , complexity );
+	      writer.value( "H1" , st.activity );
+	      writer.value( "H2" , st.mobility );
+	      writer.value( "H3" , st.complexity );
 	      
-	      if ( calc_hjorth2 && sr >= 50 )
+	      if ( calc_hjorth2 && sr[si] >= 50 )
 		{
-		  writer.value( "H1H1" , hjorth2[0] );
-		  writer.value( "H1H2" , hjorth2[1] );
-		  writer.value( "H1H3" , hjorth2[2] );
+		  const std::vector<double> & h2 = hjorth2[si][e];
+		  
+		  writer.value( "H1H1" , h2[0] );
+		  writer.value( "H1H2" , h2[1] );
+		  writer.value( "H1H3" , h2[2] );
 
-		  writer.value( "H2H1" , hjorth2[3] );
-		  writer.value( "H2H2" , hjorth2[4] );
-		  writer.value( "H2H3" , hjorth2[5] );
+		  writer.value( "H2H1" , h2[3] );
+		  writer.value( "H2H2" , h2[4] );
+		  writer.value( "H2H3" , h2[5] );
 		  
-		  writer.value( "H3H1" , hjorth2[6] );
-		  writer.value( "H3H2" , hjorth2[7] );
-		  writer.value( "H3H3" , hjorth2[8] );
+		  writer.value( "H3H1" , h2[6] );
+		  writer.value( "H3H2" , h2[7] );
+		  writer.value( "H3H3" , h2[8] );
 		}
 	      
 	      
 	      if ( calc_rms )
-		writer.value( "RMS" , x );
+		writer.value( "RMS" , st.rms );
 
 	      if ( calc_pe )
 		for (int p=0;p<pe_m.size();p++)
-		  writer.value( "PE" + Helper::int2str( pe_m[p] ) , pe[p] ) ;
+		  writer.value( "PE" + Helper::int2str( pe_m[p] ) , pe[si][e][p] ) ;
 
 	      if ( calc_pfd )
-		writer.value( "PFD" , pfd );
+		writer.value( "PFD" , st.pfd );
 
 	      if ( calc_clipped )
-		writer.value( "CLIP" , c );
+		writer.value( "CLIP" , st.clipped );
 
 	      if ( calc_flat )
-		writer.value( "FLAT" , f );
+		writer.value( "FLAT" , st.flat );
 
 	      if ( calc_maxxed )
-		writer.value( "MAX" , m );
+		writer.value( "MAX" , st.maxxed );
 	      
-	      // if ( turning_rate ) 
-	      // 	writer.value( "TR" , turning_rate_mean );
 	    }
 
 
@@ -656,20 +635,20 @@ void  rms_per_epoch( edf_t & edf , param_t & param )
 	  //
 
 	  if ( calc_rms )
-	    rms[si] += x;
+	    rms[si] += st.rms;
 
 	  if ( calc_clipped )
-	    clipped[si] += c;
+	    clipped[si] += st.clipped;
 	  
 	  if ( calc_flat )
-	    flat[si] += f;
+	    flat[si] += st.flat;
 
 	  if ( calc_maxxed )
-	    maxxed[si] += m;
+	    maxxed[si] += st.maxxed;
 	  
-	  mean_activity[si] += activity;
-	  mean_mobility[si] += mobility;
-	  mean_complexity[si] += complexity;
+	  mean_activity[si] += st.activity;
+	  mean_mobility[si] += st.mobility;
+	  mean_complexity[si] += st.complexity;
 
 	  n[si]   += 1;
 		  
@@ -1206,7 +1185,7 @@ void  chep_mask( edf_t & edf , param_t & param )
 
   // if at any step we are ignoring the prior mask, copy/clear/merge in using this:
 
-  std::map<int,std::set<std::string> > chep_copy;
+  chep_mask_t chep_copy;
 
   if ( ep_th.size() > 0 ) 
     logger << "  within-channel/between-epoch outlier detection, ep-th" << ( ep_ignore ? "0" : "" ) << " = " 
@@ -35,6 +35,12 @@
 extern logger_t logger;
 extern writer_t writer;
 
+static void regression_correction( edf_t & edf , 
+				   const signal_list_t & signals , 
+				   const signal_list_t & correctors , 
+				   const int segment_points , 
+				   const int step_points );
+
 void dsptools::artifact_correction( edf_t & edf , param_t & param )
 {
 
@@ -113,10 +119,22 @@ void dsptools::artifact_correction( edf_t & edf , param_t & param )
   if ( regression_mode ) logger << " with 50% overlap";
   logger << "\n";
 
+
+  //
+  // regression mode: all signals fit jointly (per segment) 
+  //
+
+  if ( regression_mode )
+    {
+      regression_correction( edf , signals , correctors , 
+			     segment_size_sec * sr , 
+			     segment_step_sec * sr );
+      return;
+    }
   
       
   //
-  // Iterate over signals
+  // Iterate over signals (EMD mode)
   //
 
   for (int s=0; s<ns; s++)
@@ -188,31 +206,8 @@ void dsptools::artifact_correction( edf_t & edf , param_t & param )
 	      zz( i , j ) = Z( p + i , j );
 	  
 	  
-	  //	  
-	  // regression-based correction?
-	  //
-
-	  if ( regression_mode )
-	    {
-
-	      // mean center
-	      const double ymean = Statistics::mean( y );
-	      for (int i=0; i<segment_points ; i++) y[i] -= ymean;
-
-	      GLM glm( GLM::LINEAR );
-	      
-	      glm.set( y , zz );
-	      
-	      const bool okay = glm.fit();
-	      
-	      if ( ! okay )
-		res[ p ] = y;
-	      else
-		res[ p ] = glm.get_residuals();
-	    }
-
 	  //
-	  // Or EMD based correction?
+	  // EMD based correction
 	  //
 
 	  if ( emd_mode )
@@ -389,3 +384,127 @@ void dsptools::artifact_correction( edf_t & edf , param_t & param )
 
 }
 
+
+
+//
+// Regression-based correction: within each segment, the correctors
+// form a single design (factorized once) shared by all signals; the
+// residuals (from overlapping segments) are averaged
+//
+
+void regression_correction( edf_t & edf , 
+			    const signal_list_t & signals , 
+			    const signal_list_t & correctors , 
+			    const int segment_points , 
+			    const int step_points )
+{
+
+  const int ns = signals.size();
+
+  interval_t interval = edf.timeline.wholetrace();
+
+  //
+  // Get data : correctors
+  //
+  
+  eigen_matslice_t cslice( edf , correctors , interval );
+  
+  const Eigen::MatrixXd & Z = cslice.data_ref();
+  
+  const int total_points = Z.rows();
+
+  //
+  // Signals are pulled in blocks (typically, all at once), to cap memory
+  //
+
+  const int max_block = std::max( 1 , (int)( 50e6 / (double)total_points ) );
+
+  for (int s0 = 0; s0 < ns; s0 += max_block )
+    {
+      
+      signal_list_t block;
+      for (int s = s0; s < ns && s < s0 + max_block; s++)
+	block.add( signals(s) , signals.label(s) );
+      
+      const int nb = block.size();
+
+      eigen_matslice_t mslice( edf , block , interval );
+
+      Eigen::MatrixXd & D = mslice.nonconst_data_ref();
+
+      if ( D.rows() != total_points ) 
+	Helper::halt( "all sampling rates must be similar for ALTER" );
+
+      //
+      // Residuals are accumulated over a window [lo,lo+segment_points);
+      // as segments are processed in order, rows prior to the current
+      // segment are final, and so are written back to D in place
+      //
+      
+      Eigen::MatrixXd acc = Eigen::MatrixXd::Zero( segment_points , nb );
+      std::vector<int> cnt( segment_points , 0 );
+      int lo = 0;
+      
+      for (int p = 0; p + segment_points <= total_points ; p += step_points )
+	{
+	  
+	  // finalize rows [lo,p) and shift the window
+	  
+	  const int k = std::min( p - lo , segment_points );
+
+	  for (int i=0; i<k; i++)
+	    if ( cnt[i] ) D.row( lo + i ) = acc.row(i) / (double)cnt[i];
+	  
+	  if ( k ) 
+	    {
+	      const int r = segment_points - k;
+	      if ( r ) 
+		{
+		  acc.topRows( r ) = acc.bottomRows( r ).eval();
+		  for (int i=0; i<r; i++) cnt[i] = cnt[i+k];
+		}
+	      acc.bottomRows( k ).setZero();
+	      for (int i=r; i<segment_points; i++) cnt[i] = 0;
+	    }
+
+	  lo = p;
+
+	  // mean-centered signals
+	  
+	  Eigen::MatrixXd Y = D.middleRows( p , segment_points );
+	  Y.rowwise() -= Y.colwise().mean();
+	  
+	  // fit all signals given this segment's correctors
+	  
+	  mass_glm_t glm;
+	  
+	  if ( glm.set( Z.middleRows( p , segment_points ) ) && glm.fit( Y ) )
+	    acc += glm.E;
+	  else
+	    acc += Y;
+	  
+	  for (int i=0; i<segment_points; i++) ++cnt[i];
+	  
+	} 
+      
+      // remaining rows
+
+      for (int i=0; i<segment_points && lo + i < total_points; i++)
+	if ( cnt[i] ) D.row( lo + i ) = acc.row(i) / (double)cnt[i];
+      
+
+      //
+      // Update signals in EDF
+      //
+      
+      logger << "  updating " << nb << " signals\n";
+
+      for (int s=0; s<nb; s++)
+	{
+	  std::vector<double> val( D.col(s).data() , D.col(s).data() + total_points );
+	  edf.update_signal_retain_range( block(s) , &val );
+	}
+      
+    }
+  
+}
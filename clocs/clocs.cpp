@@ -32,6 +32,19 @@
 
 extern writer_t writer;
 
+// inverted G matrices from make_interpolation_matrices(), keyed by
+// spline_key() for the good channels: i.e. repeated bad-channel patterns
+// (across epochs, and EDFs with the same montage) reuse the same inverse
+
+static std::map<std::string,Data::Matrix<double> > invG_cache;
+
+// bound the cache by size, as each entry is ns x ns doubles (i.e. 0.5MB
+// for 256 channels): it is cleared whenever it would exceed this
+
+static const size_t invG_cache_max_bytes = 64 * 1024 * 1024;
+
+static size_t invG_cache_bytes = 0;
+
 cart_t sph_t::cart() const { return clocs_t::sph2cart( *this ); } 
 sph_t cart_t::sph() const { return clocs_t::cart2sph( *this ); } 
 
@@ -308,6 +321,26 @@ Data::Matrix<double> clocs_t::interelectrode_distance_matrix( const signal_list_
 }
 
 
+std::string clocs_t::spline_key( const signal_list_t & signals , int m , int order , double lambda ) const
+{
+  // exact (binary) positions, so only identical montages match
+  std::string k;
+  k.append( (const char*)&m , sizeof(int) );
+  k.append( (const char*)&order , sizeof(int) );
+  k.append( (const char*)&lambda , sizeof(double) );
+  for (int s=0; s<signals.size(); s++)
+    {
+      const cart_t c = cart( signals.label(s) );
+      k += Helper::toupper( signals.label(s) );
+      k += '\0';
+      k.append( (const char*)&c.x , sizeof(double) );
+      k.append( (const char*)&c.y , sizeof(double) );
+      k.append( (const char*)&c.z , sizeof(double) );
+    }
+  return k;
+}
+
+
 bool clocs_t::make_interpolation_matrices( const signal_list_t & good_signals , 
 					   const signal_list_t & bad_signals , 
 					   Data::Matrix<double> * G , 
@@ -329,18 +362,6 @@ bool clocs_t::make_interpolation_matrices( const signal_list_t & good_signals ,
   int ns  = good_signals.size();
   int nsi = bad_signals.size();
   
-  // get interelectrode distance matrix
-  Data::Matrix<double> D = interelectrode_distance_matrix( good_signals , good_signals );
-  
-  // std::cout << "cosdist\n\n";
-  // std::cout << D.print() << "\n";
-
-  // Evaluate Legendre polynomials
-  std::vector<Data::Matrix<double> > L = legendre( N , D );
-
-  // given signals in the signal-list, make a matching G matrix  
-  //  const int ns = signals.size();
-  
   // precompute electrode-independent variables
   std::vector<int> twoN1;
   std::vector<double> gdenom;
@@ -350,33 +371,75 @@ bool clocs_t::make_interpolation_matrices( const signal_list_t & good_signals ,
       gdenom.push_back( pow( i*(i+1)  , m ) ) ; 
     }
 
+  //
+  // inverse of G (for all good x all good electrodes): only depends on
+  // the good channels, so may already be cached
+  //
+
+  const std::string key = spline_key( good_signals , m , N , 0 );
   
-  // compute G (for all good x all good electrodes)  
-  G->resize( ns , ns , 0 );
+  std::map<std::string,Data::Matrix<double> >::const_iterator kk = invG_cache.find( key );
   
-  // for each pair of good x good electrodes, get element of G
-  for (int i=0;i<ns;i++)
-    for (int j=i;j<ns;j++)
-      {
-	double g = 0;
-	for (int n=0;n<N;n++)
+  if ( kk != invG_cache.end() )
+    *G = kk->second;
+  else
+    {
+      
+      // get interelectrode distance matrix
+      Data::Matrix<double> D = interelectrode_distance_matrix( good_signals , good_signals );
+      
+      // std::cout << "cosdist\n\n";
+      // std::cout << D.print() << "\n";
+      
+      // Evaluate Legendre polynomials
+      std::vector<Data::Matrix<double> > L = legendre( N , D );
+      
+      // compute G 
+      G->resize( ns , ns , 0 );
+      
+      // for each pair of good x good electrodes, get element of G
+      for (int i=0;i<ns;i++)
+	for (int j=i;j<ns;j++)
 	  {
-	    g += (twoN1[n] * L[n](i,j) ) / gdenom[n];
+	    double g = 0;
+	    for (int n=0;n<N;n++)
+	      {
+		g += (twoN1[n] * L[n](i,j) ) / gdenom[n];
+	      }
+	    (*G)(i,j) = g / ( 4.0 * M_PI );
+	    (*G)(j,i) = (*G)(i,j);
 	  }
-	(*G)(i,j) = g / ( 4.0 * M_PI );
-	(*G)(j,i) = (*G)(i,j);
-      }
-
-    
-  // 
-  // Optionally, add smoothing to each diagonal element
-  //
-
-  if ( 0 ) 
-    {
-      for (int i=0;i<ns;i++) (*G)(i,i) = (*G)(i,i) + smoothing ; 
+      
+      
+      // 
+      // Optionally, add smoothing to each diagonal element
+      //
+      
+      if ( 0 ) 
+	{
+	  for (int i=0;i<ns;i++) (*G)(i,i) = (*G)(i,i) + smoothing ; 
+	}
+      
+      // return inverse of G
+      bool okay = true;
+      Data::Matrix<double> invG = Statistics::inverse( *G , &okay );
+      if ( ! okay ) Helper::halt( "problem inverting G" );
+      //  std::cout << "invG\n\n" << invG.print() << "\n\n";
+      *G = invG;
+
+      const size_t bytes = (size_t)ns * ns * sizeof(double);
+      if ( invG_cache_bytes + bytes > invG_cache_max_bytes )
+	{
+	  invG_cache.clear();
+	  invG_cache_bytes = 0;
+	}
+      if ( bytes <= invG_cache_max_bytes )
+	{
+	  invG_cache[ key ] = invG;
+	  invG_cache_bytes += bytes;
+	}
     }
-
+  
   //
   // G for the to-be-interpolated electrodes
   //
@@ -401,13 +464,6 @@ bool clocs_t::make_interpolation_matrices( const signal_list_t & good_signals ,
 	(*Gi)(i,j) = g / ( 4.0 * M_PI );
       }
 
-  // return inverse of G
-  bool okay = true;
-  Data::Matrix<double> invG = Statistics::inverse( *G , &okay );
-  if ( ! okay ) Helper::halt( "problem inverting G" );
-  //  std::cout << "invG\n\n" << invG.print() << "\n\n";
-  *G = invG;
-
   return true;
 }
 
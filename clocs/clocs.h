@@ -101,6 +101,10 @@ struct clocs_t {
 				    const signal_list_t & bad_signals , 
 				    Data::Matrix<double> * G , 
 				    Data::Matrix<double> * Gi );
+
+  // identifies a montage (channel labels and positions) plus spherical
+  // spline parameters, i.e. for caching G/H matrices across epochs and EDFs
+  std::string spline_key( const signal_list_t & signals , int m , int order , double lambda ) const;
   
   
   Data::Matrix<double> interpolate( const Data::Matrix<double> & data , 
@@ -111,22 +111,39 @@ std::vector<double> legendre( const int N , double x )
 std::vector<Data::Matrix<double> > legendre( const int N , const Data::Matrix<double> & D )
 {
 
-  // return N vector, each element mirrors the original input matrix
+  // return N vector, each element mirrors the original input matrix,
+  // i.e. R[n-1] = P(n,x) for n = 1..N
+  
+  // (only M=0 is needed, so rather than calling legendre( n , x ) for each
+  // n and datapoint, which evaluates all M=0..n each time, run the same
+  // three-term recurrence as pm_polynomial_value() once up to N, over all
+  // datapoints together)
   
   const int nr = D.dim1();
   const int nc = D.dim2();
 
   std::vector<Data::Matrix<double> > R(N);
   for (int n=0;n<N;n++) R[n].resize( nr,nc );
+
+  if ( N < 1 ) return R;
   
-  // for each datapoint
-  for (int n=1;n<=N;n++)
+  // P(0,x) = 1 and P(1,x) = x
+  for (int c=0;c<nc;c++)
     for (int r=0;r<nr;r++)
+      R[0](r,c) = D(r,c);
+
+  for (int n=2;n<=N;n++)
+    {
+      const Data::Matrix<double> & P1 = R[n-2];      
       for (int c=0;c<nc;c++)
-	{
-	  std::vector<double> y = legendre( n , D(r,c) );
-	  R[n-1][r][c] = y[0];
-	}
+	for (int r=0;r<nr;r++)
+	  {
+	    const double p2 = n == 2 ? 1.0 : R[n-3](r,c);
+	    R[n-1](r,c) = ( ( double ) ( 2 * n - 1 ) * D(r,c) * P1(r,c)
+			    + ( double ) ( - n + 1 ) * p2 )
+	      / ( double ) n ;
+	  }
+    }
   
   return R;  
 }
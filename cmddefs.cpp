@@ -293,6 +293,23 @@ void cmddefs_t::init()
   add_param( "PEAKS" , "min-only" , "" , "Only find minima" );
   add_param( "PEAKS" , "percentile" , "20" , "Only report top 20% of peaks" );
 
+
+  //
+  // PROF (not a command: output of profile=T)
+  //
+
+  hide_cmd( "misc" , "PROF" , "Per-command timing/resources, given profile=T" );
+
+  add_table( "PROF" , "CMD" , "Per-command profile" );
+  add_var( "PROF" , "CMD" , "NAME" , "Command name" );
+  add_var( "PROF" , "CMD" , "WALL" , "Elapsed time (seconds)" );
+  add_var( "PROF" , "CMD" , "CPU" , "User + system CPU time, all threads (seconds)" );
+  add_var( "PROF" , "CMD" , "RSS" , "Peak resident memory at end of command (MB)" );
+  add_var( "PROF" , "CMD" , "DRSS" , "Increase in peak resident memory (MB)" );
+  add_var( "PROF" , "CMD" , "NREC" , "EDF records read from disk" );
+  add_var( "PROF" , "CMD" , "NOUT" , "Output values written" );
+  add_var( "PROF" , "CMD" , "BOUT" , "Output payload (variable name + value) bytes" );
+
     
   /////////////////////////////////////////////////////////////////////////////////
   //
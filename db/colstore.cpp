@@ -0,0 +1,510 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "db/colstore.h"
+#include "db/db.h"
+#include "helper/helper.h"
+#include "defs/defs.h"
+
+#include <zlib.h>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <set>
+
+static const char * colstore_magic = "LUNACOL1";
+
+static const uint32_t colstore_missing_code = 0xFFFFFFFF;
+
+static const int32_t colstore_missing_int = std::numeric_limits<int32_t>::min();
+
+
+//
+// little-endian serialization helpers (into a byte buffer)
+//
+
+static void put_u32( std::string & b , uint32_t x )
+{
+  char c[4] = { (char)( x & 0xFF ) , (char)( ( x >> 8 ) & 0xFF ) , (char)( ( x >> 16 ) & 0xFF ) , (char)( ( x >> 24 ) & 0xFF ) };
+  b.append( c , 4 );
+}
+
+static void put_dbl( std::string & b , double d )
+{
+  uint64_t x;
+  memcpy( &x , &d , 8 );
+  put_u32( b , (uint32_t)( x & 0xFFFFFFFF ) );
+  put_u32( b , (uint32_t)( x >> 32 ) );
+}
+
+static void put_str( std::string & b , const std::string & s )
+{
+  put_u32( b , s.size() );
+  b.append( s );
+}
+
+static uint32_t get_u32( const unsigned char * p )
+{
+  return (uint32_t)p[0] | ( (uint32_t)p[1] << 8 ) | ( (uint32_t)p[2] << 16 ) | ( (uint32_t)p[3] << 24 );
+}
+
+static double get_dbl( const unsigned char * p )
+{
+  uint64_t x = (uint64_t)get_u32( p ) | ( (uint64_t)get_u32( p + 4 ) << 32 );
+  double d;
+  memcpy( &d , &x , 8 );
+  return d;
+}
+
+
+
+//
+// colstore_t
+//
+
+colstore_t::colstore_t( const std::string & root , const int block_rows ) 
+  : block_rows( block_rows ) 
+{
+  folder = root + globals::folder_delimiter;
+  
+  // create folder if it does not exist
+  std::string syscmd = globals::mkdir_command + " " + root ;
+  int dummy = system( syscmd.c_str() );  
+}
+
+
+colstore_table_t * colstore_t::table( const std::string & cmd , const std::string & tag )
+{
+
+  const std::string key = cmd + ( tag == "" ? "" : "_" + tag );
+  
+  std::map<std::string,colstore_table_t*>::iterator tt = tables.find( key );
+  if ( tt != tables.end() ) return tt->second;
+  
+  std::string filename = folder 
+    + globals::txt_table_prepend 
+    + key
+    + globals::txt_table_append 
+    + ".lcol";
+
+  colstore_table_t * t = new colstore_table_t( filename , block_rows );
+  tables[ key ] = t;
+  return t;
+}
+
+
+void colstore_t::close()
+{
+  std::map<std::string,colstore_table_t*>::iterator tt = tables.begin();
+  while ( tt != tables.end() )
+    {
+      tt->second->close();
+      delete tt->second;
+      ++tt;
+    }
+  tables.clear();
+}
+
+
+
+//
+// colstore_table_t
+//
+
+colstore_table_t::colstore_table_t( const std::string & filename , const int block_rows )
+  : block_rows( block_rows < 1 ? 1 : block_rows )
+{
+  out = fopen( filename.c_str() , "wb" );
+  if ( out == NULL ) Helper::halt( "could not open " + filename + " for writing" );
+  fwrite( colstore_magic , 1 , 8 , out );
+  pending = false;
+  nrows = 0;
+}
+
+
+uint32_t colstore_table_t::code( const std::string & s )
+{
+  std::map<std::string,uint32_t>::const_iterator ss = dict.find( s );
+  if ( ss != dict.end() ) return ss->second;
+  const uint32_t c = dict.size();
+  dict[ s ] = c;
+  new_strings.push_back( s );
+  return c;
+}
+
+
+void colstore_table_t::row( const std::string & indiv , const std::map<std::string,std::string> & faclvl )
+{
+  if ( pending && indiv == p_indiv && faclvl == p_faclvl ) return;
+  commit_row();
+  p_indiv = indiv;
+  p_faclvl = faclvl;
+  pending = true;
+}
+
+
+void colstore_table_t::value( const std::string & var , const value_t & x )
+{
+  if ( ! pending ) Helper::halt( "internal error in colstore_table_t::value(), no current row" );
+  p_values[ var ] = x;
+}
+
+
+void colstore_table_t::commit_row()
+{
+
+  // nothing to add (i.e. levels set but no values written)
+  if ( ! pending || p_values.size() == 0 ) 
+    {
+      pending = false;
+      p_values.clear();
+      return;
+    }
+
+  //
+  // ID and factors 
+  //
+  
+  id_col.push_back( code( p_indiv ) );
+
+  // new factor in this block? pad previous rows as missing
+  std::map<std::string,std::string>::const_iterator ff = p_faclvl.begin();
+  while ( ff != p_faclvl.end() )
+    {
+      std::vector<uint32_t> & col = fac_cols[ ff->first ];
+      if ( col.size() < nrows ) col.resize( nrows , colstore_missing_code );
+      col.push_back( code( ff->second ) );
+      ++ff;
+    }
+
+  //
+  // variables (as above, pad for new columns)
+  //
+  
+  std::map<std::string,value_t>::const_iterator vv = p_values.begin();
+  while ( vv != p_values.end() )
+    {
+      std::vector<value_t> & col = var_cols[ vv->first ];
+      if ( col.size() < nrows ) col.resize( nrows );
+      col.push_back( vv->second );
+      ++vv;
+    }
+
+  ++nrows;
+
+  // pad any columns not set in this row
+  std::map<std::string,std::vector<uint32_t> >::iterator fc = fac_cols.begin();
+  while ( fc != fac_cols.end() )
+    {
+      if ( fc->second.size() < nrows ) fc->second.resize( nrows , colstore_missing_code );
+      ++fc;
+    }
+
+  std::map<std::string,std::vector<value_t> >::iterator vc = var_cols.begin();
+  while ( vc != var_cols.end() )
+    {
+      if ( vc->second.size() < nrows ) vc->second.resize( nrows );
+      ++vc;
+    }
+  
+  pending = false;
+  p_values.clear();
+
+  if ( nrows >= block_rows ) flush_block();
+  
+}
+
+
+void colstore_table_t::flush_block()
+{
+
+  if ( nrows == 0 ) return;
+
+  //
+  // encode columns (this may add new dictionary entries, so the
+  // dictionary is serialized afterwards)
+  //
+
+  std::string cols;
+  
+  uint32_t ncols = 0;
+  
+  // ID
+  put_u32( cols , code( "ID" ) );
+  cols.push_back( 0 );
+  for (int i=0; i<nrows; i++) put_u32( cols , id_col[i] );
+  ++ncols;
+
+  // factors 
+  std::map<std::string,std::vector<uint32_t> >::const_iterator fc = fac_cols.begin();
+  while ( fc != fac_cols.end() )
+    {
+      put_u32( cols , code( fc->first ) );
+      cols.push_back( 0 );
+      for (int i=0; i<nrows; i++) put_u32( cols , fc->second[i] );
+      ++ncols;
+      ++fc;
+    }
+
+  // variables: use the narrowest type that holds all (non-missing) values in this block 
+  std::map<std::string,std::vector<value_t> >::const_iterator vc = var_cols.begin();
+  while ( vc != var_cols.end() )
+    {
+
+      const std::vector<value_t> & col = vc->second;
+
+      bool all_int = true , all_num = true;
+      for (int i=0; i<nrows; i++)
+	{
+	  const value_t & x = col[i];
+	  if ( x.is_missing() ) continue;
+	  if ( x.is_string() ) { all_int = all_num = false; break; }
+	  if ( ! x.is_integer() ) all_int = false;
+	}
+      
+      put_u32( cols , code( vc->first ) );
+      
+      if ( all_int )
+	{
+	  cols.push_back( 1 );
+	  for (int i=0; i<nrows; i++) 
+	    put_u32( cols , (uint32_t)( col[i].is_missing() ? colstore_missing_int : col[i].i ) );
+	}
+      else if ( all_num )
+	{
+	  cols.push_back( 2 );
+	  for (int i=0; i<nrows; i++)
+	    {
+	      const value_t & x = col[i];
+	      put_dbl( cols , x.is_missing() ? std::numeric_limits<double>::quiet_NaN() : ( x.is_integer() ? (double)x.i : x.d ) );
+	    }
+	}
+      else
+	{
+	  cols.push_back( 0 );
+	  for (int i=0; i<nrows; i++) 
+	    put_u32( cols , col[i].is_missing() ? colstore_missing_code : code( col[i].str() ) );
+	}
+
+      ++ncols;
+      ++vc;
+    }
+
+  //
+  // payload: new strings, then columns
+  //
+  
+  std::string payload;
+  put_u32( payload , new_strings.size() );
+  for (int i=0; i<new_strings.size(); i++) put_str( payload , new_strings[i] );
+  put_u32( payload , nrows );
+  put_u32( payload , ncols );
+  payload.append( cols );
+  
+  //
+  // deflate and write
+  //
+
+  uLongf zlen = compressBound( payload.size() );
+  std::vector<Bytef> z( zlen );
+  if ( compress2( &z[0] , &zlen , (const Bytef*)payload.data() , payload.size() , Z_DEFAULT_COMPRESSION ) != Z_OK )
+    Helper::halt( "problem compressing block in colstore_table_t" );
+  
+  std::string hdr;
+  put_u32( hdr , payload.size() );
+  put_u32( hdr , zlen );
+  fwrite( hdr.data() , 1 , hdr.size() , out );
+  fwrite( &z[0] , 1 , zlen , out );
+
+  //
+  // reset block
+  //
+  
+  new_strings.clear();
+  nrows = 0;
+  id_col.clear();
+  fac_cols.clear();
+  var_cols.clear();
+  
+}
+
+
+void colstore_table_t::close()
+{
+  if ( out == NULL ) return;
+  commit_row();
+  flush_block();
+  fclose( out );
+  out = NULL;
+}
+
+
+
+//
+// Reader: decode to a text table
+//
+
+struct colstore_block_t {
+
+  // decoded column: name, type, raw column data
+  struct col_t {
+    std::string name;
+    int type;
+    const unsigned char * p;
+  };
+  
+  std::vector<col_t> cols;
+  uint32_t nrows;
+  std::vector<unsigned char> raw;
+};
+
+
+static bool colstore_read_block( FILE * in , std::vector<std::string> & dict , colstore_block_t & blk )
+{
+
+  unsigned char hdr[8];
+  if ( fread( hdr , 1 , 8 , in ) != 8 ) return false;
+  
+  const uint32_t rawlen = get_u32( hdr );
+  uLongf zlen = get_u32( hdr + 4 );
+  
+  std::vector<Bytef> z( zlen );
+  if ( fread( &z[0] , 1 , zlen , in ) != zlen ) 
+    Helper::halt( "truncated block in .lcol file" );
+  
+  blk.raw.resize( rawlen );
+  uLongf len = rawlen;
+  if ( uncompress( &blk.raw[0] , &len , &z[0] , zlen ) != Z_OK || len != rawlen )
+    Helper::halt( "problem decompressing block in .lcol file" );
+
+  const unsigned char * p = &blk.raw[0];
+  
+  // new dictionary entries
+  const uint32_t nstr = get_u32( p ); p += 4;
+  for (uint32_t i=0; i<nstr; i++)
+    {
+      const uint32_t l = get_u32( p ); p += 4;
+      dict.push_back( std::string( (const char*)p , l ) );
+      p += l;
+    }
+  
+  blk.nrows = get_u32( p ); p += 4;
+  const uint32_t ncols = get_u32( p ); p += 4;
+
+  blk.cols.resize( ncols );
+  for (uint32_t c=0; c<ncols; c++)
+    {
+      blk.cols[c].name = dict[ get_u32( p ) ]; p += 4;
+      blk.cols[c].type = *p; p++;
+      blk.cols[c].p = p;
+      p += blk.nrows * ( blk.cols[c].type == 2 ? 8 : 4 );
+    }
+  
+  return true;
+}
+
+
+bool colstore_t::dump( const std::string & filename , std::ostream & out )
+{
+
+  FILE * in = fopen( filename.c_str() , "rb" );
+  if ( in == NULL ) return false;
+
+  char magic[8];
+  if ( fread( magic , 1 , 8 , in ) != 8 || memcmp( magic , colstore_magic , 8 ) != 0 )
+    Helper::halt( filename + " is not a .lcol file" );
+
+  //
+  // pass 1: get the union of all column names, in order of first appearance
+  //
+
+  std::vector<std::string> dict;
+  std::vector<std::string> header;
+  std::set<std::string> seen;
+  
+  colstore_block_t blk;
+  
+  while ( colstore_read_block( in , dict , blk ) )
+    {
+      for (int c=0; c<blk.cols.size(); c++)
+	if ( seen.find( blk.cols[c].name ) == seen.end() )
+	  {
+	    seen.insert( blk.cols[c].name );
+	    header.push_back( blk.cols[c].name );
+	  }
+    }
+
+  for (int c=0; c<header.size(); c++)
+    out << ( c ? "\t" : "" ) << header[c];
+  out << "\n";
+
+  //
+  // pass 2: write rows
+  //
+  
+  fseek( in , 8 , SEEK_SET );
+  dict.clear();
+  
+  while ( colstore_read_block( in , dict , blk ) )
+    {
+
+      // map header slots to this block's columns
+      std::map<std::string,int> slot;
+      for (int c=0; c<blk.cols.size(); c++) slot[ blk.cols[c].name ] = c;
+      std::vector<const colstore_block_t::col_t*> cols( header.size() , NULL );
+      for (int h=0; h<header.size(); h++)
+	if ( slot.find( header[h] ) != slot.end() ) cols[h] = &blk.cols[ slot[ header[h] ] ];
+      
+      for (uint32_t r=0; r<blk.nrows; r++)
+	{
+	  for (int h=0; h<header.size(); h++)
+	    {
+	      if ( h ) out << "\t";
+	      const colstore_block_t::col_t * col = cols[h];
+	      if ( col == NULL ) { out << "NA"; continue; }
+	      
+	      if ( col->type == 0 )
+		{
+		  const uint32_t x = get_u32( col->p + 4 * r );
+		  if ( x == colstore_missing_code ) out << "NA";
+		  else out << dict[ x ];
+		}
+	      else if ( col->type == 1 )
+		{
+		  const int32_t x = (int32_t)get_u32( col->p + 4 * r );
+		  if ( x == colstore_missing_int ) out << "NA";
+		  else out << x;
+		}
+	      else
+		{
+		  const double x = get_dbl( col->p + 8 * r );
+		  if ( std::isnan( x ) ) out << "NA";
+		  else out << x;
+		}
+	    }
+	  out << "\n";
+	}
+    }
+  
+  fclose( in );
+  return true;
+}
@@ -0,0 +1,128 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_COLSTORE_H__
+#define __LUNA_COLSTORE_H__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <stdint.h>
+#include <iostream>
+
+#include "db/db.h"
+
+//
+// Columnar binary output (luna -b folder), an alternative to -o (SQLite) and -t (text)
+//
+
+// one file per command/table, root/{prepend}CMD{_F1_F2}{append}.lcol, spanning
+// all individuals in the run; rows are (ID, factor levels) combinations, as for -t
+// mode, and values are buffered column-wise in blocks of (at most) 'block_rows'
+// rows, each of which is then encoded and deflated as a unit:
+
+//   file   := "LUNACOL1" block*
+//   block  := uint32 raw-size , uint32 deflated-size , deflated( payload )
+//   payload:= uint32 n-new-strings , string*    (appended to table dictionary)
+//             uint32 nrows , uint32 ncols , column*
+//   column := uint32 name-code , uint8 type , nrows values
+//   string := uint32 length , bytes
+
+// column types: 0 = dictionary codes (uint32; IDs, factor levels and
+// string values), 1 = int32 and 2 = double; missing values are
+// 0xFFFFFFFF, INT32_MIN and NaN respectively.  All integers are
+// little-endian.  The first column is always 'ID', then the factors
+// (incl. E/T) then the variables; a variable only appears in blocks in
+// which it was written.
+
+struct colstore_table_t {
+  
+  colstore_table_t( const std::string & filename , const int block_rows );
+
+  ~colstore_table_t() { close(); }
+
+  // set the current row (ID + factor/levels); starts a new row if
+  // different from the pending one
+  void row( const std::string & indiv , const std::map<std::string,std::string> & faclvl );
+
+  void value( const std::string & var , const value_t & x );
+  
+  void close();
+  
+private:
+
+  void commit_row();
+
+  void flush_block();
+
+  uint32_t code( const std::string & s );
+
+  FILE * out;
+
+  const int block_rows;
+  
+  // table-level string dictionary; only new entries are written with each block
+  std::map<std::string,uint32_t> dict;
+  std::vector<std::string> new_strings;
+
+  // pending row
+  bool pending;
+  std::string p_indiv;
+  std::map<std::string,std::string> p_faclvl;
+  std::map<std::string,value_t> p_values;
+  
+  // current block (column-wise)
+  int nrows;
+  std::vector<uint32_t> id_col;
+  std::map<std::string,std::vector<uint32_t> > fac_cols;
+  std::map<std::string,std::vector<value_t> > var_cols;
+  
+};
+
+
+struct colstore_t {
+
+  colstore_t( const std::string & root , const int block_rows = 8192 );
+
+  ~colstore_t() { close(); }
+
+  // access table by command-name/table ID, creating if needed
+  colstore_table_t * table( const std::string & cmd , const std::string & tag );
+  
+  void close();
+
+  // reader (destrat): decode a .lcol file to a tab-delimited text table
+  static bool dump( const std::string & filename , std::ostream & out );
+
+private:
+
+  std::string folder;
+  
+  const int block_rows;
+  
+  // cmd+tag -> table
+  std::map<std::string,colstore_table_t*> tables;
+  
+};
+
+#endif
@@ -20,6 +20,7 @@
 //    --------------------------------------------------------------------
 
 #include "db.h"
+#include "db/colstore.h"
 
 #include <iostream>
 #include <set>
@@ -1203,6 +1204,15 @@ bool writer_t::close()
 
 
 
+  // if in columnar mode, flush all tables
+  if ( colstore != NULL )
+    {
+      colstore->close();
+      delete colstore;
+      colstore = NULL;
+      curr_coltable = NULL;
+    }
+
   // otherwise, handle any DB-related stuff
   if ( ! attached() ) return false;
   clear(); 
@@ -1352,6 +1362,8 @@ bool writer_t::to_plaintext( const std::string & var_name , const value_t & x )
     }
   
   // write variable/value to buffer
+
+  tally( var_name , x );
   
   curr_zfile->set_value( var_name , x.str() );    
 
@@ -1359,6 +1371,42 @@ bool writer_t::to_plaintext( const std::string & var_name , const value_t & x )
 }
 
 
+void writer_t::use_colstore( const std::string & r )
+{
+  // as for plaintext, an in-memory DB to store factor information, etc
+  close();
+  attach( ":memory:" );
+  dbless = true;
+  plaintext = false;
+  zfiles = NULL;
+  curr_zfile = NULL;
+  retval = NULL;
+  
+  plaintext_root = r;
+  colstore = new colstore_t( r );
+  curr_coltable = NULL;
+}
+
+
+bool writer_t::to_colstore( const std::string & var_name , const value_t & x )
+{
+  
+  // find table, and set row, only after command/strata have changed
+  
+  if ( curr_coltable == NULL ) 
+    {
+      curr_coltable = colstore->table( curr_command.cmd_name , curr_strata.print_zfile_tag() );
+      curr_coltable->row( curr_indiv.indiv_name , faclvl() );
+    }
+  
+  tally( var_name , x );
+  
+  curr_coltable->value( var_name , x );
+  
+  return true;
+}
+
+
 void writer_t::update_plaintext_curr_strata()
 {
 
@@ -1425,6 +1473,8 @@ bool writer_t::level( const std::string & level_name , const std::string & facto
   
   // if needed, update which table to point to
   if ( plaintext ) update_plaintext_curr_strata();
+
+  curr_coltable = NULL;
   
   return true;
 }
@@ -1482,4 +1532,5 @@ void writer_t::set_types()
   numeric_factor( "PHASE" );
   numeric_factor( "PSC" );
   numeric_factor( "SEG" );
+  numeric_factor( "CMD" );
 }
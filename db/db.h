@@ -41,6 +41,8 @@ struct timepoint_t;
 struct command_t;
 struct factor_t;
 struct level_t;
+struct colstore_t;
+struct colstore_table_t;
 
 
 
@@ -555,7 +557,7 @@ class writer_t
   // database
   //
   
-  writer_t() { dbless = true; plaintext = false; zfiles = NULL ; curr_zfile = NULL ; retval = NULL; } 
+  writer_t() { dbless = true; plaintext = false; zfiles = NULL ; curr_zfile = NULL ; retval = NULL; colstore = NULL; curr_coltable = NULL; nvalues = 0; nbytes = 0; } 
   
   bool attach( const std::string & filename , bool readonly = false )
   {
@@ -623,6 +625,9 @@ class writer_t
     plaintext_root = r ;
   } 
 
+  // columnar binary tables (-b), see db/colstore.h
+  void use_colstore( const std::string & r );
+
   
   bool open_db() const 
   { 
@@ -632,7 +637,7 @@ class writer_t
   }
 
   
-  std::string name() const { return plaintext ? plaintext_root : ( dbless ? "." : db.name() ) ; } 
+  std::string name() const { return plaintext || colstore != NULL ? plaintext_root : ( dbless ? "." : db.name() ) ; } 
 
   void index() { if ( open_db() ) db.index(); } 
   void drop_index() { if ( open_db() ) db.drop_index(); } 
@@ -709,6 +714,8 @@ class writer_t
 	commands[ curr_command.cmd_id ] = curr_command;
       }
 
+    curr_coltable = NULL;
+
     return true;
 
   }
@@ -725,6 +732,8 @@ class writer_t
 	individuals_idmap[ indiv_name ] = curr_indiv.indiv_id;
 	individuals[ curr_indiv.indiv_id ] = curr_indiv;
       }
+
+    curr_coltable = NULL;
     
     // do we ned to set a new zfile? 
     
@@ -805,6 +814,8 @@ class writer_t
     // if needed, update which table to point to
     if ( plaintext ) update_plaintext_curr_strata();
 
+    curr_coltable = NULL;
+
     return true;
   }
   
@@ -816,6 +827,8 @@ class writer_t
     // if needed, update which table to point to
     if ( plaintext ) update_plaintext_curr_strata();
 
+    curr_coltable = NULL;
+
     return true;
   }
   
@@ -845,6 +858,7 @@ class writer_t
     if ( e == -1 ) 
       {
 	curr_timepoint.timeless();
+	curr_coltable = NULL;
 	return true;
       }
     
@@ -876,6 +890,7 @@ class writer_t
     if ( interval.start == 0 && interval.stop == 0 )
       {
 	curr_timepoint.timeless();
+	curr_coltable = NULL;
 	return true;
       }
 
@@ -912,6 +927,8 @@ class writer_t
     // if needed, update which table to point to
     if ( plaintext ) update_plaintext_curr_strata();
 
+    curr_coltable = NULL;
+
     return true;
   }
   
@@ -932,7 +949,7 @@ class writer_t
   {    
     //    std::cout << "add-v :" << var_name << " " << d << "\n";
     if ( retval != NULL ) return to_retval( var_name , d );
-    else if ( dbless ) return plaintext ? to_plaintext( var_name , value_t( d ) ) : to_stdout( var_name , value_t( d ) ) ;
+    else if ( dbless ) return plaintext ? to_plaintext( var_name , value_t( d ) ) : colstore != NULL ? to_colstore( var_name , value_t( d ) ) : to_stdout( var_name , value_t( d ) ) ;
     if ( desc != "" ) var( var_name , desc );
     return value( var_name , value_t( d ) ) ;
   }
@@ -940,7 +957,7 @@ class writer_t
   bool value( const std::string & var_name , int i , const std::string & desc = "" ) 
   { 
     if ( retval != NULL ) return to_retval( var_name , i ); 
-    else if ( dbless ) return plaintext ? to_plaintext( var_name , value_t( i ) ) : to_stdout( var_name , value_t( i ) ) ; 
+    else if ( dbless ) return plaintext ? to_plaintext( var_name , value_t( i ) ) : colstore != NULL ? to_colstore( var_name , value_t( i ) ) : to_stdout( var_name , value_t( i ) ) ; 
     if ( desc != "" ) var( var_name , desc ); 
     return value( var_name , value_t( i ) ) ; 
   } 
@@ -948,7 +965,7 @@ class writer_t
   bool value( const std::string & var_name , const std::string & s , const std::string & desc = "" )
   {
     if ( retval != NULL ) return to_retval( var_name , s );
-    if ( dbless ) return plaintext ? to_plaintext( var_name , value_t( s ) ) : to_stdout( var_name , value_t( s ) ); 
+    if ( dbless ) return plaintext ? to_plaintext( var_name , value_t( s ) ) : colstore != NULL ? to_colstore( var_name , value_t( s ) ) : to_stdout( var_name , value_t( s ) ); 
     if ( desc != "" ) var( var_name , desc );
     return value( var_name , value_t( s ) ) ;
   }
@@ -956,7 +973,7 @@ class writer_t
   bool missing_value( const std::string & var_name , const std::string & desc = "" )
   {
     if ( retval != NULL ) return to_retval( var_name ); // missing value 
-    if ( dbless ) return plaintext ? to_plaintext( var_name , value_t() ) : to_stdout( var_name , value_t() ); 
+    if ( dbless ) return plaintext ? to_plaintext( var_name , value_t() ) : colstore != NULL ? to_colstore( var_name , value_t() ) : to_stdout( var_name , value_t() ); 
     if ( desc != "" ) var( var_name , desc );
     return value( var_name , value_t() );
   }
@@ -967,8 +984,10 @@ class writer_t
     // this should never be called in retval mode, but just in case... 
     if ( retval != NULL ) Helper::halt( "internal error in value(), should not get here" );
 
-    if ( dbless ) return plaintext ? to_plaintext( var_name , x ) : to_stdout( var_name , x );
+    if ( dbless ) return plaintext ? to_plaintext( var_name , x ) : colstore != NULL ? to_colstore( var_name , x ) : to_stdout( var_name , x );
 
+    tally( var_name , x );
+    
     // use 'command.var' as the unique identifier
 
     std::string var_key = curr_command.cmd_name + ":" + var_name;
@@ -997,6 +1016,8 @@ class writer_t
 
   bool to_stdout( const std::string & var_name , const value_t & x )  
   {
+    tally( var_name , x );
+
     std::cout << curr_indiv.indiv_name << "\t"
 	      << curr_command.cmd_name ;
     
@@ -1014,8 +1035,21 @@ class writer_t
   }
 
   
+  // running totals of values (and payload bytes) written, for profile=T
+  
+  uint64_t nvalues;
+  uint64_t nbytes;
+
+  void tally( const std::string & var_name , const value_t & x )
+  {
+    ++nvalues;
+    nbytes += var_name.size() + ( x.is_string() ? x.s.size() : x.is_missing() ? 0 : 8 );
+  }
+  
   bool to_plaintext( const std::string & var_name , const value_t & x ) ;
 
+  bool to_colstore( const std::string & var_name , const value_t & x ) ;
+
   
   bool to_retval( const std::string & var_name , double d )
   {
@@ -1164,6 +1198,16 @@ class writer_t
   
   zfile_t * curr_zfile;
 
+  //
+  // alternatively, dbless but write columnar binary tables (one file
+  // per command/table, spanning all individuals); curr_coltable is reset
+  // whenever the current command/individual/strata changes
+  //
+
+  colstore_t * colstore;
+
+  colstore_table_t * curr_coltable;
+
   //
   // write to a retval_t, instead of a DB
   //
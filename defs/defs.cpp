@@ -147,6 +147,11 @@ bool globals::verbose;
 bool globals::Rmode;
 bool globals::Rdisp;
 bool globals::devel;
+int globals::nthreads;
+bool globals::float_channels;
+std::string globals::cache_folder;
+bool globals::profile;
+std::string globals::profile_trace;
 
 std::string globals::epoch_strat;
 std::string globals::time_strat;
@@ -225,6 +230,16 @@ void globals::init_defs()
   verbose = false; 
 
   devel = false;
+
+  nthreads = 1;
+
+  float_channels = false;
+
+  cache_folder = "";
+
+  profile = false;
+
+  profile_trace = "";
 		 
   time_format_dp = 3;
 
@@ -306,6 +306,20 @@ struct globals
 
   // devel
   static bool devel;
+
+  // number of worker threads for parallel routines (nthreads=N)
+  static int nthreads;
+
+  // keep modified channels as physical values in memory, only
+  // quantized to EDF digital values on WRITE (float-channels=T)
+  static bool float_channels;
+
+  // persistent cache folder (cache-dir=folder), or empty if not used
+  static std::string cache_folder;
+
+  // per-command profiling (profile=T), optionally also as Chrome trace JSON (profile-trace=file)
+  static bool profile;
+  static std::string profile_trace;
   
   // global functions: primary initiation of all globals
   void init_defs();
@@ -267,66 +267,41 @@ bool cfc_t::glm()
   // Step 4) Generate predictors
 
   // nb. no intercept, as we performed above normalization
-  Data::Matrix<double> x( nrow , 3 , 1 );
+  Eigen::MatrixXd x( nrow , 3 );
+  Eigen::MatrixXd y( nrow , 1 );
   
   for (int i = 0 ; i < nrow ; i++)
     {
-      x[i][0] = pha_sin[i];
-      x[i][1] = pha_cos[i];
-      x[i][2] = ampa[i];
+      x(i,0) = pha_sin[i];
+      x(i,1) = pha_cos[i];
+      x(i,2) = ampa[i];
+      y(i,0) = ampb[i];
     }
-
-  Data::Vector<double> y(ampb);
   
   //
   // Fit GLM
   //
 
-  GLM glm( GLM::LINEAR );
-  
-  glm.set( y , x ); 
+  mass_glm_t glm;
   
-  glm.fit();
-      
-  bool valid = glm.valid();
+  bool valid = glm.set( x ) && glm.fit( y );
  
-  std::vector<bool> mask;
-  Data::Vector<double> beta;
-  Data::Vector<double> se;
-  Data::Vector<double> lowci;
-  Data::Vector<double> uprci;
-  Data::Vector<double> statistic;
-  Data::Vector<double> pvalue;
-  
   if ( valid ) 
     {
-      glm.display( &beta, &se, &pvalue , &mask, &lowci, &uprci, &statistic );
-      
-      // const int nterms = beta.size();
-      // for (int b = 0 ; b < nterms ; b++)
-      //   {
-      //     std::cout << "b" << b << "\t" 
-      //               << beta[b] << "\t" 
-      //               << se[b] << "\t" 
-      //               << pvalue[b] << "\t" 
-      //               << lowci[b] << "\t" 
-      //               << uprci[b] << "\n";
-      //   }
-      
-      
+
       //
       // Calculate measures
       //
       
       // phase-ampitude coupling ( 0..1 )  r_PAC = sqrt( b1^2 + b2^2 ) ; report here R^2
-      r_PAC = beta[0] * beta[0] + beta[1] * beta[1] ;
+      r_PAC = glm.B(0,0) * glm.B(0,0) + glm.B(1,0) * glm.B(1,0) ;
       
       // amplitude-amplitude coupling (correl -1 .. +1)
-      c_AMP = beta[2];
+      c_AMP = glm.B(2,0);
       z_AMP = 0.5 * log( ( 1 + c_AMP ) / ( 1 - c_AMP ) );
       
       // total r^2
-      r2_TOT = glm.calc_rsqr();
+      r2_TOT = glm.R2[0];
     }
   
   return valid;
@@ -31,6 +31,7 @@
 #include "eval.h"
 #include "helper/helper.h"
 #include "helper/logger.h"
+#include "helper/threads.h"
 #include "db/db.h"
 
 #include <iomanip>
@@ -311,143 +312,179 @@ void dsptools::ecgsuppression( edf_t & edf , param_t & param )
 
 
   //
-  // process each signal
+  // Beat windows: from 200ms before each R peak to 200ms before the
+  // next (but no more than 2 seconds); these are the same for all
+  // channels
   //
+  
+  const int npeaks = peaks.R_t.size();
+  
+  // i.e. averaged signal is only up to 2.0 seconds max
+  const int mxdur = 2 * sr; 
+  const int pnts_200ms = 0.2 * sr;
 
-  for (int s = 0 ; s < ns ; s++ )
+  std::vector<int> win_p1, win_p2;
+  
+  // number of beats contributing to each point of the template
+  std::vector<int> win_n( mxdur , 0 );
+  
+  for (int i=0;i<npeaks-1;i++)
     {
+      uint64_t p = peaks.R_i[i];
+      if ( p < pnts_200ms ) continue;	  
+      uint64_t p1 = p - pnts_200ms;
+      uint64_t p2 = peaks.R_i[i+1] - pnts_200ms;
+      
+      // ensure no larger than 2 seconds
+      if ( p2 - p1 >= mxdur ) p2 = p1 + mxdur - 1;	  
 
-      // skip annotations channels
-      if ( edf.header.is_annotation_channel( signals(s) ) ) continue;
+      win_p1.push_back( p1 );
+      win_p2.push_back( p2 );
+      for (int c=0; c <= p2 - p1; c++) ++win_n[c];
+    }
 
-      // skip ECG if that is included
+  const int nwin = win_p1.size();
+
+  
+  //
+  // EEG channels to process (skipping annotations, and the ECG if that is included)
+  //
+
+  std::vector<int> chs;
+  for (int s = 0 ; s < ns ; s++ )
+    {
+      if ( edf.header.is_annotation_channel( signals(s) ) ) continue;
       if ( signals.label(s) == ecg_label ) continue;
+      chs.push_back( s );
+    }
 
-      //
-      // Output stratified by signal
-      //
+  const int nch = chs.size();
 
-      writer.level( signals.label(s) , globals::signal_strat );
-      
-      // get average waverform/adjust EEG
-      slice_t slice( edf , signals(s) , interval );    
-      std::vector<double> * sig  = slice.nonconst_pdata();
-      
-      if ( ecg->size() != sig->size() ) 
-	Helper::halt( "internal error, signals different length in coherence()");
+  
+  //
+  // Process channels in blocks (one per thread): pull, then build the
+  // average artifact template and subtract it, making a single pass
+  // over the beat windows for each, in parallel across channels
+  //
 
+  const int nt = Helper::nthreads( nch );
 
-      //
-      // Mean centre signal first
-      //
-      
-      MiscMath::centre( sig );
-      
-      
-      //
-      // Build up average profile around peak
-      //
-      
-      const int npeaks = peaks.R_t.size();
-      
-      // i.e. averaged signal is only up to 2.0 seconds max
-      const int mxdur = 2 * sr; 
-      const int pnts_200ms = 0.2 * sr;
-      
-      // matrix is R/C time-points/beats
-      // i.e. so we will average for each time-point, over all beats
-      
-      std::vector<std::vector<double> > mat( mxdur );
-      for (int i=0;i<npeaks-1;i++)
+  std::vector<std::vector<double> > d( nt );
+  std::vector<std::vector<double> > art( nt );
+
+  for (int c0 = 0 ; c0 < nch ; c0 += nt )
+    {
+
+      const int c1 = std::min( nch , c0 + nt );
+
+      for (int c = c0 ; c < c1 ; c++ )
 	{
-	  uint64_t p = peaks.R_i[i];
-	  if ( p < pnts_200ms ) continue;	  
-	  uint64_t p1 = p - pnts_200ms;
-	  uint64_t p2 = peaks.R_i[i+1] - pnts_200ms;
-	  
-	  // ensure no larger than 2 seconds
-	  if ( p2 - p1 >= mxdur ) p2 = p1 + mxdur - 1;	  
-	  int c = 0;
-	  for (int j=p1;j<=p2;j++) 
-	    mat[c++].push_back( (*sig)[j] );	    
+	  slice_t slice( edf , signals(chs[c]) , interval );    
+	  d[ c - c0 ].swap( *slice.nonconst_pdata() );
 	  
+	  if ( ecg->size() != d[ c - c0 ].size() ) 
+	    Helper::halt( "internal error, signals different length in ecgsuppression()" );
 	}
       
-           
-      
-      //
-      // Get average artifact matrix (i.e. in EEG signals) 
-      //
-      
-      std::vector<double> art( mat.size() , 0 );
-      
-      double art_rms = 0;
-
-      for (int i=0;i<mat.size();i++)
-	{
+      Helper::parallel_for( c1 - c0 , [&]( int j ) {
 	  
-	  double denom = mat[i].size() / (double)npeaks;
+	  std::vector<double> & sig = d[j];
 	  
-	  double m = MiscMath::mean( mat[i] );
+	  //
+	  // Mean centre signal first
+	  //
 	  
-	  art[i] = m * denom;
+	  MiscMath::centre( &sig );
 	  
 	  //
-	  // Output correction matrix
+	  // Build up average profile around peak, i.e. for each
+	  // time-point, averaged over all beats
 	  //
 
-	  writer.level( i , "SP" );
-	  writer.value( "ART" , art[i] );
+	  std::vector<double> sum( mxdur , 0 );
 
-	  art_rms += art[i] * art[i];
-	  
-	}
-
-      writer.unlevel( "SP" );
+	  for (int w=0; w<nwin; w++)
+	    {
+	      int c = 0;
+	      for (int i=win_p1[w]; i<=win_p2[w]; i++)
+		sum[c++] += sig[i];
+	    }
 
-      // RMS of mean artifact signature, i.e. a simple index
-      // of the extent of cardiac contamination
+	  //
+	  // Get average artifact (i.e. in EEG signals), scaled by the 
+	  // proportion of all beats contributing to that point
+	  //
+	  
+	  art[j].resize( mxdur );
 
-      art_rms /= (double)mat.size();
-      art_rms = sqrt( art_rms );
-      writer.value( "ART_RMS" , art_rms );
+	  for (int i=0; i<mxdur; i++)
+	    {
+	      const double m = win_n[i] == 0 ? 0 : sum[i] / (double)win_n[i];
+	      art[j][i] = m * ( win_n[i] / (double)npeaks );
+	    }
+	  
+	  // 
+	  // Subtract out around peaks (will leave non-peaks untouced, but 
+	  // really aberrant epochs should have been masked out anyway)
+	  //
 
+	  for (int w=0; w<nwin; w++)
+	    {
+	      int c = 0;
+	      for (int i=win_p1[w]; i<=win_p2[w]; i++)
+		sig[i] -= art[j][c++];
+	    }
+	  
+	} , nt );
       
-    
-      // 
-      // Subtract out around peaks (will leave non-peaks untouced, but 
-      // really aberrant epochs should have been masked out anyway)
-      //
 
-      std::vector<double> nsig = *sig;
-
-      for (int i=0;i<npeaks-1;i++)
-	{
-	  uint64_t p = peaks.R_i[i];
-	  if ( p < pnts_200ms ) continue;	  
-	  uint64_t p1 = p - pnts_200ms;
-	  uint64_t p2 = peaks.R_i[i+1] - pnts_200ms;
-
-	  // ensure no larger than 2 seconds
-	  if ( p2 - p1 >= mxdur ) p2 = p1 + mxdur - 1;	  
-	  int c = 0;
-	  for (int j=p1;j<=p2;j++) 
-	    nsig[j] -= art[c++];
-	}
-      
       //
-      // Put EEG signal back
+      // Output stratified by signal, and put EEG signals back
       //
 
-      if ( ! nosuppression )
+      for (int c = c0 ; c < c1 ; c++ )
 	{
-	  logger << " updating ECG-corrected signal " << signals.label(s) << "\n";
-	  edf.update_signal( signals(s) , &nsig );      
-	}
+	  
+	  const int s = chs[c];
+	  
+	  writer.level( signals.label(s) , globals::signal_strat );
 
+	  const std::vector<double> & a = art[ c - c0 ];
+	  
+	  double art_rms = 0;
+	  
+	  for (int i=0;i<mxdur;i++)
+	    {
+	      
+	      //
+	      // Output correction matrix
+	      //
+	      
+	      writer.level( i , "SP" );
+	      writer.value( "ART" , a[i] );
+	      
+	      art_rms += a[i] * a[i];
+	    }
+	  
+	  writer.unlevel( "SP" );
+	  
+	  // RMS of mean artifact signature, i.e. a simple index
+	  // of the extent of cardiac contamination
+	  
+	  art_rms /= (double)mxdur;
+	  art_rms = sqrt( art_rms );
+	  writer.value( "ART_RMS" , art_rms );
+	  
+	  if ( ! nosuppression )
+	    {
+	      logger << " updating ECG-corrected signal " << signals.label(s) << "\n";
+	      edf.update_signal( signals(s) , &d[ c - c0 ] );      
+	    }
+	  
+	}
 
       //
-      // Next signal
+      // Next block of channels
       //
 
     }
@@ -469,50 +506,47 @@ rpeaks_t dsptools::mpeakdetect( const edf_t & edf ,
 
   if ( tp->size() != n ) Helper::halt("error in mpeakdetect");
 
-  rpeaks_t peaks( n );
+  rpeaks_t peaks( 0 );
   
-  // mean-center ECG
-  std::vector<double> x = MiscMath::centre( *d );
-  
-  // band-pass filter: 0.05-40Hz 
+  // mean-center ECG, and band-pass filter: 0.05-40Hz 
     
-  std::vector<double> bpf = dsptools::apply_fir( x , Fs , fir_t::BAND_PASS ,
+  std::vector<double> bpf = dsptools::apply_fir( MiscMath::centre( *d ) , Fs , fir_t::BAND_PASS ,
 						 1, // Kaiser window
 						 0.02 , 0.5 , // ripple, TW
 						 0.5 , 40 ) ;  // f1, f2
 
-  // differentiate and sqr data
-  std::vector<double> sq( n - 1 );
-  for (int i=0;i<n-1;i++) 
-    sq[i] = ( bpf[i+1] - bpf[i] ) * ( bpf[i+1] - bpf[i] );
-
-  // integrate over 7 points (i.e. sum)  
-  // d=[1 1 1 1 1 1 1]; % window size - intialise
-  // x = filter(d,1,sqr);
+  //
+  // Differentiate and sqr data, then integrate over 7 points (i.e. sum)
+  //  d=[1 1 1 1 1 1 1]; % window size - intialise
+  //  x = filter(d,1,sqr);
+  // and remove filter delay, i.e. skip first 'delay-1' elements
+  //
+  // This is evaluated on-the-fly from bpf[] (only ever looking 7 points
+  // back), in the two scans below, rather than holding whole-trace copies
+  // of each intermediate step
+  //
   
-  std::vector<double> ss( n - 1 , 0 );
-  for (int i=0; i < n-1; i++)
-    for (int j = 0 ; j < 7 ; j++ )
-      if ( i-j >= 0 ) ss[i] += sq[i-j];
+  const int delay = ceil( 7 / 2.0 );
 
-  // median filter, window size of 10
-  std::vector<double> mf = MiscMath::median_filter( ss , 10 );
-
-  // remove filter delay
-  int delay = ceil( 7 / 2.0 );
+  const int len = n - 1 - ( delay - 1 );
   
-  // i.e. skip first 'delay-1' elements, by starting at element 'delay-1', 
-  // put back into 'sq'
+  auto mdfint = [&]( const int k ) -> double
+    {
+      const int i = k + delay - 1;
+      double ss = 0;
+      for (int j = 0 ; j < 7 && i-j >= 0 ; j++ )
+	{
+	  const double df = bpf[i-j+1] - bpf[i-j];
+	  ss += df * df;
+	}
+      return ss;
+    };
   
-  std::vector<double> mdfint;
-  for (int i=delay-1;i<ss.size();i++) mdfint.push_back( ss[i] );
-
   //
-  // segment search area (on 'sq')
+  // segment search area
   //
   
   //  max_h = max (mdfint(round(len/4):round(3*len/4)));
-  int len = mdfint.size();
   
   // int s1 = round( len/4.0 );
   // int s2 = round( 3*len/4.0 );
@@ -528,7 +562,10 @@ rpeaks_t dsptools::mpeakdetect( const edf_t & edf ,
       int s2 = s1 + e30 - 1 ;  
       double max_h = 0;
       for (int i = s1; i <= s2 ; i++ ) 
-	if ( mdfint[i] > max_h ) max_h = mdfint[i];
+	{
+	  const double m = mdfint( i );
+	  if ( m > max_h ) max_h = m;
+	}
       maxvals.push_back( max_h );
   }
   
@@ -537,58 +574,56 @@ rpeaks_t dsptools::mpeakdetect( const edf_t & edf ,
   double thresh = 0.2;  
   double th = max_h * thresh;
   
-
-  // get segments
-  std::vector<int> left;
-  std::vector<int> right;
-  bool inregion = false;
-  for (int i=0;i<mdfint.size();i++)
-    {
-      bool pk = mdfint[i] > th ;
-      if ( pk && ! inregion ) left.push_back(i);
-      if ( inregion && !pk ) right.push_back(i);
-      inregion = pk;
-    }
-  if ( inregion ) right.push_back( mdfint.size()-1 );
+  //
+  // get segments, and the max/min point within each segment
+  // (i.e. from the first point above threshold, to the first
+  // point after that falls below it), in a single scan
+  //
 
   std::vector<int> maxloc, minloc;
-  std::vector<double> maxval, minval;
+
+  bool inregion = false;
+  double mx = 0 , mn = 0;
+  int mxi = 0 , mni = 0;
   
-  // get max point within each segment
-  for (int i=0;i<left.size();i++)
+  for (int i=0;i<len;i++)
     {
-
-      int p1 = left[i];
-      int p2 = right[i];
+      bool pk = mdfint( i ) > th ;
       
-      // sanity check on size of region?
-      double mx = bpf[p1];
-      int mxi = p1;
-
-      double mn = bpf[p1];
-      int mni = p1;
+      if ( pk && ! inregion )
+	{
+	  mx = mn = bpf[i];
+	  mxi = mni = i;
+	}
       
-      for (int j=p1;j<=p2;j++) 
+      if ( pk || inregion )
 	{
-
-	  if ( bpf[j] > mx ) 
+	  if ( bpf[i] > mx ) 
 	    {
-	      mx = bpf[j];
-	      mxi = j;
+	      mx = bpf[i];
+	      mxi = i;
 	    }
 	  
-	  if ( bpf[j] < mn ) 
+	  if ( bpf[i] < mn ) 
 	    {
-	      mn = bpf[j];
-	      mni = j;
+	      mn = bpf[i];
+	      mni = i;
 	    }
 	}
       
-      maxloc.push_back( mxi );
-      maxval.push_back( mx );
+      if ( inregion && ! pk )
+	{
+	  maxloc.push_back( mxi );
+	  minloc.push_back( mni );
+	}
+      
+      inregion = pk;
+    }
 
+  if ( inregion )
+    {
+      maxloc.push_back( mxi );
       minloc.push_back( mni );
-      minval.push_back( mn );
     }
   
   // %%%%%%%%%% check for lead inversion %%%%%%%%%
@@ -677,10 +712,6 @@ rpeaks_t dsptools::mpeakdetect( const edf_t & edf ,
   // mirror->R_t = t_R;
   // mirror->R_i = i_R;
 
-  // summarize
-  // total time
-  double mx = (*tp)[ tp->size() - 1 ];
-  
   return peaks;
   
 }
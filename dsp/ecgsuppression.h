@@ -38,14 +38,10 @@ struct rpeaks_t
   {
     R_t.resize( n );
     R_i.resize( n );
-    R_amp.resize( n );
-    S_amp.resize( n );
   }
   
   std::vector<uint64_t> R_t;
   std::vector<uint64_t> R_i;
-  std::vector<double> R_amp;
-  std::vector<double> S_amp;
   
   double bpm( interval_t & , double lwr = 0 , double upr = 0 ) ;
   
@@ -27,9 +27,13 @@
 #include "miscmath/miscmath.h"
 #include "dsp/fir.h"
 #include "defs/defs.h"
+#include "helper/threads.h"
 
 #include <iostream>
 #include <cmath>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
 
 
 
@@ -94,21 +98,37 @@ hilbert_t::hilbert_t( const std::vector<double> & d , const int sr , double lwr
 void hilbert_t::proc()
 {
 
-  int n = input.size();
+  const int n = input.size();
+
+  // FFT size: n itself if 2/3/5/7-smooth, otherwise zero-pad to the next
+  // such size, as whole-night lengths with large prime factors are the
+  // worst case for FFTW
+  
+  const int m = n == 0 ? 0 : MiscMath::nextsmooth( n );
+  
+  // a single complex buffer holds the spectrum, and then (in place)
+  // the analytic signal
   
-  // 1) take FFT
-  real_FFT fft( n , n , 1 );
-  fft.apply( input );
-  std::vector<dcomp> f = fft.transform();
-  if ( f.size() != n ) Helper::halt( "internal error in hilbert()" );
+  double * in = (double*) fftw_malloc( sizeof(double) * m );
+  fftw_complex * z = (fftw_complex*) fftw_malloc( sizeof(fftw_complex) * m );
+  
+  fftw_plan pf = fftw_plan_dft_r2c_1d( m , in , z , FFTW_ESTIMATE );
+  fftw_plan pb = fftw_plan_dft_1d( m , z , z , FFTW_BACKWARD , FFTW_ESTIMATE );
+
+  // 1) take FFT (r2c, i.e. only non-negative frequencies, 0 .. m/2)
 
+  for (int i=0; i<n; i++) in[i] = input[i];
+  for (int i=n; i<m; i++) in[i] = 0;
+  
+  fftw_execute( pf );
+  
   // 2) Adjusted postive/negative frequencies
   
-  int pos_idx = floor(n/2.0) + ( n % 2 ) - 1;
-  int neg_idx = ceil(n/2.0) + ( ! ( n % 2 ) );
+  const int pos_idx = floor(m/2.0) + ( m % 2 ) - 1;
+  const int neg_idx = ceil(m/2.0) + ( ! ( m % 2 ) );
   
-  for (int i = 1 ; i <= pos_idx ; i++ ) f[i] *= 2;
-  for (int i = neg_idx ; i < n ; i++ ) f[i] = 0;
+  for (int i = 1 ; i <= pos_idx ; i++ ) { z[i][0] *= 2; z[i][1] *= 2; } 
+  for (int i = neg_idx ; i < m ; i++ ) { z[i][0] = 0; z[i][1] = 0; } 
 
   // equivalent to rotating Fourier coefficients by computing the
   // iAsin(2pft) component, i.e., the phase quadrature) positive
@@ -118,13 +138,14 @@ void hilbert_t::proc()
   // f(posF) = f(posF) + -1i*complexf(posF);
   // f(negF) = f(negF) +  1i*complexf(negF);
   
-  // 3) Inverse FFT of the rotated coefficients 
-  FFT ifft( n , n , 1 , FFT_INVERSE );
-  ifft.apply( f );
-  std::vector<dcomp> ht = ifft.scaled_transform();
-  
-  if ( ht.size() != n ) Helper::halt( "problem in hilbert()" );
+  // 3) Inverse FFT of the rotated coefficients (and drop any padding)
+
+  fftw_execute( pb );
 
+  fftw_destroy_plan( pf );
+  fftw_destroy_plan( pb );
+  fftw_free( in );
+  
   // 4) Store phase, magnitude
 
   ph.resize( n );
@@ -139,8 +160,8 @@ void hilbert_t::proc()
   
   for(int i=0;i<n;i++)
     {
-      double a = std::real( ht[i] ) ;
-      double b = std::imag( ht[i] ) ;
+      double a = z[i][0] / (double)m ;
+      double b = z[i][1] / (double)m ;
       ph[i] = atan2( b , a );
       mag[i] = sqrt( a*a + b*b );     
 
@@ -148,9 +169,11 @@ void hilbert_t::proc()
 	{
 	  // real_part[i] = a;
 	  // imag_part[i] = b;
-	  conv_complex[i] = ht[i] ;
+	  conv_complex[i] = dcomp( a , b ) ;
 	}      
     }
+
+  fftw_free( z );
 }
 
 
@@ -213,6 +236,15 @@ void hilbert_t::bin( double p , int bs , std::vector<int> * acc ) const
 }
 
 
+// as bin(), but returns the bin index, or -1 if out of range (i.e. does
+// not call halt(), so can be used by the surrogate worker threads)
+
+static inline int phase_bin( const double p , const int bs , const int nbins )
+{
+  const int b = (int)floor( MiscMath::as_angle_0_pos2neg( p ) ) / bs;
+  return b < 0 || b >= nbins ? -1 : b ;
+}
+
 
 itpc_t::itpc_t( const int ne , const int nbins )
 {
@@ -443,189 +475,268 @@ itpc_t hilbert_t::phase_events( const std::vector<int> & e ,
   // (for within-SO permutation, each spindle will have its own shuffle boundaries)
   
   const int maxshuffle = es ? es : mx ;
-   
+
   //
-  // Each null replicate
+  // Surrogate engine: the SO-phase lookups (unit vector and phase
+  // bin) are precomputed once for the whole signal, but only if the
+  // total number of surrogate lookups exceeds the signal length
+  // (otherwise, it is cheaper to evaluate them directly)
   //
 
-  for (int r = 0 ; r < nreps ; r++ ) 
-    {
+  const bool precomp = (double)n * (double)nreps > (double)mx ;
 
-      // get permutation shift for unconstrained OR within-epoch permutation; this is applied similarly across
-      // all spindles
-      
-      int pp = CRandom::rand( maxshuffle );
-            
-      // overlap stats (i.e. based on standard permutation)
-      
-      int overlap = 0;  // for overlap statistic
+  std::vector<double> ucos, usin;
+  std::vector<signed char> ubin;
 
-      std::vector<int> pbacc( nbins , 0 ); // phase-bin accumulator                                                                                        
-      
-      // magnitude stats (may be from within-SO permutation if mask defined
+  if ( precomp )
+    {
+      ucos.resize( mx );
+      usin.resize( mx );
+      if ( by_phase ) ubin.resize( mx );
+      for (int j=0; j<mx; j++)
+	{
+	  ucos[j] = cos( ph[j] );
+	  usin[j] = sin( ph[j] );
+	  if ( by_phase ) 
+	    {
+	      const int b = phase_bin( ph[j] , binsize , nbins );
+	      if ( b == -1 ) Helper::halt( "internal error in hilbert_t::bin() " );
+	      ubin[j] = b;
+	    }
+	}
+    }
+  
+  //
+  // Reproducible seeding: one seed per replicate, drawn here from the
+  // main RNG, so results do not depend on the number of threads
+  //
+  
+  std::vector<unsigned int> seeds( nreps );
+  for (int r = 0 ; r < nreps ; r++ ) 
+    seeds[r] = CRandom::rand( 2147483647 );
+
+  //
+  // Output slots for each null replicate
+  //
 
-      dcomp s(0,0);
+  itpc.ninc.perm.resize( nreps );
+  itpc.itpc.perm.resize( nreps );
+  itpc.pv.perm.resize( nreps );
+  itpc.sig.perm.resize( nreps );
+  itpc.angle.perm.resize( nreps );
+  if ( by_phase ) 
+    for (int b=0; b < nbins; b++) 
+      itpc.phasebin[b].perm.resize( nreps );
 
-      int counted = 0;  // denom for within-SO permutation 
-        
+  //
+  // Split replicates into blocks, spread over threads; each block
+  // keeps its own scratch buffers
+  //
 
-      for (int i=0;i<n;i++)
-	{  
+  const int nt = Helper::nthreads( nreps );
+  const int nblocks = std::min( nreps , nt * 4 );
+  const int bsize = ( nreps + nblocks - 1 ) / nblocks;
+  
+  Helper::parallel_for( nblocks , [&]( const int blk ) {
+      
+      const int r0 = blk * bsize;
+      const int r1 = std::min( nreps , r0 + bsize );
+
+      // permuted sample-point for each spindle, and whether it is
+      // included in the ITPC calculation (i.e. based on the observed event)
+      std::vector<int> pei( n );
+      std::vector<int> inc;
+      inc.reserve( n );
+      
+      std::vector<int> pbacc( nbins );
+      
+      for (int r = r0 ; r < r1 ; r++ ) 
+	{
 	  
-	  //
-	  // basic permutation
-	  //
+	  std::mt19937 rng( seeds[r] );
 
-	  int pei = e[i] + pp ;
+	  // get permutation shift for unconstrained OR within-epoch permutation; this is applied similarly across
+	  // all spindles
 	  
-	  // check for wrapping
-
-	  if ( es == 0 ) // whole-signal shuffle
-	    {
-	      if ( pei >= maxshuffle ) pei -= maxshuffle;
-	    }
-	  else // within-epoch shuffle
-	    {
-	      if ( eoffset[i] + pp >= maxshuffle ) pei -= maxshuffle;
-	    }
+	  int pp = std::uniform_int_distribution<int>( 0 , maxshuffle - 1 )( rng );
 	  
+	  // overlap stats (i.e. based on standard permutation)
+	  
+	  int overlap = 0;  // for overlap statistic
+	  
+	  std::fill( pbacc.begin() , pbacc.end() , 0 );
+	  
+	  inc.clear();
+
 	  //
-	  // overlap?
+	  // 1) build the batch of permuted indices
 	  //
 	  
-	  if ( mask != NULL ) 
-	    { 
-	      if ( (*mask)[ pei ] ) 
+	  for (int i=0;i<n;i++)
+	    {  
+	      
+	      //
+	      // basic permutation
+	      //
+	      
+	      pei[i] = e[i] + pp ;
+	      
+	      // check for wrapping
+	      
+	      if ( es == 0 ) // whole-signal shuffle
 		{
-		  ++overlap;
+		  if ( pei[i] >= maxshuffle ) pei[i] -= maxshuffle;
+		}
+	      else // within-epoch shuffle
+		{
+		  if ( eoffset[i] + pp >= maxshuffle ) pei[i] -= maxshuffle;
+		}
+	      
+	      //
+	      // overlap?
+	      //
+	      
+	      if ( mask != NULL ) 
+		{ 
+		  // for SO-phase stratified, if a mask is set, use within-SO permutation (i.e. binning is below)
+		  if ( (*mask)[ pei[i] ] ) ++overlap;
+		}
+	      else
+		{
+		  // everything 'overlaps' if no mask...
+		  ++overlap;  
 		  
-		  // for SO-phase stratified, if a mask is set, use within-SO permutation (i.e. bin() is below)
-
+		  // SO-phase stratified overlap counts when no mask/SO given
+		  if ( by_phase )
+		    {
+		      const int b = precomp ? ubin[ pei[i] ] : phase_bin( ph[ pei[i] ] , binsize , nbins );
+		      if ( b == -1 ) throw std::runtime_error( "internal error in hilbert_t::bin() " );
+		      ++pbacc[ b ];
+		    }
 		}
-	    }
-	  else
-	    {
-	      // everything 'overlaps' if no mask...
-	      ++overlap;  
-
-	      // SO-phase stratified overlap counts when no mask/SO given
-	      if ( by_phase )
-		bin( ph[ pei ] , binsize , &pbacc );
-	    }
-
-
-	  
-// 	  std::cerr << "pp " << i << "\t" << e[i] << " " << ( mask == NULL ? "noM" : "M" ) << " " 
-// 		    << ( mask == NULL || (*mask)[e[i]] ) 
-// 		    << " - "
-// 		    << pei << " " << ( mask == NULL || (*mask)[pei] ) ;
-	  
-	 
-	  //
-	  // within-SO permutation, optionally modifies 'pei' for spindles that are originally in a SO (so_size>0)
-	  //
-
-	  if ( mask != NULL && so_size[i] != 0 ) 
-	    {
 	      
-	      // different random shift for each event, based on the spanning SO
-	      int shift = CRandom::rand( so_size[ i ] );
+	      //
+	      // within-SO permutation, optionally modifies 'pei' for spindles that are originally in a SO (so_size>0)
+	      //
 	      
-	      pei = e[i] + shift; 
-
-	      // check for wrapping out of SO (will handle end-of-signal case also)
-	      if ( so_offset[i] + shift >= so_size[i] ) pei -= so_size[i] ; 
+	      if ( mask != NULL && so_size[i] != 0 ) 
+		{
+		  
+		  // different random shift for each event, based on the spanning SO
+		  int shift = std::uniform_int_distribution<int>( 0 , so_size[i] - 1 )( rng );
+		  
+		  pei[i] = e[i] + shift; 
+		  
+		  // check for wrapping out of SO (will handle end-of-signal case also)
+		  if ( so_offset[i] + shift >= so_size[i] ) pei[i] -= so_size[i] ; 
+		  
+		  // check: this should never happen, i.e. as we are controlling for SO overlap in this case 
+		  if ( ! (*mask)[ pei[i] ] ) 
+		    throw std::runtime_error( "internal error in phase_events() perm" );
+		  
+		}
+	      
+	      //
+	      // now, pei should be correctly set, *either* based on default permutation (unconstrained or within-epoch) *or* 
+	      // within SO, if a mask has been specified (in which case, the within-epoch option is ignored, as it implicitly holds anyway, 
+	      // i.e. as within-SO is a subset of within-epoch...
+	      //
+	      
+	      // to be included?   this should only be based on whether the **observed** event was included
+	      // i.e. we do not want to include original events that were outside of a SO but were now permuted
+	      // into one by chance...   so e[i] here, not pei in the line below;  these ARE counted in the above OVERLAP 
+	      // calculation however, i.e. allowed to have SO overlap by chance, naturally, in null datasets
+	      
+	      if ( mask == NULL || (*mask)[ e[i] ] ) 
+		inc.push_back( pei[i] );
 	      
-	      // check: this should never happen, i.e. as we are controlling for SO overlap in this case 
-	      if ( mask != NULL && ! (*mask)[ pei ] ) Helper::halt( "internal error in phase_events() perm" );
-
 	    }
-
-// 	  std::cerr << " - "
-// 		    << pei << " " << ( mask == NULL || (*mask)[pei] )  << "\n";
 	  
 	  //
-	  // now, pei should be correctly set, *either* based on default permutation (unconstrained or within-epoch) *or* 
-	  // within SO, if a mask has been specified (in which case, the within-epoch option is ignored, as it implicitly holds anyway, 
-	  // i.e. as within-SO is a subset of within-epoch...
+	  // 2) gather phases for the included events, and accumulate ITPC
 	  //
 	  
-	  // to be included?   this should only be based on whether the **observed** event was included
-	  // i.e. we do not want to include original events that were outside of a SO but were now permuted
-	  // into one by chance...   so e[i] here, not pei in the line below;  these ARE counted in the above OVERLAP 
-	  // calculation however, i.e. allowed to have SO overlap by chance, naturally, in null datasets
+	  const int counted = inc.size();
 	  
-	  if ( mask == NULL || (*mask)[ e[i] ] ) 
+	  double sre = 0 , sim = 0;
+	  
+	  if ( precomp )
 	    {
-	      
-	      // accumulate ITPC
-	      s += exp( dcomp(0, ph[ pei ] ) );
-	      
-	      // and record that this event was included in the ITPC calculation
-	      ++counted;
+	      for (int k=0; k<counted; k++)
+		{
+		  sre += ucos[ inc[k] ];
+		  sim += usin[ inc[k] ];
+		}
 	      
 	      // SO-phase stratified overlap counts using within-SO permutation
 	      if ( by_phase )
-		bin( ph[ pei ] , binsize , &pbacc );
-	      
+		for (int k=0; k<counted; k++)
+		  ++pbacc[ ubin[ inc[k] ] ];
+	    }
+	  else
+	    {
+	      for (int k=0; k<counted; k++)
+		{
+		  const double p = ph[ inc[k] ];
+		  sre += cos( p );
+		  sim += sin( p );
+		  if ( by_phase )
+		    {
+		      const int b = phase_bin( p , binsize , nbins );
+		      if ( b == -1 ) throw std::runtime_error( "internal error in hilbert_t::bin() " );
+		      ++pbacc[ b ];
+		    }
+		}
 	    }
 	  
 	  //
-	  // next spindle
+	  // record stats
 	  //
 	  
-	}
-
-
-      //
-      // record stats
-      //
-            
-
-      // overlap statistics
-      //      std::cerr << "po = " << overlap << "\n";
-      
-      itpc.ninc.perm.push_back( overlap );
-      
-      if ( by_phase ) 
-	for (int b=0; b < nbins; b++) 
-	  itpc.phasebin[b].perm.push_back ( pbacc[b] );
-      
-
-      // this should not happen now, i.e. given within-SO permutation is employed is a SO-mask is set
-      // and so we likely do not need to handle this as a special case
-      
-      if ( counted == 0 )
-	{	  
-	  // if no obs, set ITPC to 0, PV = 1 	  
-	  itpc.itpc.perm.push_back( 0 );
-	  itpc.pv.perm.push_back( 1 );
-	  itpc.sig.perm.push_back( 0 );	  
-	  // angle to -9 (this should never be looked at, in any case), i.e. null 
-	  itpc.angle.perm.push_back( -9 );
-	}
-      else
-	{
-	  // normalise ITPC and return
-	  s /= double(counted);
+	  // overlap statistics
+	  
+	  itpc.ninc.perm[r] = overlap;
+	  
+	  if ( by_phase ) 
+	    for (int b=0; b < nbins; b++) 
+	      itpc.phasebin[b].perm[r] = pbacc[b];
+	  
+	  // this should not happen now, i.e. given within-SO permutation is employed is a SO-mask is set
+	  // and so we likely do not need to handle this as a special case
 	  
-          double itpc_perm =  abs( s );
-          itpc.itpc.perm.push_back( itpc_perm );
-	  //	  std::cout << "perm r , s, n = " << r << " "  << itpc_perm << " " << counted << "\n";
-	  // asymptotic significance
-	  double pv = exp( -counted * itpc_perm * itpc_perm ) ;
-	  itpc.pv.perm.push_back( pv ); // nb. not used currently
-	  itpc.sig.perm.push_back( pv < 0.05 ); // for mean under null
+	  if ( counted == 0 )
+	    {	  
+	      // if no obs, set ITPC to 0, PV = 1 	  
+	      itpc.itpc.perm[r] = 0;
+	      itpc.pv.perm[r] = 1;
+	      itpc.sig.perm[r] = 0;	  
+	      // angle to -9 (this should never be looked at, in any case), i.e. null 
+	      itpc.angle.perm[r] = -9;
+	    }
+	  else
+	    {
+	      // normalise ITPC and return
+	      dcomp s( sre / double(counted) , sim / double(counted) );
+	      
+	      double itpc_perm =  abs( s );
+	      itpc.itpc.perm[r] = itpc_perm;
 
-	  // angle (not used)
-	  itpc.angle.perm.push_back( MiscMath::as_angle_0_pos2neg( arg( s ) ) );
+	      // asymptotic significance
+	      double pv = exp( -counted * itpc_perm * itpc_perm ) ;
+	      itpc.pv.perm[r] = pv; // nb. not used currently
+	      itpc.sig.perm[r] = pv < 0.05; // for mean under null
+	      
+	      // angle (not used)
+	      itpc.angle.perm[r] = MiscMath::as_angle_0_pos2neg( arg( s ) );
+	      
+	    }
 
+	  //
+	  // Next null replicate
+	  //
 	}
-
-      //
-      // Next null replicate
-      //
-    }
+      
+    } , nt );
 
   // get empirical p-values
   itpc.itpc.calc_stats();
@@ -36,6 +36,10 @@
 #include "db/db.h"
 #include "helper/helper.h"
 #include "helper/logger.h"
+#include "helper/threads.h"
+
+#include <map>
+#include <mutex>
 
 extern writer_t writer;
 extern logger_t logger; 
@@ -55,6 +59,39 @@ mtm_t::mtm_t( const double npi , const int nwin ) : npi(npi) , nwin(nwin)
 
 void mtm_t::store_tapers( const int seg_size ) 
 {
+
+  // tapers depend only on (segment size, nw, t), so keep a single
+  // process-wide copy, shared across channels, individuals and calls;
+  // nb. also serializes generate_tapers(), as the EISPACK routines
+  // (jtridib_, jtinvit_) use static locals
+
+  struct taper_set_t {
+    Eigen::VectorXd lam;
+    Eigen::VectorXd tapsum;
+    Eigen::MatrixXd tapers;
+  };
+  
+  static std::map<std::pair<int,std::pair<int,double> >,taper_set_t> cache;
+  static std::mutex cache_mutex;
+
+  // bound the cache by size (each entry holds (seg_size+2) x nwin doubles),
+  // clearing whenever it would exceed this; as for the clocs/SL caches
+  static const size_t cache_max_bytes = 64 * 1024 * 1024;
+  static size_t cache_bytes = 0;
+
+  std::lock_guard<std::mutex> lock( cache_mutex );
+  
+  const std::pair<int,std::pair<int,double> > key( seg_size , std::make_pair( nwin , npi ) );
+
+  std::map<std::pair<int,std::pair<int,double> >,taper_set_t>::const_iterator ii = cache.find( key );
+  
+  if ( ii != cache.end() )
+    {
+      lam    = ii->second.lam;
+      tapsum = ii->second.tapsum;
+      tapers = ii->second.tapers;
+      return;
+    }
   
   // Vector of eigenvalues
   lam    = Eigen::VectorXd::Zero( nwin );
@@ -67,6 +104,22 @@ void mtm_t::store_tapers( const int seg_size )
   
   // calculate Slepian tapers                                                                                                                                                 
   generate_tapers( seg_size, nwin, npi );
+
+  const size_t bytes = ( (size_t)seg_size * nwin + 2 * nwin ) * sizeof(double);
+  if ( cache_bytes + bytes > cache_max_bytes )
+    {
+      cache.clear();
+      cache_bytes = 0;
+    }
+
+  if ( bytes <= cache_max_bytes )
+    {
+      taper_set_t & t = cache[ key ];
+      t.lam = lam;
+      t.tapsum = tapsum;
+      t.tapers = tapers;
+      cache_bytes += bytes;
+    }
   
 }
 
@@ -119,25 +172,11 @@ void mtm_t::apply( const std::vector<double> * d , const int fs ,
 	   << ( opt_remove_trend ? "detrend" : ( opt_remove_mean ? "constant" : "none" ) ) << "\n";
   
   //
-  // Generate and store tapers
-  //
-  
-  // Vector of eigenvalues
-  lam    = Eigen::VectorXd::Zero( nwin );
-  
-  // Sum of each taper (used in adaptive weighting)
-  tapsum = Eigen::VectorXd::Zero( nwin );
-
-  // samples x tapers
-  tapers = Eigen::MatrixXd::Zero( npoints , nwin );
-
-
-  //
-  // calculate (or attached pre-computed) Slepian tapers
+  // calculate/fetch cached (or attached pre-computed) Slepian tapers
   //
 
   if ( precomputed == NULL ) 
-    generate_tapers( npoints, nwin, npi );
+    store_tapers( npoints );
   else
     {
       lam = precomputed->lam;
@@ -146,99 +185,73 @@ void mtm_t::apply( const std::vector<double> * d , const int fs ,
     }
   
   //
-  // Spectrogram output
+  // Spectrogram output: preallocate segments x (positive) frequencies
   //
   
-  espec.resize( n_segs );
-  raw_espec.resize( n_segs );
+  espec.assign( n_segs , std::vector<double>( nfreqs , 0 ) );
+  raw_espec.assign( n_segs , std::vector<double>( nfreqs , 0 ) );
 
+  f.resize( nfreqs , 0 );
+  for (int i = 0; i < nfreqs; i++)
+    f[i] = df*i;
+  
   //
-  // Initiate FFT (no window, as tapers applied to data beforehand)
+  // Initiate FFTs (no window, as tapers applied to data beforehand);
+  // FFTW planning is not thread-safe, so make one plan per worker here
   //
 
+  const int nt = Helper::nthreads( n_segs );
+  
   // use next pow2 FFT by default:
-  real_FFT fftseg( seg_size , klen , fs , WINDOW_NONE );
-  //  real_FFT fftseg( seg_size , seg_size , fs , WINDOW_NONE );
+  std::vector<real_FFT*> fftsegs( nt );
+  for (int t=0; t<nt; t++)
+    fftsegs[t] = new real_FFT( seg_size , klen , fs , WINDOW_NONE );
   
   //
-  // Iterate over segments
+  // Iterate over segments: worker t takes segments t, t+nt, t+2nt, ...,
+  // with each segment's spectrum written straight to its own row
   //
-
-  int sn = 0; // count of segment 
-
-  for ( int p = 0; p < total_npoints ; p += seg_step )
-    {
-      // all done?
-      if ( p + seg_size > total_npoints ) break;
-            
+  
+  Helper::parallel_for( nt , [&]( int t ) {
+      
       // need to copy segment (i.e. if detrending)
       std::vector<double> segment( npoints );  // == seg_size
-      
-      int p2 = p;
-      for (int j=0; j<seg_size; j++)
-	segment[j] = (*d)[p2++];
-      
-      double * psegment = &(segment)[0];
-
-      //
-      // remove mean or detrend?
-      //
-      
-      if ( opt_remove_mean ) 
-	{
-	  double m = mtm_t::remove_mean( psegment, npoints );
-	}
-      else if ( opt_remove_trend )
-	{
-	  rm_lin_sig_trend( psegment , npoints , dt );
-	}
 
-      
-      // allocate storage for spectra
-      espec[sn].resize( klen ,  0 );  
-      
-      // track raw spectra too 
-      raw_espec[sn].resize( klen ,  0 );  
-
-      // do actual MTM analysis
-      do_mtap_spec( &fftseg,
-		    &(segment)[0],
-		    npoints ,
-		    kind, nwin, npi, inorm, dt,
-		    &(raw_espec)[sn][0],  klen );      
-      
-      //
-      // shrink to positive spectrum (already scled x2)?
-      // 
-      
-      raw_espec[sn].resize( nfreqs );
-      espec[sn].resize( nfreqs );
-      
-      if ( sn == 0 ) 
-	f.resize( nfreqs , 0 );
-      
-      for (int i = 0; i < nfreqs; i++)
+      for ( int sn = t ; sn < n_segs ; sn += nt )
 	{
-
-	  if ( sn == 0 ) 
-	    f[i] = df*i;
+	  
+	  const int p = sn * seg_step;
+	  
+	  for (int j=0; j<seg_size; j++)
+	    segment[j] = (*d)[p+j];
+	  
+	  double * psegment = &(segment)[0];
+	  
+	  //
+	  // remove mean or detrend?
+	  //
+	  
+	  if ( opt_remove_mean ) 
+	    mtm_t::remove_mean( psegment, npoints );
+	  else if ( opt_remove_trend )
+	    rm_lin_sig_trend( psegment , npoints , dt );
+	  
+	  // do actual MTM analysis (writes the first nfreqs values)
+	  do_mtap_spec( fftsegs[t],
+			psegment,
+			npoints ,
+			kind, nwin, npi, inorm, dt,
+			&(raw_espec)[sn][0],  klen );      
 	  
 	  // report dB?
-	  if ( dB )
-	    espec[sn][i] = 10 * log10( raw_espec[sn][i] );
-	  else
-	    espec[sn][i] = raw_espec[sn][i] ;	  
-	}  
-      
-
-      //
-      // Next segment
-      //
-
-      ++sn;
-
-    }
+	  for (int i = 0; i < nfreqs; i++)
+	    espec[sn][i] = dB ? 10 * log10( raw_espec[sn][i] ) : raw_espec[sn][i] ;
+	}
+    } , nt );
 
+  for (int t=0; t<nt; t++)
+    delete fftsegs[t];
+  
   //
   // Compute average spectrum
   //
@@ -521,8 +534,6 @@ void  mtm_t::do_mtap_spec( real_FFT * fftseg ,
       for (int j = 0; j < npoints; j++)
 	b[j] = data[j] * tapers( j , iwin );  /*  application of  iwin-th taper   */
   
-      std::vector<double> amp( klen , 0 );
-  
       //
       // do FFT
       //
@@ -26,6 +26,18 @@
 #include "clocs/clocs.h"
 #include "clocs/legendre_polynomial.h"
 
+// G, H and inverse-G are fully determined by the montage and the spline
+// parameters, so are cached (by clocs_t::spline_key()) across EDFs
+
+static std::map<std::string,sl_t> sl_cache;
+
+// as for the inverse-G cache in clocs, bound by size (each entry holds
+// three ns x ns matrices), clearing whenever it would exceed this
+
+static const size_t sl_cache_max_bytes = 64 * 1024 * 1024;
+
+static size_t sl_cache_bytes = 0;
+
 void dsptools::surface_laplacian_wrapper( edf_t & edf , param_t & param )
 {
 
@@ -160,6 +172,20 @@ sl_t::sl_t( const clocs_t & orig_clocs , const signal_list_t & signals , int m_
 //        ++cc;
 //      }
 
+  //
+  // already have these matrices?
+  //
+
+  const std::string key = clocs.spline_key( signals , m , order , lambda );
+
+  std::map<std::string,sl_t>::const_iterator kk = sl_cache.find( key );
+
+  if ( kk != sl_cache.end() )
+    {
+      *this = kk->second;
+      return;
+    }
+  
   //
   // inter-electrode cosdistance matrix
   //
@@ -253,6 +279,18 @@ sl_t::sl_t( const clocs_t & orig_clocs , const signal_list_t & signals , int m_
   //std::cout << "sumGsinvS = " << sumGsinvS << "\n";
  
   //  for (int i=0;i<ns;i++) std::cout << "GsinvS[j] " << GsinvS[i] << "\n";
+
+  const size_t bytes = 3 * (size_t)ns * ns * sizeof(double);
+  if ( sl_cache_bytes + bytes > sl_cache_max_bytes )
+    {
+      sl_cache.clear();
+      sl_cache_bytes = 0;
+    }
+  if ( bytes <= sl_cache_max_bytes )
+    {
+      sl_cache.insert( std::make_pair( key , *this ) );
+      sl_cache_bytes += bytes;
+    }
  
 }
   
@@ -139,8 +139,8 @@ void dsptools::tlock( edf_t & edf , param_t & param )
       // add output stratifiers based on this key
       //
 
-      std::map<std::string,std::string>::const_iterator ss = cc->stratum.begin();
-      while ( ss != cc->stratum.end() )
+      std::map<std::string,std::string>::const_iterator ss = cc->strata().begin();
+      while ( ss != cc->strata().end() )
 	{
 	  writer.level( ss->second , "s" + ss->first );
 	  ++ss;
@@ -289,8 +289,8 @@ void dsptools::tlock( edf_t & edf , param_t & param )
       //
       
 
-      ss = cc->stratum.begin();
-      while ( ss != cc->stratum.end() )
+      ss = cc->strata().begin();
+      while ( ss != cc->strata().end() )
 	{
 	  writer.unlevel( "s" + ss->first );
 	  ++ss;
@@ -190,6 +190,21 @@ bool edf_t::align( const std::vector<std::string> & annots )
 
       // process this signal
       int fs = header.n_samples[s];
+
+      // held as physical values (float-channels=T)? if so, carry those
+      // through rather than quantizing here; virtual channels are also
+      // evaluated as physical values under float-channels=T
+      bool physical = globals::float_channels && is_virtual( s );
+      if ( globals::float_channels && ! physical )
+	{
+	  std::map<int,edf_record_t>::const_iterator qq = records.begin();
+	  while ( qq != records.end() )
+	    {
+	      if ( qq->second.pdata[ s ].size() != 0 ) { physical = true; break; }
+	      ++qq;
+	    }
+	}
+
       int curr_rec = 0; // this should count 0 .. (new_nr-1)
       int curr_smp = 0; // this should count 0 .. (fs-1) 
       
@@ -209,7 +224,7 @@ bool edf_t::align( const std::vector<std::string> & annots )
 			  " potential floating-point inconistencies in interval specifications?\n" );
 	  
 	  const int downsample = 1; // i.e. no downsampling
-	  const bool return_ddata = true ;
+	  const bool return_ddata = ! physical ;
 
 	  slice_t slice( *this , s , *aa , downsample , return_ddata );
 	  
@@ -218,8 +233,10 @@ bool edf_t::align( const std::vector<std::string> & annots )
 	  // so no need to do digital->physical->digital conversion
 	  
 	  std::vector<int16_t> * d = slice.nonconst_ddata();
+
+	  const std::vector<double> * pd = slice.pdata();
 	  
-	  const int n = d->size();
+	  const int n = physical ? pd->size() : d->size();
 
 	  // add to records
 	  
@@ -232,7 +249,18 @@ bool edf_t::align( const std::vector<std::string> & annots )
 	    {
 
 	      // add data point
-	      rr->second.data[ s ][ curr_smp ] = (*d)[i]; 
+	      if ( physical )
+		{
+		  std::vector<double> & pdata = rr->second.pdata[ s ];
+		  if ( pdata.size() == 0 )
+		    {
+		      pdata.resize( fs );
+		      std::vector<int16_t>().swap( rr->second.data[ s ] );
+		    }
+		  pdata[ curr_smp ] = (*pd)[i];
+		}
+	      else
+		rr->second.data[ s ][ curr_smp ] = (*d)[i]; 
 	      
 	      // add time-point for EDF record?
 	      if ( curr_smp == 0 && ! got_tps ) 
@@ -296,6 +324,9 @@ bool edf_t::align( const std::vector<std::string> & annots )
 
   records = new_records;
   new_records.clear();
+
+  // any virtual channels have now been evaluated into the new records
+  vchannels.clear();
   
   
   //
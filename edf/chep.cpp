@@ -103,26 +103,19 @@ void timeline_t::proc_chep( edf_t & edf , param_t & param )
     }
 
   // copy/clear/reset chep mask
-  std::map<int,std::set<std::string> > copy = edf.timeline.chep;
+  chep_mask_t copy = edf.timeline.chep;
   edf.timeline.clear_chep_mask();
 
-  std::map<int,std::set<std::string> >::const_iterator ii = copy.begin();
-  while ( ii != copy.end() )
+  for (int c=0; c<copy.rows.size(); c++)
     {
-
-      // got this epoch?
-    if ( epochs.find( ii->first ) != epochs.end() )
-      {
-	std::set<std::string>::const_iterator jj = ii->second.begin();
-	while ( jj != ii->second.end() )
-	  {
-	    if ( channels.find( *jj ) != channels.end() )
-	      edf.timeline.chep[ ii->first ].insert( *jj );
-	    ++jj;
-	  }
-      }
-    ++ii;
-  }
+      // got this channel?
+      if ( channels.find( copy.labels[c] ) == channels.end() ) continue;
+      
+      const std::vector<int> eps = copy.rows[c].members();
+      for (int i=0; i<eps.size(); i++)
+	if ( epochs.find( eps[i] ) != epochs.end() )
+	  edf.timeline.chep.set( eps[i] , copy.labels[c] );
+    }
 
   //
   // manually specify good/bad channels/epochs
@@ -31,6 +31,9 @@
 #include "eval.h"
 #include "defs/defs.h"
 #include "db/db.h"
+#include "helper/json.h"
+
+#include <cstdio>
 
 extern writer_t writer;
 
@@ -39,6 +42,66 @@ extern logger_t logger;
 extern annotation_set_t annotations;
 
 
+//
+// Binary (NumPy .npy or raw float32) output for DUMP and MATRIX: 
+// samples are written as blocks of float32 values, with a JSON header
+// (channels, sample rate, epochs/time-points) written to {file}.json
+//
+
+// fixed-size .npy preamble (so that shape can be re-written once known)
+static const int npy_header_size = 128;
+
+static void npy_header( FILE * F , const uint64_t nr , const int nc )
+{
+  const uint16_t one = 1;
+  const bool little_endian = *(const char*)&one == 1;
+  
+  std::stringstream ss;
+  ss << "{'descr': '" << ( little_endian ? '<' : '>' ) << "f4', 'fortran_order': False, 'shape': (" << nr ;
+  if ( nc ) ss << ", " << nc << "), }";
+  else ss << ",), }";
+
+  // magic (6) + version (2) + header length (2) + header, padded to
+  // end in a newline
+  
+  const int hlen = npy_header_size - 10;
+  std::string h = ss.str();
+  if ( h.size() + 1 > hlen ) Helper::halt( "internal error in npy_header()" );
+  h.resize( hlen - 1 , ' ' );
+  h += '\n';
+  
+  const unsigned char pre[10] = { 0x93 , 'N' , 'U' , 'M' , 'P' , 'Y' , 1 , 0 , 
+				  (unsigned char)( hlen & 0xff ) , (unsigned char)( hlen >> 8 ) };
+  fwrite( pre , 1 , 10 , F );
+  fwrite( h.data() , 1 , h.size() , F );
+}
+
+static FILE * bin_open( const std::string & filename , const bool npy )
+{
+  FILE * F = fopen( filename.c_str() , "wb" );
+  if ( F == NULL ) Helper::halt( "could not open " + filename );
+  if ( npy ) npy_header( F , 0 , 0 ); // placeholder
+  return F;
+}
+
+static void bin_close( FILE * F , const bool npy , const uint64_t nr , const int nc ,
+		       const std::string & filename , const nlohmann::json & hdr )
+{
+  if ( npy )
+    {
+      fseek( F , 0 , SEEK_SET );
+      npy_header( F , nr , nc );
+    }
+  fclose( F );
+
+  const std::string hfile = filename + ".json";
+  std::ofstream J( hfile.c_str() , std::ios::out );
+  if ( ! J.good() ) Helper::halt( "could not open " + hfile );
+  J << hdr.dump( 1 ) << "\n";
+  J.close();
+}
+
+
 void edf_t::record_table( param_t & param )
 {
   
@@ -280,6 +343,74 @@ void edf_t::data_dumper( const std::string & signal_labels , const param_t & par
 
   bool only_signal = param.has("minimal");
 
+  //
+  // Binary output (to file) 
+  //
+
+  const bool npy = param.has( "npy" );
+  
+  if ( npy || param.has( "raw" ) )
+    {
+      
+      const std::string filename = Helper::expand( param.requires( "file" ) );
+
+      const double fs = header.sampling_freq( signals(0) );
+      
+      logger << "  writing " << ( npy ? ".npy" : "raw float32" ) << " samples to " << filename 
+	     << " (header to " << filename << ".json)\n";
+      
+      FILE * F = bin_open( filename , npy );
+
+      nlohmann::json epochs = nlohmann::json::array();
+      
+      uint64_t nr = 0;
+      
+      std::vector<float> buf;
+      
+      timeline.first_epoch();
+      
+      while ( 1 ) 
+	{
+	  int epoch = timeline.next_epoch();      
+	  if ( epoch == -1 ) break;
+	  
+	  interval_t interval = timeline.epoch( epoch );
+	  
+	  slice_t data( *this , signals(0) , interval );
+	  const std::vector<double> * d = data.pdata();
+	  const std::vector<uint64_t> * tp = data.ptimepoints();
+	  const int n = d->size();
+	  if ( n == 0 ) continue;
+	  
+	  buf.resize( n );
+	  for (int i=0;i<n;i++) buf[i] = (*d)[i];
+	  fwrite( buf.data() , sizeof(float) , n , F );
+
+	  nlohmann::json e;
+	  e[ "E" ] = timeline.display_epoch( epoch );
+	  e[ "OFFSET" ] = nr;
+	  e[ "N" ] = n;
+	  e[ "START" ] = (*tp)[0] * globals::tp_duration;
+	  e[ "STOP" ] = (*tp)[n-1] * globals::tp_duration;
+	  epochs.push_back( e );
+
+	  nr += n;
+	}
+
+      nlohmann::json hdr;
+      hdr[ "ID" ] = id;
+      hdr[ "FORMAT" ] = npy ? "npy" : "raw";
+      hdr[ "DTYPE" ] = "float32";
+      hdr[ "SHAPE" ] = nlohmann::json::array( { nr } );
+      hdr[ "CH" ] = nlohmann::json::array( { header.label[ signals(0) ] } );
+      hdr[ "SR" ] = fs;
+      hdr[ "EPOCHS" ] = epochs;
+
+      bin_close( F , npy , nr , 0 , filename , hdr );
+      return;
+    }
+  
+  
   //
   // What annotations are present? (i.e. already loaded)
   //
@@ -708,10 +839,20 @@ void edf_t::epoch_matrix_dumper( param_t & param )
   //
   
   std::string filename = param.requires( "file" );
+
+  // binary output? 
   
-  std::ofstream OUT( filename.c_str() , std::ios::out );
+  const bool npy = param.has( "npy" );
+
+  const bool binary = npy || param.has( "raw" );
   
-  OUT.precision(12);
+  std::ofstream OUT;
+
+  if ( ! binary ) 
+    {
+      OUT.open( filename.c_str() , std::ios::out );  
+      OUT.precision(12);
+    }
 
   //
   // Minimal output?
@@ -854,13 +995,129 @@ void edf_t::epoch_matrix_dumper( param_t & param )
   
   logger << "  dumping " << ne << " unmasked epochs in " ;
   
-  if ( minimal ) logger << "minimal";
+  if ( binary ) logger << ( npy ? ".npy" : "raw float32" );
+  else if ( minimal ) logger << "minimal";
   else
     logger << ( alternative_format ? "alternative" : "standard" ) ;
   
   logger << " matrix-format to " << filename << "\n";  
 
 
+  //
+  // Binary format: samples x signals (row-major) float32 matrix, 
+  // written an epoch at a time; epochs, time-points, labels (and any
+  // epoch-level annotations) in the JSON header
+  //
+
+  if ( binary )
+    {
+      
+      if ( ns_data == 0 ) Helper::halt( "no data signals specified for MATRIX" );
+      
+      filename = Helper::expand( filename );
+      
+      FILE * F = bin_open( filename , npy );
+      
+      nlohmann::json epochs = nlohmann::json::array();
+
+      std::map<std::string,std::vector<int> > aflags;
+      
+      uint64_t nr = 0;
+
+      std::vector<float> buf;
+
+      std::vector<const std::vector<double>*> sigdat( ns_data );
+      
+      timeline.first_epoch();       
+      while ( 1 ) 
+	{
+	  
+	  int epoch = timeline.next_epoch();	   
+	  if ( epoch == -1 ) break;      
+	  
+	  interval_t interval = timeline.epoch( epoch );
+	  
+	  // pull all signals for this epoch
+
+	  std::vector<slice_t*> slices;
+	  for (int s = 0 ; s < ns ; s++ )
+	    if ( header.is_data_channel( signals(s) ) )
+	      {
+		slices.push_back( new slice_t( *this , signals(s) , interval ) );
+		sigdat[ slices.size() - 1 ] = slices.back()->pdata();
+	      }
+	  
+	  const std::vector<uint64_t> * tp = slices[0]->ptimepoints();
+	  
+	  const int np = sigdat[0]->size();
+	  
+	  for (int s=1;s<ns_data;s++)
+	    if ( sigdat[s]->size() != np ) 
+	      Helper::halt( "MATRIX requires uniform sampling rate across signals" ); 
+	  
+	  if ( np ) 
+	    {
+	      buf.resize( (size_t)np * ns_data );
+	      float * b = buf.data();
+	      for (int t=0;t<np;t++)
+		for (int s=0;s<ns_data;s++)
+		  *b++ = (*sigdat[s])[t];
+	      
+	      fwrite( buf.data() , sizeof(float) , buf.size() , F );
+	      
+	      nlohmann::json e;
+	      e[ "E" ] = timeline.display_epoch( epoch );
+	      e[ "OFFSET" ] = nr;
+	      e[ "N" ] = np;
+	      e[ "START" ] = (*tp)[0] * globals::tp_duration;
+	      e[ "STOP" ] = (*tp)[np-1] * globals::tp_duration;
+	      epochs.push_back( e );
+	      
+	      nr += np;
+
+	      // epoch-level annotations
+	      
+	      std::map<std::string,int>::const_iterator aa = atype.begin();
+	      while ( aa != atype.end() )
+		{
+		  bool has_annot = false;
+		  if ( aa->second == 1 ) 
+		    has_annot = timeline.annotations( aa->first )->extract( interval ).size();
+		  else if ( aa->second == 2 ) 
+		    has_annot = timeline.epoch_annotation( aa->first , epoch );
+		  aflags[ aa->first ].push_back( has_annot );
+		  ++aa;
+		}
+	    }
+	  
+	  for (int s=0;s<slices.size();s++) delete slices[s];
+	}
+      
+      nlohmann::json hdr;
+      hdr[ "ID" ] = id;
+      hdr[ "FORMAT" ] = npy ? "npy" : "raw";
+      hdr[ "DTYPE" ] = "float32";
+      hdr[ "SHAPE" ] = nlohmann::json::array( { nr , (uint64_t)ns_data } );
+      hdr[ "SR" ] = fs;
+      hdr[ "EPOCH_LENGTH" ] = timeline.epoch_length();
+
+      nlohmann::json chs = nlohmann::json::array();
+      for (int s = 0 ; s < ns ; s++ )
+	if ( header.is_data_channel( signals(s) ) )
+	  chs.push_back( header.label[ signals(s) ] );
+      hdr[ "CH" ] = chs;
+      
+      hdr[ "EPOCHS" ] = epochs;
+
+      if ( show_annots ) 
+	hdr[ "ANNOTS" ] = aflags;
+      
+      bin_close( F , npy , nr , ns_data , filename , hdr );
+      
+      return;
+    }
+
+
   
 
   if ( alternative_format )
@@ -25,6 +25,8 @@
 #include "defs/defs.h"
 #include "helper/helper.h"
 #include "helper/logger.h"
+#include "helper/profile.h"
+#include "helper/threads.h"
 #include "miscmath/miscmath.h"
 #include "db/db.h"
 #include "edfz/edfz.h"
@@ -835,33 +837,10 @@ bool edf_record_t::read( int r )
   // skip if already loaded?
   if ( edf->loaded( r ) ) return false;
   
-  // allocate space in the buffer for a single record, and read from file
-  
-  byte_t * p = new byte_t[ edf->record_size ];
-  
-  byte_t * p0 = p;
+  ++profiler_t::records_read;
 
-  // EDF?
-  if ( edf->file ) 
-    {
-      
-      // determine offset into EDF
-      uint64_t offset = edf->header_size + (uint64_t)(edf->record_size) * r;
-      
-      // find the appropriate record
-      fseek( edf->file , offset , SEEK_SET );
+  rec = r;
   
-      // and read it
-      size_t rdsz = fread( p , 1, edf->record_size , edf->file );
-    }
-  else // EDFZ
-    {
-      
-      if ( ! edf->edfz->read_record( r , p , edf->record_size ) ) 
-	Helper::halt( "corrupt .edfz or .idx" );      
-
-    }
-
   // which signals/channels do we actually want to read?
   // header : 0..(ns-1)
   // from record data : 0..(ns_all-1), from which we pick the 'ns' entries is 'channels'
@@ -869,6 +848,38 @@ bool edf_record_t::read( int r )
   
   // for convenience, use name 'channels' below
   std::set<int> & channels = edf->inp_signals_n;
+
+  //
+  // Standard EDF: channels are only decoded when first accessed
+  // (see decode()), i.e. so that work and memory scale with the
+  // channels actually used
+  //
+  
+  if ( edf->file ) 
+    {
+      int s = 0;
+      std::set<int>::const_iterator cc = channels.begin();
+      while ( cc != channels.end() )
+	{
+	  std::vector<int16_t>().swap( data[s] );
+	  pending[s++] = *cc;
+	  ++cc;
+	}
+      return true;
+    }
+  
+  //
+  // EDFZ: read and decode the whole record
+  //
+  
+  // allocate space in the buffer for a single record, and read from file
+  
+  byte_t * p = new byte_t[ edf->record_size ];
+  
+  byte_t * p0 = p;
+
+  if ( ! edf->edfz->read_record( r , p , edf->record_size ) ) 
+    Helper::halt( "corrupt .edfz or .idx" );      
     
   int s = 0;
 
@@ -887,84 +898,16 @@ bool edf_record_t::read( int r )
 	  p += 2 * nsamples;
 	  continue;
 	}
-      
-
-      //
-      // Data or annotation channel? (note: lookup is based on 's' not
-      // 's0', i.w. loaded channels, not all EDF channels
-      //
-      
-      bool annotation = edf->header.is_annotation_channel( s );
 
       //
       // s0 : actual signal in EDF
       // s  : where this signal will land in edf_t
       //
-      
-      if ( ! annotation ) 
-	{
-	  
-	  for (int j=0; j < nsamples ; j++)
-	    {
 
-	      //int d = tc2dec( **p ,  *((*p)+1)  ); 
-	      int16_t d = tc2dec( *p ,  *(p+1)  ); 
-	      
-	      // advance pointer
-	      p += 2;
-
-	      // store digital data-point
-	      data[s][j] = d;
-	      
-	      // physically-scaled data-point	  
-	      if ( false )
-		if ( d < edf->header.orig_digital_min[s] || d > edf->header.orig_digital_max[s] ) 
-		  {	
-		    
-		  std::cout << "OUT-OF-BOUNDS" << "\t"
-			    << edf->id << "\t"
-			    << "[" << globals::current_tag << "]\t"
-			    << edf->header.label[s] << "\t"
-			    << "digt: " << d << "\t"
-			    << edf->header.orig_digital_min[s] << " .. " 
-			    << edf->header.orig_digital_max[s] << "\t"
-			    << "phys: " << edf->header.bitvalue[s] * ( edf->header.offset[s] + d ) << "\t"
-			    << edf->header.orig_physical_min[s] << " .. " 
-			    << edf->header.orig_physical_max[s] << "\n"; 
-
-		  if (  d < edf->header.orig_digital_min[s] ) 
-		    d = edf->header.orig_digital_min[s];
-		  else 
-		    d = edf->header.orig_digital_max[s];
-		  
-		  }
-	      
-	      // concert to physical scale
-	      //pdata[s][j] = edf->header.bitvalue[s] * ( edf->header.offset[s] + d );
-	      //pdata[s][j] = dig2phys( d , s ) ;
-	      
-	    }
-	}
-      else // read as a ANNOTATION
-	{
-	  
-	  // Note, because for a normal signal, each sample takes 2 bytes,
-	  // here we read twice the number of datapoints
-	  
-	  for (int j=0; j < 2 * nsamples; j++)
-	    {
-	      
-	      // store digital data-point
-	      data[s][j] = *p;
-	      
-	      // advance pointer
-	      p++;
-	      
-	    }	  
-	  
-	}
+      unpack( s , p , nsamples );
+      
+      p += 2 * nsamples;
       
-
       // next signal
 
       ++s;
@@ -983,6 +926,70 @@ bool edf_record_t::read( int r )
 }
 
 
+void edf_record_t::unpack( const int s , const byte_t * p , const int nsamples ) const
+{
+
+  //
+  // Data or annotation channel? (note: lookup is based on 's' not
+  // 's0', i.w. loaded channels, not all EDF channels
+  //
+  
+  if ( ! edf->header.is_annotation_channel( s ) ) 
+    {
+      data[s].resize( nsamples );
+      
+      for (int j=0; j < nsamples ; j++)
+	{
+	  // store digital data-point
+	  data[s][j] = tc2dec( *p ,  *(p+1)  ); 
+	  
+	  // advance pointer
+	  p += 2;
+	}
+    }
+  else // read as a ANNOTATION
+    {
+      
+      // Note, because for a normal signal, each sample takes 2 bytes,
+      // here we read twice the number of datapoints
+
+      data[s].resize( 2 * nsamples );
+      
+      for (int j=0; j < 2 * nsamples; j++)
+	data[s][j] = *p++;
+    }
+  
+}
+
+
+void edf_record_t::decode( const int s ) const
+{
+  
+  // channel not yet read from the EDF (see read()): pending[s] is
+  // the channel in the original EDF, from which we get its offset
+  // into the record
+  
+  const int s0 = pending[s];
+  pending[s] = -1;
+
+  uint64_t offset = edf->header_size + (uint64_t)(edf->record_size) * rec;
+  for (int i=0; i<s0; i++)
+    offset += 2 * edf->header.n_samples_all[i];
+  
+  const int nsamples = edf->header.n_samples_all[s0];
+  
+  std::vector<byte_t> p( 2 * nsamples , 0 );
+  
+  fseek( edf->file , offset , SEEK_SET );
+
+  // as for the whole-record read, a short read (i.e. truncated EDF) is
+  // not an error here: any missing bytes are left as zero
+  size_t rdsz = fread( p.data() , 1 , 2 * nsamples , edf->file );
+  
+  unpack( s , p.data() , nsamples );
+  
+}
+
 
 bool edf_t::read_records( int r1 , int r2 )
 {
@@ -1649,6 +1656,11 @@ std::vector<double> edf_t::fixedrate_signal( uint64_t start ,
   double bitvalue = header.bitvalue[ signal ];
   double offset   = header.offset[ signal ];
 
+  // virtual channels are evaluated a record at a time
+  std::map<int,vchannel_t>::const_iterator vv = vchannels.find( signal );
+  std::vector<int16_t> vdata;
+  std::vector<double> vpdata;
+  
   int r = start_record;
 
   while ( r <= stop_record )
@@ -1660,6 +1672,24 @@ std::vector<double> edf_t::fixedrate_signal( uint64_t start ,
 
       const edf_record_t * record = &(records.find( r )->second);
 
+      // physical values held directly (float-channels=T)?
+      const std::vector<double> * fdata = NULL;
+      
+      if ( vv != vchannels.end() )
+	{
+	  if ( globals::float_channels )
+	    {
+	      vchannel_physical( vv->second , *record , &vpdata );
+	      fdata = &vpdata;
+	    }
+	  else
+	    vchannel_digital( vv->second , *record , &vdata );
+	}
+      else if ( record->pdata[ signal ].size() != 0 )
+	fdata = &record->pdata[ signal ];
+      
+      const std::vector<int16_t> & rdata = vv != vchannels.end() ? vdata : record->digital( signal );
+
       //std::cerr << " test for NULL " << ( record == NULL ? "NULL" : "OK" ) << "\n";
       
       const int start = r == start_record ? start_sample : 0 ;
@@ -1681,10 +1711,17 @@ std::vector<double> edf_t::fixedrate_signal( uint64_t start ,
 	    rec->push_back( r );
 
 	  // just return digital values...
-	  if ( ddata != NULL )
-	    ddata->push_back( record->data[ signal ][ s ] );
+	  if ( fdata != NULL )
+	    {
+	      if ( ddata != NULL )
+		ddata->push_back( edf_record_t::phys2dig( (*fdata)[ s ] , bitvalue , offset ) );
+	      else
+		ret.push_back( (*fdata)[ s ] );
+	    }
+	  else if ( ddata != NULL )
+	    ddata->push_back( rdata[ s ] );
 	  else // ... or convert from digital to physical on-the-fly? (the default)
-	    ret.push_back( edf_record_t::dig2phys( record->data[ signal ][ s ] , bitvalue , offset ) );
+	    ret.push_back( edf_record_t::dig2phys( rdata[ s ] , bitvalue , offset ) );
 
 	}
       
@@ -1821,6 +1858,17 @@ bool edf_header_t::write( edfz_t * edfz )
 bool edf_record_t::write( FILE * file )
 {
 
+  // assemble the whole record, then a single fwrite()
+
+  int nbytes = 0;
+  for (int s=0;s<edf->header.ns;s++)
+    nbytes += 2 * edf->header.n_samples[s];
+  
+  if ( nbytes == 0 ) return true;
+  
+  std::vector<char> d( nbytes );
+
+  char * p = &(d)[0];
   
   for (int s=0;s<edf->header.ns;s++)
     {
@@ -1833,12 +1881,25 @@ bool edf_record_t::write( FILE * file )
 
       if ( edf->header.is_data_channel(s) )
 	{      
-	  for (int j=0;j<nsamples;j++)
-	    {	  
-	      char a , b;
-	      dec2tc( data[s][j] , &a, &b );	  
-	      fputc( a , file );
-	      fputc( b , file );
+	  // physical values (float-channels=T) are only quantized here
+	  if ( pdata[s].size() != 0 )
+	    {
+	      const double bv = edf->header.bitvalue[s];
+	      const double os = edf->header.offset[s];
+	      for (int j=0;j<nsamples;j++)
+		{
+		  dec2tc( phys2dig( pdata[s][j] , bv , os ) , p , p+1 );
+		  p += 2;
+		}
+	    }
+	  else
+	    {
+	      const std::vector<int16_t> & d = digital(s);
+	      for (int j=0;j<nsamples;j++)
+		{	  
+		  dec2tc( d[j] , p , p+1 );
+		  p += 2;
+		}
 	    }
 	}
       
@@ -1848,16 +1909,14 @@ bool edf_record_t::write( FILE * file )
       
       if ( edf->header.is_annotation_channel(s) )
 	{      	  	  
+	  const std::vector<int16_t> & d = digital(s);
 	  for (int j=0;j< 2*nsamples;j++)
-	    {	  	      
-	      char a = j >= data[s].size() ? '\x00' : data[s][j];	      
-	      fputc( a , file );	      
-	    }
+	    *p++ = j >= d.size() ? '\x00' : d[j];
 	}
     
     }
 
-  return true;
+  return fwrite( &(d)[0] , 1 , nbytes , file ) == nbytes;
 }
 
 
@@ -1879,8 +1938,19 @@ bool edf_record_t::write( edfz_t * edfz )
 	{  
 	  std::vector<char> d( 2 * nsamples );
 	  
-	  for (int j=0;j<nsamples;j++)
-	    dec2tc( data[s][j] , &(d)[2*j], &(d)[2*j+1] );	  
+	  if ( pdata[s].size() != 0 )
+	    {
+	      const double bv = edf->header.bitvalue[s];
+	      const double os = edf->header.offset[s];
+	      for (int j=0;j<nsamples;j++)
+		dec2tc( phys2dig( pdata[s][j] , bv , os ) , &(d)[2*j], &(d)[2*j+1] );
+	    }
+	  else
+	    {
+	      const std::vector<int16_t> & x = digital(s);
+	      for (int j=0;j<nsamples;j++)
+		dec2tc( x[j] , &(d)[2*j], &(d)[2*j+1] );	  
+	    }
 
 	  edfz->write( (byte_t*)&(d)[0] , 2 * nsamples );
 	  
@@ -1895,9 +1965,11 @@ bool edf_record_t::write( edfz_t * edfz )
 
 	  std::vector<char> d( 2 * nsamples );
 
+	  const std::vector<int16_t> & x = digital(s);
+
 	  for (int j=0;j< 2*nsamples;j++)
 	    {	  	      
-	      char a = j >= data[s].size() ? '\x00' : data[s][j];	      
+	      char a = j >= x.size() ? '\x00' : x[j];	      
 	      d[j] = a;
 	    }
 	  
@@ -1992,6 +2064,12 @@ bool edf_t::is_actually_discontinuous()
 
 bool edf_t::write( const std::string & f , bool as_edfz , bool write_as_edf , bool always_edfd )
 {
+
+  //
+  // Any virtual channels need to be computed now
+  //
+
+  materialize();
   
   //
   // Is this EDF+ truly discontinuous?  i.e. a discontinuous flag is set after any RESTRUCTURE
@@ -2072,15 +2150,17 @@ bool edf_t::write( const std::string & f , bool as_edfz , bool write_as_edf , bo
       while ( r != -1 ) 
 	{
 	  
-	  // we may need to load this record, before we can write it
-	  if ( ! loaded( r ) )
+	  // records not yet loaded are streamed: read, written
+	  // and discarded, i.e. not retained in records
+	  if ( loaded( r ) )
+	    records.find(r)->second.write( outfile );
+	  else
 	    {
 	      edf_record_t record( this ); 
 	      record.read( r );
-	      records.insert( std::map<int,edf_record_t>::value_type( r , record ) );	      
+	      record.write( outfile );
 	    }
 	  
-	  records.find(r)->second.write( outfile );
 	  r = timeline.next_record(r);
 	}
       
@@ -2096,7 +2176,8 @@ bool edf_t::write( const std::string & f , bool as_edfz , bool write_as_edf , bo
 
       edfz_t edfz;
 
-      if ( ! edfz.open_for_writing( filename ) )
+      // BGZF blocks deflated in parallel, given nthreads
+      if ( ! edfz.open_for_writing( filename , Helper::nthreads( header.nr ) ) )
 	{
 	  logger << " ** could not open " << filename << " for writing **\n";
 	  return false;
@@ -2113,21 +2194,19 @@ bool edf_t::write( const std::string & f , bool as_edfz , bool write_as_edf , bo
       while ( r != -1 ) 
 	{
 	  
-	  // we may need to load this record, before we can write it
-	  if ( ! loaded( r ) )
-	    {
-	      edf_record_t record( this ); 
-	      record.read( r );
-	      records.insert( std::map<int,edf_record_t>::value_type( r , record ) );	      
-	    }
-	  
-	
 	  // set index	  
 	  int64_t offset = edfz.tell();	  
 	  edfz.add_index( r , offset );
 	  
-	  // now write to the .edfz
-	  records.find(r)->second.write( &edfz );
+	  // now write to the .edfz (streaming records not yet loaded, as above)
+	  if ( loaded( r ) )
+	    records.find(r)->second.write( &edfz );
+	  else
+	    {
+	      edf_record_t record( this ); 
+	      record.read( r );
+	      record.write( &edfz );
+	    }
 	  
 	  // next record
 	  r = timeline.next_record(r);
@@ -2166,6 +2245,28 @@ void edf_t::drop_signal( const int s )
 {
 
   if ( s < 0 || s >= header.ns ) return;  
+
+  // virtual channels: evaluate any that still need this slot's data,
+  // and renumber the rest
+  
+  if ( vchannel_reads( s , s ) ) materialize();
+  
+  if ( vchannels.size() != 0 )
+    {
+      std::map<int,vchannel_t> shifted;
+      std::map<int,vchannel_t>::iterator vv = vchannels.begin();
+      while ( vv != vchannels.end() )
+	{
+	  if ( vv->first != s )
+	    {
+	      vv->second.shift( s );
+	      shifted[ vv->first > s ? vv->first - 1 : vv->first ] = vv->second;
+	    }
+	  ++vv;
+	}
+      vchannels = shifted;
+    }
+  
   --header.ns;
 
   // need to track whether this signal was in the list of signals to be read from the original file
@@ -2231,8 +2332,9 @@ void edf_record_t::drop( const int s )
 {
   data[ s ].clear();
   data.erase( data.begin() + s );
-//   pdata[ s ].clear();
-//   pdata.erase( pdata.begin() + s );
+  pdata[ s ].clear();
+  pdata.erase( pdata.begin() + s );
+  pending.erase( pending.begin() + s );
 }
 
 void edf_t::add_signal( const std::string & label ,
@@ -2317,18 +2419,47 @@ void edf_t::add_signal( const std::string & label ,
     {
       
       ensure_loaded( r );
-      
-      std::vector<int16_t> t(n_samples);
-      
-      for (int i=0;i<n_samples;i++) 
-	t[i] = edf_record_t::phys2dig( data[c++] , bv , os );
 
-      records.find(r)->second.add_data(t);
+      edf_record_t & record = records.find(r)->second;
+      
+      // float-channels=T: keep the physical values (within the header range)
+      if ( globals::float_channels )
+	{
+	  std::vector<double> p( n_samples );
+	  for (int i=0;i<n_samples;i++)
+	    {
+	      const double x = data[c++];
+	      p[i] = x < pmin ? pmin : ( x > pmax ? pmax : x );
+	    }
+	  record.add_data( std::vector<int16_t>() );
+	  record.pdata.back().swap( p );
+	}
+      else
+	{
+	  std::vector<int16_t> t(n_samples);
+	  
+	  for (int i=0;i<n_samples;i++) 
+	    t[i] = edf_record_t::phys2dig( data[c++] , bv , os );
+	  
+	  record.add_data(t);
+	}
 
       r = timeline.next_record(r);
 
     }
 
+  add_signal_header( label , n_samples , pmin , pmax , dmin , dmax );
+
+}
+
+
+void edf_t::add_signal_header( const std::string & label , const int n_samples ,
+			       double pmin , double pmax , int16_t dmin , int16_t dmax )
+{
+  
+  double bv = ( pmax - pmin ) / (double)( dmax - dmin );
+  double os = ( pmax / bv ) - dmax;
+
   // add to header
   ++header.ns;
     
@@ -2364,13 +2495,31 @@ void edf_t::add_signal( const std::string & label ,
 }
 
 
-std::vector<double> edf_record_t::get_pdata( const int s )
+std::vector<double> edf_record_t::get_pdata( const int s ) const
 {
   const double & bv     = edf->header.bitvalue[s];
   const double & offset = edf->header.offset[s];
-  const int n = data[s].size();
+
+  std::vector<int16_t> vdata;
+  std::map<int,vchannel_t>::const_iterator vv = edf->vchannels.find( s );
+  if ( vv != edf->vchannels.end() )
+    {
+      if ( globals::float_channels )
+	{
+	  std::vector<double> r;
+	  edf->vchannel_physical( vv->second , *this , &r );
+	  return r;
+	}
+      edf->vchannel_digital( vv->second , *this , &vdata );
+    }
+  else if ( pdata[s].size() != 0 )
+    return pdata[s];
+  
+  const std::vector<int16_t> & d = vv != edf->vchannels.end() ? vdata : digital(s);
+  
+  const int n = d.size();
   std::vector<double> r( n );
-  for ( int i = 0 ; i < n ; i++ ) r[i] = dig2phys( data[s][i] , bv , offset );
+  for ( int i = 0 ; i < n ; i++ ) r[i] = dig2phys( d[i] , bv , offset );
   return r;
 }
 
@@ -2378,13 +2527,16 @@ void edf_record_t::add_data( const std::vector<int16_t> & d )
 {
   // store
   data.push_back( d );
+  pdata.resize( data.size() );
+  pending.resize( data.size() , -1 );
 }
 
 void edf_record_t::add_annot( const std::string & str )
 {
   // create a new data slot
   std::vector<int16_t> dummy; data.push_back(dummy);
-  //std::vector<double> pdummy;   pdata.push_back(pdummy);
+  pdata.resize( data.size() );
+  pending.resize( data.size() , -1 );
   // add this to the end
   add_annot( str , data.size()-1 );
 }
@@ -2429,6 +2581,8 @@ void edf_t::reset_record_size( const double new_record_duration )
   // this changes the in-memory representation;
   // naturally, new data cannot easily be loaded from disk, so 
   // this command should always write a new EDF and then quit
+
+  materialize();
   
   // original record size (seconds) , and derived value in tp
   // double record_duration;
@@ -2503,6 +2657,16 @@ void edf_t::reset_record_size( const double new_record_duration )
 
 	  const int n = header.n_samples[s];
 
+	  // physical values (float-channels=T) are quantized here
+	  if ( record.pdata[s].size() != 0 )
+	    {
+	      record.data[s].resize( n );
+	      for (int i = 0 ; i < n ; i++ )
+		record.data[s][i] = edf_record_t::phys2dig( record.pdata[s][i] , header.bitvalue[s] , header.offset[s] );
+	    }
+
+	  const std::vector<int16_t> & d = record.digital( s );
+	  
 	  for (int i = 0 ; i < n ; i++ )
 	    {
 	      
@@ -2520,7 +2684,7 @@ void edf_t::reset_record_size( const double new_record_duration )
 
 //  		  std::cout << "setting " << new_rec_cnt[s] << "\t" << new_smp_cnt[s] << " = " << r << " " << i << "\n";
 //  		  std::cout << " sz = " << new_record.data[ s ].size() << " " << record.data[ s ].size() << "\n";
-		  new_record.data[ s ][ new_smp_cnt[ s ] ] = record.data[ s ][ i ];
+		  new_record.data[ s ][ new_smp_cnt[ s ] ] = d[ i ];
 		  
 		  ++new_smp_cnt[ s ];
 		}
@@ -2741,6 +2905,91 @@ void edf_t::reference( const signal_list_t & signals0 ,
     }
 
 
+  //
+  // Unless resampling, define as virtual channels: i.e. the data are
+  // only evaluated when needed.  Take all definitions first, as a 
+  // signal may also be a reference
+  //
+
+  if ( ! ( make_new && new_sr != 0 ) )
+    {
+      
+      // sig -/+ ( ref1 + ref2 + ... ) / nr
+      std::string expr = dereference ? "v = s0 + " : "v = s0 - ";
+      if ( nr != 1 ) expr += "( ";
+      for (int r=0;r<nr;r++) expr += ( r ? " + s" : "s" ) + Helper::int2str( r+1 );
+      if ( nr != 1 ) expr += " ) / " + Helper::int2str( nr );
+
+      sigexpr_t fx;
+      if ( ! fx.compile( expr ) )
+	Helper::halt( "internal error in reference()" );
+      
+      std::vector<vchannel_t> vc( ns );
+      
+      for (int s=0;s<ns;s++) 
+	{
+	  std::vector<int> slots( 1 , signals(s) );
+	  for (int r=0;r<nr;r++) slots.push_back( refs(r) );
+	  vc[s] = vchannel( fx , slots );
+	}
+
+      // empirical ranges: build the reference once per record (as below)
+      
+      std::vector<double> pmin( ns , 0 ) , pmax( ns , 0 );
+      bool first = true;
+      
+      int rec = timeline.first_record();
+      while ( rec != -1 )
+	{
+	  ensure_loaded( rec );
+	  
+	  const edf_record_t & record = records.find(rec)->second;
+	  
+	  std::vector<std::vector<double> > refdata;
+	  for (int r=0;r<nr;r++) 		
+	    refdata.push_back( record.get_pdata( refs(r) ) );
+	  
+	  std::vector<double> reference( np_sig );
+	  for (int i=0;i<np_sig;i++) 
+	    {
+	      double avg = 0;
+	      for (int r=0;r<nr;r++) avg += refdata[r][i];
+	      if ( nr != 1 ) avg /= (double)nr;
+	      reference[i] = avg;
+	    }
+	  
+	  for (int s=0;s<ns;s++)
+	    {
+	      std::vector<double> d0 = record.get_pdata( signals(s) );
+	      for (int i=0;i<np_sig;i++)
+		{
+		  const double x = dereference ? d0[i] + reference[i] : d0[i] - reference[i];
+		  if ( first && i == 0 ) pmin[s] = pmax[s] = x;
+		  else if ( x < pmin[s] ) pmin[s] = x;
+		  else if ( x > pmax[s] ) pmax[s] = x;
+		}
+	    }
+	  
+	  first = false;
+	  rec = timeline.next_record(rec);
+	}
+      
+      for (int s=0;s<ns;s++) 
+	{
+	  if ( nr == 1 && signals(s) == refs(0) ) 
+	    {
+	      if ( verbose )
+		logger << " skipping " << refs.label(0) << " to not re-reference to self\n"; 
+	      continue;
+	    }
+	  
+	  update_virtual_signal( signals(s) , vc[s] , &pmin[s] , &pmax[s] );
+	}
+      
+      return;
+    }
+  
+  
   //
   // Build reference once
   //
@@ -3539,22 +3788,17 @@ void edf_t::copy_signal( const std::string & from_label , const std::string & to
   
 
   //
-  // get data
+  // add as a virtual channel (w/ same pmin/pmax and dmin/dmax)
   //
 
-  interval_t interval = timeline.wholetrace();  
-  slice_t slice( *this , s1 , interval );
-  const std::vector<double> * d = slice.pdata();
-
-
-  //
-  // add signal (w/ same pmin/pmax and dmin/dmax)
-  //
+  sigexpr_t fx;
+  fx.compile( "v = s0" );
   
-  add_signal( to_label , header.sampling_freq(s1) , *d ,
-	      header.physical_min[s1] , header.physical_max[s1] ,
-	      header.digital_min[s1] , header.digital_max[s1] 
-	      );
+  add_virtual_signal( to_label , header.sampling_freq(s1) ,
+		      vchannel( fx , std::vector<int>( 1 , s1 ) ) ,
+		      header.physical_min[s1] , header.physical_max[s1] ,
+		      header.digital_min[s1] , header.digital_max[s1] 
+		      );
   
   //
   // and copy the header values that would not have been properly set by add_signal()
@@ -3614,11 +3858,28 @@ void edf_t::update_records( int a , int b , int s , const std::vector<double> *
 
   read_records( a , b );
 
+  // only part of this channel will change
+  if ( is_virtual( s ) || vchannel_reads( s , s ) ) materialize();
+
   for ( int r = a ; r <= b ; r++ ) 
     {
       
       // find records      
-      std::vector<int16_t>    & data  = records.find(r)->second.data[ s ];
+      std::vector<int16_t>    & data  = records.find(r)->second.digital( s );
+      std::vector<double>     & pdata = records.find(r)->second.pdata[ s ];
+      
+      // float-channels=T: keep physical values (within the header range)
+      if ( globals::float_channels || pdata.size() != 0 )
+	{
+	  pdata.resize( points_per_record );
+	  for (int p=0;p<points_per_record;p++)
+	    {
+	      const double x = (*d)[cnt++];
+	      pdata[p] = x < pmin ? pmin : ( x > pmax ? pmax : x );
+	    }
+	  std::vector<int16_t>().swap( data );
+	  continue;
+	}
       
       // check that we did not change sample rate      
       if ( data.size() != points_per_record ) 
@@ -3672,6 +3933,11 @@ void edf_t::update_signal( int s , const std::vector<double> * d , int16_t * dmi
     Helper::halt( "internal error in update_signal()" );
 
   if ( debug ) std::cout << " n = " << n << "\n";
+
+  // any virtual channels still using the current data?  (if this
+  // channel is itself virtual, its definition is simply replaced)
+  if ( vchannel_reads( s , s ) ) materialize();
+  vchannels.erase( s );
   
   bool set_minmax = dmin_ != NULL ; 
   
@@ -3769,8 +4035,26 @@ void edf_t::update_signal( int s , const std::vector<double> * d , int16_t * dmi
 		  
       // find records
       
-      //      std::vector<double> & pdata = records.find(r)->second.pdata[ s ];
+      // (all values are replaced, so no need to decode this channel)
+      records.find(r)->second.pending[ s ] = -1;
       std::vector<int16_t>    & data  = records.find(r)->second.data[ s ];
+
+      // float-channels=T: store the (clamped) physical values as is
+      if ( globals::float_channels )
+	{
+	  std::vector<double> & pdata = records.find(r)->second.pdata[ s ];
+	  pdata.resize( points_per_record );
+	  for (int p=0;p<points_per_record;p++)
+	    {
+	      const double x = (*d)[cnt++];
+	      pdata[p] = x < pmin ? pmin : ( x > pmax ? pmax : x );
+	    }
+	  std::vector<int16_t>().swap( data );
+	  r = timeline.next_record(r);
+	  continue;
+	}
+      else if ( records.find(r)->second.pdata[ s ].size() != 0 )
+	std::vector<double>().swap( records.find(r)->second.pdata[ s ] );
       
       // check that we did not change sample rate
       
@@ -3806,6 +4090,338 @@ void edf_t::update_signal( int s , const std::vector<double> * d , int16_t * dmi
 
 
 
+//
+// Virtual channels
+//
+
+bool vchannel_t::reads( const int s ) const
+{
+  for (int i=0; i<src.size(); i++)
+    {
+      if ( src[i].v.size() != 0 )
+	{
+	  if ( src[i].v[0].reads( s ) ) return true;
+	}
+      else if ( src[i].slot == s ) return true;
+    }
+  return false;
+}
+
+void vchannel_t::shift( const int s )
+{
+  for (int i=0; i<src.size(); i++)
+    {
+      if ( src[i].v.size() != 0 ) src[i].v[0].shift( s );
+      else if ( src[i].slot > s ) --src[i].slot;
+    }
+}
+
+
+vsource_t edf_t::vsource( const int s ) const
+{
+  vsource_t src;
+  src.slot = s;
+  src.bv = header.bitvalue[s];
+  src.os = header.offset[s];
+
+  // if itself virtual, take a copy of the current definition
+  std::map<int,vchannel_t>::const_iterator vv = vchannels.find( s );
+  if ( vv != vchannels.end() ) src.v.push_back( vv->second );
+
+  return src;
+}
+
+
+vchannel_t edf_t::vchannel( const sigexpr_t & fx , const std::vector<int> & slots ) const
+{
+  if ( slots.size() != fx.symbols().size() )
+    Helper::halt( "internal error in vchannel()" );
+
+  vchannel_t v;
+  v.fx = fx;
+  for (int i=0; i<slots.size(); i++)
+    v.src.push_back( vsource( slots[i] ) );
+  
+  // scaling set by add_virtual_signal() or update_virtual_signal()
+  v.bv = 1;
+  v.os = 0;
+  v.clamp = false;
+  v.pmin = v.pmax = 0;
+  
+  return v;
+}
+
+
+void edf_t::vchannel_eval( const vchannel_t & v , const edf_record_t & record , std::vector<double> * y ) const
+{
+  const int ns = v.src.size();
+
+  std::vector<std::vector<double> > x( ns );
+  std::vector<const double*> in( ns );
+  std::vector<int16_t> t;
+  int n = 0;
+  
+  for (int i=0; i<ns; i++)
+    {
+      const vsource_t & src = v.src[i];
+
+      // physical values, either from a nested virtual channel or
+      // stored as such (float-channels=T), are used directly
+      
+      const std::vector<double> * p = NULL;
+
+      if ( src.v.size() != 0 )
+	{
+	  if ( globals::float_channels )
+	    {
+	      vchannel_physical( src.v[0] , record , &x[i] );
+	      p = &x[i];
+	    }
+	  else
+	    vchannel_digital( src.v[0] , record , &t );
+	}
+      else if ( record.pdata[ src.slot ].size() != 0 )
+	p = &record.pdata[ src.slot ];
+      
+      const std::vector<int16_t> & d = src.v.size() != 0 ? t : record.digital( src.slot );
+
+      const int ni = p != NULL ? p->size() : d.size();
+      if ( i == 0 ) n = ni;
+      else if ( ni != n )
+	Helper::halt( "internal error in vchannel_eval(): different record sizes" );
+
+      if ( p != NULL )
+	{
+	  in[i] = p->data();
+	  continue;
+	}
+      
+      x[i].resize( n );
+      for (int j=0; j<n; j++)
+	x[i][j] = edf_record_t::dig2phys( d[j] , src.bv , src.os );
+      in[i] = x[i].data();
+    }
+
+  y->resize( n );
+  v.fx.evaluate( in , n , y->data() );
+}
+
+
+void edf_t::vchannel_digital( const vchannel_t & v , const edf_record_t & record , std::vector<int16_t> * d ) const
+{
+  // as update_signal() or add_signal() would have stored it
+  std::vector<double> y;
+  vchannel_eval( v , record , &y );
+  const int n = y.size();
+  d->resize( n );
+  for (int j=0; j<n; j++)
+    {
+      double x = y[j];
+      if ( v.clamp )
+	{
+	  if ( x < v.pmin ) x = v.pmin;
+	  if ( x > v.pmax ) x = v.pmax;
+	}
+      (*d)[j] = edf_record_t::phys2dig( x , v.bv , v.os );
+    }
+}
+
+
+void edf_t::vchannel_physical( const vchannel_t & v , const edf_record_t & record , std::vector<double> * y ) const
+{
+  // as vchannel_digital(), but kept within the header range rather than quantized
+  vchannel_eval( v , record , y );
+  const int n = y->size();
+  for (int j=0; j<n; j++)
+    {
+      if ( (*y)[j] < v.pmin ) (*y)[j] = v.pmin;
+      else if ( (*y)[j] > v.pmax ) (*y)[j] = v.pmax;
+    }
+}
+
+
+void edf_t::vchannel_range( const vchannel_t & v , double * pmin , double * pmax )
+{
+  bool first = true;
+  std::vector<double> y;
+  int r = timeline.first_record();
+  while ( r != -1 )
+    {
+      ensure_loaded( r );
+      vchannel_eval( v , records.find(r)->second , &y );
+      for (int j=0; j<y.size(); j++)
+	{
+	  if ( first ) { *pmin = *pmax = y[j]; first = false; }
+	  else if ( y[j] < *pmin ) *pmin = y[j];
+	  else if ( y[j] > *pmax ) *pmax = y[j];
+	}
+      r = timeline.next_record(r);
+    }
+}
+
+
+void edf_t::add_virtual_signal( const std::string & label , const int Fs , const vchannel_t & v0 ,
+				double pmin , double pmax , int16_t dmin , int16_t dmax )
+{
+  
+  // as add_signal(), except that only the (empirical) range is
+  // computed here
+  
+  const int n_samples = Fs < 0 ? -Fs : Fs * header.record_duration ;
+
+  if ( header.nr == 0 )
+    {
+      logger << " **empty EDF, not going to add channel " << label << " **\n";
+      return;
+    }
+
+  vchannel_t v = v0;
+  
+  if ( pmin == pmax ) 
+    vchannel_range( v , &pmin , &pmax );
+  
+  if ( fabs( pmin - pmax ) <= 1e-6 )
+    {
+      pmin -= 1.0;
+      pmax += 1.0;
+    }
+  
+  if ( dmax == dmin )
+    {
+      dmax = 32767;
+      dmin = -32768;
+    }
+  
+  v.bv = ( pmax - pmin ) / (double)( dmax - dmin );
+  v.os = ( pmax / v.bv ) - dmax;
+  v.clamp = false;
+  v.pmin = pmin;
+  v.pmax = pmax;
+
+  // (empty) slot in each record
+  int r = timeline.first_record();
+  while ( r != -1 ) 
+    {
+      ensure_loaded( r );
+      records.find(r)->second.add_data( std::vector<int16_t>() );
+      r = timeline.next_record(r);
+    }
+  
+  add_signal_header( label , n_samples , pmin , pmax , dmin , dmax );
+
+  vchannels[ header.ns - 1 ] = v;
+  
+}
+
+
+void edf_t::update_virtual_signal( int s , const vchannel_t & v0 , const double * pmin_ , const double * pmax_ )
+{
+  
+  if ( header.is_annotation_channel(s) ) 
+    Helper::halt( "edf_t:: internal error, cannot update an annotation channel" );
+
+  // as update_signal(), using the full digital range and the
+  // empirical physical range (computed here, unless already known)
+  
+  vchannel_t v = v0;
+
+  double pmin = 0 , pmax = 0;
+  if ( pmin_ != NULL && pmax_ != NULL )
+    {
+      pmin = *pmin_;
+      pmax = *pmax_;
+    }
+  else
+    vchannel_range( v , &pmin , &pmax );
+
+  const int16_t dmin = -32768;
+  const int16_t dmax = 32767;
+  
+  header.digital_min[s] = dmin;
+  header.digital_max[s] = dmax;
+  header.physical_min[s] = pmin;
+  header.physical_max[s] = pmax;
+  
+  v.bv = ( pmax - pmin ) / (double)( dmax - dmin );
+  v.os = ( pmax / v.bv ) - dmax;
+  v.clamp = true;
+  v.pmin = pmin;
+  v.pmax = pmax;
+  
+  header.bitvalue[s] = v.bv;
+  header.offset[s] = v.os;
+
+  // the stored data for this slot is left as is, so any other virtual
+  // channels that depend on it are not affected
+  
+  vchannels[ s ] = v;
+}
+
+
+bool edf_t::vchannel_reads( const int s , const int except ) const
+{
+  std::map<int,vchannel_t>::const_iterator vv = vchannels.begin();
+  while ( vv != vchannels.end() )
+    {
+      if ( vv->first != except && vv->second.reads( s ) ) return true;
+      ++vv;
+    }
+  return false;
+}
+
+
+void edf_t::materialize()
+{
+  
+  if ( vchannels.size() == 0 ) return;
+
+  int r = timeline.first_record();
+  while ( r != -1 )
+    {
+      ensure_loaded( r );
+
+      edf_record_t & record = records.find(r)->second;
+
+      // evaluate all before storing any, as one may read another's
+      // (current) stored data
+      
+      std::vector<std::vector<int16_t> > d( vchannels.size() );
+      std::vector<std::vector<double> > p( globals::float_channels ? vchannels.size() : 0 );
+
+      int k = 0;
+      std::map<int,vchannel_t>::const_iterator vv = vchannels.begin();
+      while ( vv != vchannels.end() )
+	{
+	  if ( globals::float_channels )
+	    vchannel_physical( vv->second , record , &p[k++] );
+	  else
+	    vchannel_digital( vv->second , record , &d[k++] );
+	  ++vv;
+	}
+
+      k = 0;
+      vv = vchannels.begin();
+      while ( vv != vchannels.end() )
+	{
+	  record.pending[ vv->first ] = -1;
+	  record.data[ vv->first ].swap( d[k] );
+	  if ( globals::float_channels )
+	    record.pdata[ vv->first ].swap( p[k] );
+	  else
+	    std::vector<double>().swap( record.pdata[ vv->first ] );
+	  ++k;
+	  ++vv;
+	}
+      
+      r = timeline.next_record(r);
+    }
+  
+  vchannels.clear();
+  
+}
+
+
+
 edf_record_t::edf_record_t( edf_t * e ) 
 {    
 
@@ -3813,7 +4429,9 @@ edf_record_t::edf_record_t( edf_t * e )
 
   // only store digital value, convert on-the-fly
   data.resize( edf->header.ns );
-  //pdata.resize( edf->header.ns );
+  pdata.resize( edf->header.ns );
+  pending.resize( edf->header.ns , -1 );
+  rec = -1;
   
   for (int s = 0 ; s < edf->header.ns ; s++)
     {
@@ -28,6 +28,7 @@
 #include "tal.h"
 #include "edfz/edfz.h"
 #include "edf/signal-list.h"
+#include "edf/sigexpr.h"
 
 #include <iostream>
 #include <vector>
@@ -240,6 +241,49 @@ struct edf_header_t
 
 
 
+//
+// Virtual channels: defined (by REFERENCE, COPY or TRANS) as an
+// expression of other channels, and only evaluated when sliced; they
+// are materialized (i.e. written to the records) by WRITE, or when
+// any of the stored data they depend on is about to change.  Each
+// source is either the stored (digital) data of a slot, or a nested
+// virtual channel, as it was when this one was defined.  Values are
+// quantized exactly as add_signal()/update_signal() would have stored
+// them
+//
+
+struct vchannel_t;
+
+struct vsource_t
+{
+  // stored slot (if 'v' is empty), and scaling to decode it
+  int slot;
+  double bv, os;
+
+  // or, a nested definition (size 0 or 1)
+  std::vector<vchannel_t> v;
+};
+
+struct vchannel_t
+{
+  // symbols()[i] <--> src[i]
+  sigexpr_t fx;
+  std::vector<vsource_t> src;
+
+  // quantization of the output
+  double bv, os;
+  bool clamp;
+  double pmin, pmax;
+
+  // depends on the stored data in slot 's'?
+  bool reads( const int s ) const;
+
+  // slot 's' has been dropped
+  void shift( const int s );
+};
+
+
+
 struct edf_record_t
 {
 
@@ -270,7 +314,7 @@ struct edf_record_t
   
   void add_data( const std::vector<int16_t> & );
   
-  std::vector<double> get_pdata( const int signal );
+  std::vector<double> get_pdata( const int signal ) const;
   
   // here we know which slot to add to
   void add_annot( const std::string & , int signal );
@@ -282,9 +326,22 @@ struct edf_record_t
   //  void calc_data( double bitvalue , double offset  );
 
   void drop( const int s );
+
+  // digital values for slot 's', decoding them first if needed
+  const std::vector<int16_t> & digital( const int s ) const
+  { if ( pending[s] != -1 ) decode( s ); return data[s]; } 
+
+  std::vector<int16_t> & digital( const int s )
+  { if ( pending[s] != -1 ) decode( s ); return data[s]; } 
   
  private:
 
+  // read and decode a single channel from the EDF
+  void decode( const int s ) const;
+
+  // decode a single channel from raw record bytes
+  void unpack( const int s , const byte_t * p , const int nsamples ) const;
+
 
   //
   // Primary data store ( signal x samples per record )
@@ -292,10 +349,19 @@ struct edf_record_t
   
   edf_t * edf;
   
-  std::vector<std::vector<int16_t> >    data;
+  // (mutable, as channels are decoded on first access)
+  mutable std::vector<std::vector<int16_t> >    data;
+
+  // for records from a standard EDF, channels not yet decoded: the
+  // channel in the original EDF for each slot (or -1 if in data[])
+  mutable std::vector<int> pending;
+
+  // record number in the original EDF
+  int rec;
   
-  // compute this on-the-fly
-  //  std::vector<std::vector<double> > pdata;  // physically-scaled
+  // physically-scaled values: only populated for modified channels
+  // under float-channels=T, in which case data[s] is left empty
+  std::vector<std::vector<double> >     pdata;
   
  public:
 
@@ -342,6 +408,8 @@ public:
   std::map<int,edf_record_t> records;
 
   std::set<int>              inp_signals_n; // read these signals
+
+  std::map<int,vchannel_t>   vchannels;     // virtual channels (by slot)
   
   int                        record_size;   // bytes per record (for ns_all signals)
   int                        header_size;   // bytes for entire header
@@ -430,6 +498,37 @@ public:
 
   void update_records( int a , int b , int s , const std::vector<double> * );
 
+  //
+  // Virtual channels
+  //
+
+  bool is_virtual( const int s ) const { return vchannels.find(s) != vchannels.end(); }
+
+  // current state of slot 's', as a source for a new virtual channel
+  vsource_t vsource( const int s ) const;
+
+  // definition from a compiled expression: symbols()[i] <--> slots[i]
+  vchannel_t vchannel( const sigexpr_t & fx , const std::vector<int> & slots ) const;
+
+  // as add_signal() and update_signal(), but not evaluated here
+  void add_virtual_signal( const std::string & label , const int Fs , const vchannel_t & ,
+			   double pmin = 0 , double pmax = 0 ,
+			   int16_t dmin = 0 , int16_t dmax = 0 );
+
+  void update_virtual_signal( int s , const vchannel_t & , const double * pmin = NULL , const double * pmax = NULL );
+
+  // digital values of a virtual channel for one record
+  void vchannel_digital( const vchannel_t & , const edf_record_t & , std::vector<int16_t> * ) const;
+
+  // ... or physical values, clamped but not quantized (float-channels=T)
+  void vchannel_physical( const vchannel_t & , const edf_record_t & , std::vector<double> * ) const;
+
+  // does any virtual channel (other than 'except') depend on the stored data in slot 's'?
+  bool vchannel_reads( const int s , const int except = -1 ) const;
+
+  // evaluate and store all virtual channels
+  void materialize();
+
   void data_dumper( const std::string & , const param_t & );
   
   void seg_dumper( param_t & param );
@@ -500,7 +599,17 @@ public:
   void rescale( const int s , const std::string & sc );
 
 private:
+
+  // header entries for a new channel, given its scaling
+  void add_signal_header( const std::string & label , const int n_samples ,
+			  double pmin , double pmax , int16_t dmin , int16_t dmax );
   
+  // physical values of a virtual channel for one record (i.e. before quantization)
+  void vchannel_eval( const vchannel_t & , const edf_record_t & , std::vector<double> * ) const;
+  
+  // empirical physical range of a virtual channel
+  void vchannel_range( const vchannel_t & , double * pmin , double * pmax );
+
   //
   // File buffer for standard EDF
   //
@@ -567,6 +676,7 @@ public:
     header.init();
     records.clear();    
     inp_signals_n.clear();
+    vchannels.clear();
   }
   
   
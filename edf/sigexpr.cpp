@@ -0,0 +1,267 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "edf/sigexpr.h"
+
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+// sample points per block: small enough that the (few) scratch
+// buffers stay in cache
+
+static const int sigexpr_block = 1024;
+
+void sigexpr_t::skip()
+{
+  while ( pos < s.size() && isspace( s[pos] ) ) ++pos;
+}
+
+bool sigexpr_t::ident( std::string * id )
+{
+  skip();
+  if ( pos >= s.size() ) return false;
+  if ( ! ( isalpha( s[pos] ) || s[pos] == '_' ) ) return false;
+  const int p0 = pos;
+  while ( pos < s.size() && ( isalnum( s[pos] ) || s[pos] == '_' ) ) ++pos;
+  *id = s.substr( p0 , pos - p0 );
+  return true;
+}
+
+bool sigexpr_t::compile( const std::string & expr )
+{
+  s = expr;
+  pos = 0;
+  code.clear();
+  syms.clear();
+  
+  // target = 
+  if ( ! ident( &lhs ) ) return false;
+  skip();
+  if ( pos >= s.size() || s[pos] != '=' ) return false;
+  ++pos;
+  
+  bool cnst = false;
+  if ( ! sum( &cnst ) ) return false;
+  
+  // allow a trailing ';' but nothing else
+  skip();
+  if ( pos < s.size() && s[pos] == ';' ) { ++pos; skip(); }
+  if ( pos != s.size() ) return false;
+
+  // at least one channel
+  if ( syms.size() == 0 ) return false;
+  
+  // stack depth
+  depth = 0;
+  int d = 0;
+  for (int i=0; i<code.size(); i++)
+    {
+      if ( code[i].op == PUSH_SYM || code[i].op == PUSH_CONST ) ++d;
+      else --d;
+      if ( d > depth ) depth = d;
+    }
+  
+  data.resize( syms.size() , NULL );
+  return true;
+}
+
+bool sigexpr_t::sum( bool * cnst )
+{
+  if ( ! product( cnst ) ) return false;
+  while ( 1 )
+    {
+      skip();
+      if ( pos >= s.size() || ( s[pos] != '+' && s[pos] != '-' ) ) return true;
+      const op_t op = s[pos] == '+' ? ADD : SUB;
+      ++pos;
+      bool cnst2 = false;
+      if ( ! product( &cnst2 ) ) return false;
+      // leave constant (i.e. possibly integer) arithmetic to Eval
+      if ( *cnst && cnst2 ) return false;
+      *cnst = false;
+      code.push_back( instr_t( op ) );
+    }
+}
+
+bool sigexpr_t::product( bool * cnst )
+{
+  if ( ! unary( cnst ) ) return false;
+  while ( 1 )
+    {
+      skip();
+      if ( pos >= s.size() || ( s[pos] != '*' && s[pos] != '/' ) ) return true;
+      const op_t op = s[pos] == '*' ? MUL : DIV;
+      ++pos;
+      bool cnst2 = false;
+      if ( ! unary( &cnst2 ) ) return false;
+      if ( *cnst && cnst2 ) return false;
+      *cnst = false;
+      code.push_back( instr_t( op ) );
+    }
+}
+
+bool sigexpr_t::unary( bool * cnst )
+{
+  skip();
+  // as for Eval, unary minus is only allowed on a numeric literal
+  if ( pos < s.size() && s[pos] == '-' )
+    {
+      ++pos;
+      skip();
+      if ( pos >= s.size() || ! ( isdigit( s[pos] ) || s[pos] == '.' ) ) return false;
+      if ( ! primary( cnst ) ) return false;
+      code.back().c = - code.back().c;
+      return true;
+    }
+  return primary( cnst );
+}
+
+bool sigexpr_t::primary( bool * cnst )
+{
+  skip();
+  if ( pos >= s.size() ) return false;
+
+  // ( sum )
+  if ( s[pos] == '(' )
+    {
+      ++pos;
+      if ( ! sum( cnst ) ) return false;
+      skip();
+      if ( pos >= s.size() || s[pos] != ')' ) return false;
+      ++pos;
+      return true;
+    }
+
+  // numeric literal
+  if ( isdigit( s[pos] ) || s[pos] == '.' )
+    {
+      const char * p0 = s.c_str() + pos;
+      char * p1 = NULL;
+      const double c = strtod( p0 , &p1 );
+      if ( p1 == p0 ) return false;
+      pos += p1 - p0;
+      // e.g. '2x'
+      if ( pos < s.size() && ( isalpha( s[pos] ) || s[pos] == '_' ) ) return false;
+      code.push_back( instr_t( PUSH_CONST , 0 , c ) );
+      *cnst = true;
+      return true;
+    }
+
+  // symbol (but not a function call)
+  std::string id;
+  if ( ! ident( &id ) ) return false;
+  skip();
+  if ( pos < s.size() && s[pos] == '(' ) return false;
+  
+  int k = std::find( syms.begin() , syms.end() , id ) - syms.begin();
+  if ( k == syms.size() ) syms.push_back( id );
+  code.push_back( instr_t( PUSH_SYM , k ) );
+  *cnst = false;
+  return true;
+}
+
+
+//
+// Block kernels: r[] = a op b, for vector/scalar combinations
+//
+
+struct sigexpr_add_t { double operator()( const double x , const double y ) const { return x + y; } };
+struct sigexpr_sub_t { double operator()( const double x , const double y ) const { return x - y; } };
+struct sigexpr_mul_t { double operator()( const double x , const double y ) const { return x * y; } };
+struct sigexpr_div_t { double operator()( const double x , const double y ) const { return x / y; } };
+
+template<class F>
+static void sigexpr_apply( const double * a , const double ac , const bool as ,
+			   const double * b , const double bc , const bool bs ,
+			   double * r , const int n )
+{
+  F f;
+  if ( as ) for (int i=0; i<n; i++) r[i] = f( ac , b[i] );
+  else if ( bs ) for (int i=0; i<n; i++) r[i] = f( a[i] , bc );
+  else for (int i=0; i<n; i++) r[i] = f( a[i] , b[i] );
+}
+
+
+void sigexpr_t::evaluate( const std::vector<const double*> & in , const int n , double * out ) const
+{
+
+  // stack: either a vector (p) or scalar (c)
+  struct slot_t { const double * p; double c; bool scalar; };
+
+  std::vector<slot_t> st( depth );
+
+  // scratch buffer for each stack position
+  std::vector<std::vector<double> > buf( depth , std::vector<double>( sigexpr_block ) );
+
+  const int nc = code.size();
+  
+  for (int b0 = 0 ; b0 < n ; b0 += sigexpr_block )
+    {
+      
+      const int nb = std::min( sigexpr_block , n - b0 );
+
+      int sp = 0;
+
+      for (int k=0; k<nc; k++)
+	{
+	  const instr_t & ins = code[k];
+
+	  if ( ins.op == PUSH_SYM )
+	    {
+	      st[sp].p = in[ ins.sym ] + b0;
+	      st[sp].scalar = false;
+	      ++sp;
+	      continue;
+	    }
+
+	  if ( ins.op == PUSH_CONST )
+	    {
+	      st[sp].c = ins.c;
+	      st[sp].scalar = true;
+	      ++sp;
+	      continue;
+	    }
+	  
+	  // last op writes straight to the output
+	  double * r = k == nc - 1 ? out + b0 : &buf[ sp - 2 ][0];
+	  
+	  slot_t & a = st[sp-2];
+	  const slot_t & b = st[sp-1];
+	  
+	  if      ( ins.op == ADD ) sigexpr_apply<sigexpr_add_t>( a.p , a.c , a.scalar , b.p , b.c , b.scalar , r , nb );
+	  else if ( ins.op == SUB ) sigexpr_apply<sigexpr_sub_t>( a.p , a.c , a.scalar , b.p , b.c , b.scalar , r , nb );
+	  else if ( ins.op == MUL ) sigexpr_apply<sigexpr_mul_t>( a.p , a.c , a.scalar , b.p , b.c , b.scalar , r , nb );
+	  else                      sigexpr_apply<sigexpr_div_t>( a.p , a.c , a.scalar , b.p , b.c , b.scalar , r , nb );
+	  
+	  a.p = r;
+	  a.scalar = false;
+	  --sp;
+	}
+
+      // e.g. just 'X = C3'
+      if ( st[0].p != out + b0 )
+	for (int i=0; i<nb; i++) out[ b0 + i ] = st[0].p[i];
+      
+    }
+  
+}
@@ -0,0 +1,99 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __SIGEXPR_H__
+#define __SIGEXPR_H__
+
+#include <string>
+#include <vector>
+
+//
+// Compiled, fused evaluator for simple signal arithmetic, as used by TRANS:
+//   target = expression
+// where the expression only contains + - * /, brackets, (signed)
+// numeric literals and channel symbols.  Channels are bound by pointer
+// and the whole expression is evaluated a block of sample points at a
+// time, without any full-length temporaries.  Anything else (functions,
+// logical operators, multiple statements, ...) is left to Eval
+//
+
+struct sigexpr_t
+{
+
+  // returns F if not of the above form
+  bool compile( const std::string & expr );
+
+  // the assigned symbol
+  const std::string & target() const { return lhs; }
+
+  // symbols referenced by the expression (in order of first use)
+  const std::vector<std::string> & symbols() const { return syms; }
+
+  // attach data for symbol 'i' (not copied: must remain valid for evaluate())
+  void bind( const int i , const double * p ) { data[i] = p; }
+
+  // evaluate over 'n' points, writing directly to out[]
+  void evaluate( const int n , double * out ) const { evaluate( data , n , out ); }
+
+  // as above, but with inputs given here (in symbols() order) rather than bound
+  void evaluate( const std::vector<const double*> & in , const int n , double * out ) const;
+
+ private:
+
+  enum op_t { PUSH_SYM , PUSH_CONST , ADD , SUB , MUL , DIV };
+
+  struct instr_t {
+    instr_t( op_t op , int sym = 0 , double c = 0 ) : op(op) , sym(sym) , c(c) { }
+    op_t op;
+    int sym;
+    double c;
+  };
+
+  // program (RPN)
+  std::vector<instr_t> code;
+
+  // max stack depth
+  int depth;
+
+  std::string lhs;
+
+  std::vector<std::string> syms;
+
+  std::vector<const double*> data;
+
+  // recursive-descent parser: each returns F on failure; 'cnst' is set T
+  // if the (sub)expression has no symbols
+  
+  std::string s;
+  int pos;
+  
+  bool sum( bool * cnst );
+  bool product( bool * cnst );
+  bool unary( bool * cnst );
+  bool primary( bool * cnst );
+  
+  void skip();
+  bool ident( std::string * );
+  
+};
+
+#endif
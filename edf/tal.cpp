@@ -57,7 +57,7 @@ tal_t edf_t::tal( const int signal , const int rec )
   // std::cout << "s = " << records[rec].data.size() << "\n";
   // std::cout << "signal = " <<signal << "\n";
 
-  const std::vector<int16_t> & raw = records.find(rec)->second.data[signal];
+  const std::vector<int16_t> & raw = records.find(rec)->second.digital( signal );
 
   const int np_used = raw.size();
   
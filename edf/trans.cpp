@@ -22,6 +22,7 @@
 
 #include "edf/edf.h"
 #include "edf/slice.h"
+#include "edf/sigexpr.h"
 
 #include "helper/helper.h"
 #include "helper/logger.h"
@@ -86,6 +87,8 @@ void proc_trans( edf_t & edf , param_t & param )
   
   std::string expression = Helper::unquote( param.requires( "expr" ) , '#' );
 
+  const std::string user_expression = expression;
+
   //
   // if evaluating a channel, ensure that the final return value is for that channel
   // (and ensuree it is sanitized, just in case this is needed)
@@ -115,6 +118,98 @@ void proc_trans( edf_t & edf , param_t & param )
   if ( update_existing_channel )
     sr = edf.header.sampling_freq( edf.header.signal( siglab ) ) ;
   
+  //
+  // i.e. incase C3-M2, etc, Helper::sanitize all labels .. i.e. C3_M2
+  //
+  
+  std::map<std::string,std::string> clean2dirty, dirty2clean;
+  for (int s=0; s<edf.header.ns; s++)
+    {
+      if ( edf.header.is_annotation_channel( s ) ) continue;
+      dirty2clean[ edf.header.label[s] ] = Helper::sanitize( edf.header.label[s] );
+      clean2dirty[ Helper::sanitize( edf.header.label[s] ) ] = edf.header.label[s] ;
+    }
+
+  //
+  // simple arithmetic on channels, e.g. C3_new = C3 - (M1+M2)/2 : compile and
+  // define as a virtual channel (see sigexpr.h, edf.h); anything else 
+  // goes via Eval below
+  //
+
+  if ( channel_mode && ! verbose )
+    {
+      sigexpr_t fx;
+      
+      bool fast = fx.compile( user_expression ) && fx.target() == Helper::sanitize( siglab );
+      
+      const std::vector<std::string> & fsyms = fx.symbols();
+      
+      if ( fast )
+	for (int i=0; i<fsyms.size(); i++)
+	  if ( clean2dirty.find( fsyms[i] ) == clean2dirty.end() ) fast = false;
+      
+      if ( fast )
+	{
+	  
+	  // defined as a virtual channel, i.e. only evaluated when needed
+	  std::vector<int> slots( fsyms.size() );
+
+	  // attach in the same (sorted) order as below
+	  std::map<std::string,int> sorted;
+	  for (int i=0; i<fsyms.size(); i++) sorted[ fsyms[i] ] = i;
+	  
+	  int n = -1;
+	  
+	  std::map<std::string,int>::const_iterator ii = sorted.begin();
+	  while ( ii != sorted.end() )
+	    {
+	      const int i = ii->second;
+	      
+	      const std::string ch_label = clean2dirty[ fsyms[i] ];
+	      
+	      int slot = edf.header.signal( ch_label );
+	      
+	      int sr1 = edf.header.sampling_freq( slot );
+	      
+	      if ( sr != 0 && sr != sr1 )
+		Helper::halt( "all channels need to have similar sampling rates" );
+	      else
+		sr = sr1;
+	      
+	      // i.e. size of a whole-trace slice
+	      const int n1 = edf.header.nr * edf.header.n_samples[ slot ];
+	      
+	      if ( n == -1 ) n = n1;
+	      else if ( n1 != n )
+		Helper::halt( "all channels need to have similar sampling rates" );
+	      
+	      if ( ch_label != fsyms[i] ) 
+		logger << "  attaching " << ch_label << " (mapped to " << fsyms[i] << ") for " << n1 << " sample-points...\n";
+	      else
+		logger << "  attaching " << ch_label << " for " << n1 << " sample-points...\n";
+	      
+	      slots[i] = slot;
+	      
+	      ++ii;
+	    }
+	  
+	  logger << "  returned " << n << " sample-points\n";
+	  
+	  if ( update_existing_channel )
+	    {
+	      logger << "  updating " << siglab << "...\n";
+	      edf.update_virtual_signal( edf.header.signal( siglab ) , edf.vchannel( fx , slots ) );
+	    }
+	  else
+	    {
+	      logger << "  creating new channel " << siglab << "...\n";
+	      edf.add_virtual_signal( siglab , sr , edf.vchannel( fx , slots ) );
+	    }
+	  
+	  return;
+	}
+    }
+  
   //
   // output
   //
@@ -130,16 +225,6 @@ void proc_trans( edf_t & edf , param_t & param )
   //
   // inputs: get & bind any symbols (i.e. channel vevtors) required by the expression
   //
-
-  // i.e. incase C3-M2, etc, Helper::sanitize all labels .. i.e. C3_M2
-  
-  std::map<std::string,std::string> clean2dirty, dirty2clean;
-  for (int s=0; s<edf.header.ns; s++)
-    {
-      if ( edf.header.is_annotation_channel( s ) ) continue;
-      dirty2clean[ edf.header.label[s] ] = Helper::sanitize( edf.header.label[s] );
-      clean2dirty[ Helper::sanitize( edf.header.label[s] ) ] = edf.header.label[s] ;
-    }
     
   std::map<std::string,std::vector<double> > inputs;
   
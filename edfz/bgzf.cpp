@@ -231,6 +231,49 @@ static int deflate_block(BGZF *fp, int block_length)
   return compressed_length;
 }
 
+// As deflate_block(), but stateless (safe to call from multiple threads): deflate
+// length <= BGZF_MT_BLOCK_SIZE bytes from src into a complete BGZF block in dst
+// (of at least BGZF_BLOCK_SIZE bytes); as the input is capped below the deflate
+// worst case, all input always fits in the one block
+int bgzf_deflate_block(int compress_level, const void *src, int length, void *dst)
+{
+  uint8_t *buffer = (uint8_t*)dst;
+  int status, compressed_length;
+  uint32_t crc;
+  z_stream zs;
+
+  if (length < 0 || length > BGZF_MT_BLOCK_SIZE) return -1;
+  memcpy(buffer, g_magic, BLOCK_HEADER_LENGTH);
+  zs.zalloc = NULL;
+  zs.zfree = NULL;
+  zs.next_in = (Bytef*)src;
+  zs.avail_in = length;
+  zs.next_out = (Bytef*)&buffer[BLOCK_HEADER_LENGTH];
+  zs.avail_out = BGZF_BLOCK_SIZE - BLOCK_HEADER_LENGTH - BLOCK_FOOTER_LENGTH;
+  if (deflateInit2(&zs, compress_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return -1;
+  status = deflate(&zs, Z_FINISH);
+  if (deflateEnd(&zs) != Z_OK || status != Z_STREAM_END) return -1;
+  compressed_length = zs.total_out + BLOCK_HEADER_LENGTH + BLOCK_FOOTER_LENGTH;
+  packInt16((uint8_t*)&buffer[16], compressed_length - 1);
+  crc = crc32(0L, NULL, 0L);
+  crc = crc32(crc, (const Bytef*)src, length);
+  packInt32((uint8_t*)&buffer[compressed_length-8], crc);
+  packInt32((uint8_t*)&buffer[compressed_length-4], length);
+  return compressed_length;
+}
+
+// Write a block from bgzf_deflate_block(); any buffered (uncompressed) data must be flushed first
+int bgzf_write_block(BGZF *fp, const void *block, int block_length)
+{
+  assert(fp->open_mode == 'w' && fp->block_offset == 0);
+  if (fwrite(block, 1, block_length, (_bgzf_file_t)fp->fp) != block_length) {
+    fp->errcode |= BGZF_ERR_IO;
+    return -1;
+  }
+  fp->block_address += block_length;
+  return 0;
+}
+
 // Inflate the block in fp->compressed_block into fp->uncompressed_block
 static int inflate_block(BGZF* fp, int block_length)
 {
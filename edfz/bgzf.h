@@ -37,6 +37,10 @@ typedef unsigned char byte_t;
 
 #define BGZF_BLOCK_SIZE 0x10000 // 64k
 
+// max. input per block for bgzf_deflate_block(), such that the
+// compressed block is guaranteed to fit in BGZF_BLOCK_SIZE
+#define BGZF_MT_BLOCK_SIZE 0xff00
+
 #define BGZF_ERR_ZLIB   1
 #define BGZF_ERR_HEADER 2
 #define BGZF_ERR_IO     4
@@ -189,6 +193,26 @@ extern "C" {
    */
   int bgzf_read_block(BGZF *fp);
 
+  /**
+   * Compress up to BGZF_MT_BLOCK_SIZE bytes as a complete BGZF block; no
+   * shared state, so blocks can be deflated concurrently
+   *
+   * @param compress_level  zlib compression level (e.g. fp->compress_level)
+   * @param src    uncompressed data
+   * @param length size of src (<= BGZF_MT_BLOCK_SIZE)
+   * @param dst    output buffer, of at least BGZF_BLOCK_SIZE bytes
+   * @return       compressed block length; -1 on error
+   */
+  int bgzf_deflate_block(int compress_level, const void *src, int length, void *dst);
+
+  /**
+   * Append a block from bgzf_deflate_block() to a file opened for writing
+   * (with no pending uncompressed data)
+   *
+   * @return       0 on success and -1 on error
+   */
+  int bgzf_write_block(BGZF *fp, const void *block, int block_length);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,82 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "edfz/edfz.h"
+#include "helper/threads.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+
+void edfz_t::deflate_pending( const bool all )
+{
+
+  const int64_t bs = BGZF_MT_BLOCK_SIZE;
+
+  const int nb = all ? ( pending.size() + bs - 1 ) / bs : pending.size() / bs ;
+
+  if ( nb == 0 ) return;
+
+  // compress each block (in parallel) into its own slot...
+  
+  std::vector<byte_t> zbuf( (size_t)nb * BGZF_BLOCK_SIZE );
+  std::vector<int> zlen( nb );
+  const int level = file->compress_level;
+  
+  Helper::parallel_for( nb , [&]( int b ) {
+      const int n = std::min( bs , (int64_t)pending.size() - b * bs );
+      zlen[b] = bgzf_deflate_block( level , &pending[ b * bs ] , n , &zbuf[ (size_t)b * BGZF_BLOCK_SIZE ] );
+      if ( zlen[b] < 0 ) throw std::runtime_error( "problem compressing " + filename );
+    } , std::min( nb , nthreads ) );
+
+  // ... and write them in order, noting where each starts
+  
+  int64_t consumed = 0;
+  
+  for (int b=0; b<nb; b++)
+    {
+      blocks.push_back( std::make_pair( flushed + consumed , (int64_t)file->block_address ) );
+      
+      if ( bgzf_write_block( file , &zbuf[ (size_t)b * BGZF_BLOCK_SIZE ] , zlen[b] ) != 0 )
+	Helper::halt( "problem writing " + filename );
+      
+      consumed += std::min( bs , (int64_t)pending.size() - consumed );
+    }
+  
+  pending.erase( pending.begin() , pending.begin() + consumed );
+  flushed += consumed;
+  
+}
+
+
+int64_t edfz_t::virtual_offset( const int64_t upos ) const
+{
+  // last block starting at or before upos
+  std::vector<std::pair<int64_t,int64_t> >::const_iterator ii
+    = std::upper_bound( blocks.begin() , blocks.end() , std::make_pair( upos , (int64_t)INT64_MAX ) );
+  
+  if ( ii == blocks.begin() )
+    Helper::halt( "internal error mapping EDFZ offsets" );
+  --ii;
+  
+  return ( ii->second << 16 ) | ( ( upos - ii->first ) & 0xFFFF );
+}
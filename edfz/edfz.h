@@ -40,6 +40,8 @@ struct edfz_t {
     filename = "";
     record_size = 0;
     mode = 0;
+    nthreads = 1;
+    flushed = 0;
     index.clear();
   }
 
@@ -57,11 +59,16 @@ struct edfz_t {
     return file != NULL;
   }
 
-  bool open_for_writing( const std::string & fn )
+  // nt > 1 : buffer output and deflate batches of BGZF blocks in parallel
+  bool open_for_writing( const std::string & fn , const int nt = 1 )
   {    
     filename = fn;
     file = bgzf_open( filename.c_str() , "w" );
     mode = +1;
+    nthreads = nt < 1 ? 1 : nt;
+    flushed = 0;
+    pending.clear();
+    blocks.clear();
     return file != NULL;
   }
 
@@ -69,6 +76,8 @@ struct edfz_t {
   {
     if ( file == NULL ) return;
 
+    if ( nthreads > 1 ) deflate_pending( true );
+
     if ( bgzf_close( file ) == -1 ) 
       Helper::halt( "problem closing " + filename );
   }
@@ -82,6 +91,13 @@ struct edfz_t {
   inline int64_t write( byte_t * p , const int n )
   {
     int64_t offset = tell();
+    if ( nthreads > 1 )
+      {
+	pending.insert( pending.end() , p , p + n );
+	if ( pending.size() >= (size_t)nthreads * 4 * BGZF_MT_BLOCK_SIZE )
+	  deflate_pending( false );
+	return offset;
+      }
     if ( bgzf_write( file , p , n ) != n ) return -1;
     return offset;
   }
@@ -129,8 +145,11 @@ struct edfz_t {
     return file != NULL;     
   }
   
+  // nb. when writing with nthreads > 1, this is the uncompressed
+  // position, which write_index() maps to the BGZF virtual offset
   inline int64_t tell() 
   {
+    if ( mode == +1 && nthreads > 1 ) return flushed + pending.size();
     return bgzf_tell( file );
   }
     
@@ -185,6 +204,8 @@ struct edfz_t {
   bool write_index( const int rs )
   {
     record_size = rs;
+    // all blocks must be written, to know their (compressed) addresses
+    if ( nthreads > 1 ) deflate_pending( true );
     std::string indexname = filename + ".idx";
     std::ofstream O1( indexname.c_str() , std::ios::out );
     // first write record size
@@ -192,7 +213,7 @@ struct edfz_t {
     std::map<int,int64_t>::const_iterator ii = index.begin();
     while ( ii != index.end() )
       {
-	O1 << ii->second << "\n";
+	O1 << ( nthreads > 1 ? virtual_offset( ii->second ) : ii->second ) << "\n";
 	++ii;
       }
     O1.close();
@@ -210,6 +231,25 @@ struct edfz_t {
   
   // as specified by EDF header
   int record_size;
+
+  //
+  // parallel deflation (writing only; edfz.cpp)
+  //
+  
+  int nthreads;
+
+  // uncompressed data not yet deflated, and total bytes already deflated
+  std::vector<byte_t> pending;
+  int64_t flushed;
+  
+  // uncompressed start -> file address, for each block written
+  std::vector<std::pair<int64_t,int64_t> > blocks;
+
+  // deflate & write whole blocks from pending (or all, incl. a final partial block)
+  void deflate_pending( const bool all );
+
+  // uncompressed position -> BGZF virtual offset
+  int64_t virtual_offset( const int64_t upos ) const;
   
 };
 
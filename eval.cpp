@@ -606,6 +606,40 @@ void cmd_t::replace_wildcards( const std::string & id )
    
 }
 
+void cmd_t::literal_commands()
+{
+
+  // as replace_wildcards(), for the raw script; nb. any variable
+  // declaration/use, conditional block marker or ID wildcard means the
+  // command cannot be resolved yet (e.g. vars from a --serve job), so skip
+
+  std::vector<std::string> tok = Helper::quoted_parse( line , "\n" );
+
+  params.clear();
+  cmds.clear();
+
+  for (int c=0;c<tok.size();c++)
+    {
+      if ( tok[c].find( "${" ) != std::string::npos ||
+	   tok[c].find( "[[" ) != std::string::npos ||
+	   tok[c].find( "]]" ) != std::string::npos || 
+	   tok[c].find( globals::indiv_wildcard ) != std::string::npos )
+	continue;
+      
+      std::vector<std::string> ctok = Helper::quoted_parse( tok[c] , "\t " );
+      
+      if ( ctok.size() >= 1 ) 
+	{
+	  cmds.push_back( ctok[0] );
+	  param_t param;
+	  for (int j=1;j<ctok.size();j++) param.parse( ctok[j] );
+	  // i.e. for any @{includes}
+	  param.update( "." , globals::indiv_wildcard );
+	  params.push_back( param );
+	}
+    }
+}
+
 bool cmd_t::read( const std::string * str , bool silent )
 {
   
@@ -777,6 +811,7 @@ bool cmd_t::read( const std::string * str , bool silent )
   logger << "input(s): " << input << "\n";
   logger << "output  : " << writer.name() 
 	 << ( cmd_t::plaintext_mode ? " [dir for text-tables]" : "" ) 
+	 << ( cmd_t::colstore_mode ? " [dir for columnar tables]" : "" ) 
 	 << "\n";
 
   if ( signallist.size() > 0 )
@@ -814,6 +849,10 @@ bool cmd_t::read( const std::string * str , bool silent )
 bool cmd_t::eval( edf_t & edf ) 
 {
 
+  // optional timing/resource tracking (profile=T)
+
+  profiler_t profiler;
+  
   //
   // Loop over each command
   //
@@ -850,6 +889,7 @@ bool cmd_t::eval( edf_t & edf )
 
       writer.level( cmd(c) , "_" + cmd(c) );
       
+      if ( globals::profile ) profiler.start( cmd(c) , c+1 );
       
       //
       // Now process the command
@@ -1031,6 +1071,7 @@ bool cmd_t::eval( edf_t & edf )
 	  return false; 
 	}
 
+      if ( globals::profile ) profiler.stop();
        
       //
       // Was a problem flag set?
@@ -1048,10 +1089,23 @@ bool cmd_t::eval( edf_t & edf )
 	      PROBLEMS << edf.id << "\n";
 	      PROBLEMS.close();
 	    }
+
+	  // still report the profile for the commands run so far 
+	  if ( globals::profile ) 
+	    {
+	      writer.unlevel( "_" + cmd(c) );
+	      profiler.report( edf.id , num_cmds() + 1 );
+	    }
 	  
 	  return false;
 	}
       
+      //
+      // track this command (i.e. as a key for any persistent cache entries of subsequent commands)
+      //
+      
+      edf.timeline.cache.disk.add_history( cmd(c) + " " + param(c).dump( "" , " " ) );
+
       //
       // next command
       //
@@ -1062,6 +1116,12 @@ bool cmd_t::eval( edf_t & edf )
     } // next command
   
 
+  //
+  // Report profile, as a separate PROF table (after all commands)
+  //
+
+  if ( globals::profile ) profiler.report( edf.id , num_cmds() + 1 );
+  
 
   return true;
 }
@@ -1329,12 +1389,10 @@ void proc_pops( edf_t & edf , param_t & param )
   pops_t pops;  
 
   //
-  // set up features to calculate ('.' = internal defaults)
+  // set up features to calculate ('.' = internal defaults), and model
   //
-  
-  const std::string ftr_file = param.has( "features" ) ? param.value( "features" ) : "." ; 
-  
-  pops_t::specs.read( ftr_file );
+
+  proc_pops_preload( param );
 
   //
   // process individual (either trainer, or target)
@@ -1348,6 +1406,26 @@ void proc_pops( edf_t & edf , param_t & param )
     
 }
 
+// POPS : attach feature specs and model (if not already done), i.e. also
+// called once up-front in --serve mode
+
+void proc_pops_preload( param_t & param )
+{
+#ifdef HAS_LGBM
+
+  const std::string ftr_file = param.has( "features" ) ? param.value( "features" ) : "." ; 
+  
+  pops_t::specs.read( ftr_file );
+
+  // prediction mode: booster is cached by lgbm_t
+  if ( ( ! param.has( "train" ) ) && param.has( "model" ) )
+    pops_t::lgbm.load_model( param.value( "model" ) );
+  
+#else
+  Helper::halt( "no LGBM support compiled in" );
+#endif
+}
+
 
 // SUDS : staging
 
@@ -1361,7 +1439,22 @@ void proc_suds( edf_t & edf , param_t & param )
       return;
     }
   
-  // set up global parameters (i.e. should apply to target /and/ all trainers)
+  suds_t suds;
+
+  // set options, attach model and trainers (if not already done)
+  proc_suds_preload( param );
+  
+  // do actual scoring  
+  suds.score( edf , param );
+  
+}
+
+// SUDS : set up global parameters (i.e. should apply to target /and/
+// all trainers), load model and trainer library; these are cached, and
+// so only read once (e.g. up-front in --serve mode)
+
+void proc_suds_preload( param_t & param )
+{
   suds_t suds;
   suds_t::set_options( param );
 
@@ -1392,10 +1485,7 @@ void proc_suds( edf_t & edf , param_t & param )
     }
   else
     Helper::halt( "no library attached" );
-	   
-  // do actual scoring  
-  suds.score( edf , param );
-  
+
 }
 
 
@@ -3482,6 +3572,44 @@ void cmd_t::parse_special( const std::string & tok0 , const std::string & tok1 )
       return;
     }
 
+  // persistent (on-disk) cache for expensive intermediates
+  if ( Helper::iequals( tok0 , "cache-dir" ) )
+    {
+      globals::cache_folder = tok1;
+      return;
+    }
+
+  // per-command timing/resource profile (PROF table)
+  if ( Helper::iequals( tok0 , "profile" ) )
+    {
+      globals::profile = Helper::yesno( tok1 );
+      return;
+    }
+
+  // as above, but also append events to a Chrome trace (JSON) file
+  if ( Helper::iequals( tok0 , "profile-trace" ) )
+    {
+      globals::profile = true;
+      globals::profile_trace = Helper::expand( tok1 );
+      return;
+    }
+
+  // worker threads for parallel routines
+  if ( Helper::iequals( tok0 , "nthreads" ) )
+    {
+      if ( ! Helper::str2int( tok1 , &globals::nthreads ) )
+	Helper::halt( "expecting integer for nthreads=N" );
+      if ( globals::nthreads < 1 ) globals::nthreads = 1;
+      return;
+    }
+
+  // in-memory physical (rather than digital) storage of modified channels
+  if ( Helper::iequals( tok0 , "float-channels" ) )
+    {
+      globals::float_channels = Helper::yesno( tok1 );
+      return;
+    }
+
   // specify indiv (i.e. can be used if ID is numeric)
   if ( Helper::iequals( tok0 , "id" ) )
     {
@@ -4256,6 +4384,11 @@ void cmd_t::register_specials()
   specials.insert( "id" );
   specials.insert( "verbose" ) ;
   specials.insert( "devel" );
+  specials.insert( "nthreads" );
+  specials.insert( "float-channels" );
+  specials.insert( "cache-dir" );
+  specials.insert( "profile" );
+  specials.insert( "profile-trace" );
   specials.insert( "sec-dp" );
   specials.insert( "sig" ) ;
   specials.insert( "vars" );
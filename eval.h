@@ -131,6 +131,10 @@ class cmd_t
   
   void replace_wildcards( const std::string & id );
 
+  // as above, but without resolving anything: i.e. only keep commands
+  // that do not use variables, conditional blocks or the ID wildcard
+  void literal_commands();
+
   bool eval( edf_t & ) ;
   
   bool empty() const ;
@@ -181,6 +185,7 @@ class cmd_t
   static bool                               append_stout_file;
   static bool                               plaintext_mode;
   static std::string                        plaintext_root;
+  static bool                               colstore_mode;
   static bool                               has_indiv_wildcard;
   static std::string resolved_outdb( const std::string & id , const std::string & str );
   
@@ -277,6 +282,7 @@ void proc_file_mask( edf_t & , param_t & );
 void proc_file_annot( edf_t & , param_t & );
 void proc_sleep_stage( edf_t & , param_t & , bool verbose = false );
 void proc_suds( edf_t & , param_t & );
+void proc_suds_preload( param_t & );
 void proc_make_suds( edf_t & , param_t & );
 void proc_self_suds( edf_t & , param_t & );
 void proc_resoap( edf_t & , param_t & );
@@ -284,6 +290,7 @@ void proc_rebase_soap( edf_t & , param_t & );
 void proc_place_soap( edf_t & , param_t & );
 
 void proc_pops( edf_t & , param_t & );
+void proc_pops_preload( param_t & );
 
 void proc_copy_suds_cmdline();
 void proc_combine_suds_cmdline();
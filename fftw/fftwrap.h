@@ -461,6 +461,18 @@ class PWELCH
 
     process(); 
   } 
+
+  // restore a previously computed PSD (e.g. from the persistent cache)
+  
+ PWELCH( const std::vector<double> & f , 
+	 const std::vector<double> & p , 
+	 const std::vector<double> & psd_sd ) 
+   : psd(p) , psdsd(psd_sd) , freq(f) , data(p) , Fs(0) , M(0) , noverlap_segments(0) , 
+     window(WINDOW_NONE) , use_median(false) , calc_seg_sd( psd_sd.size() != 0 ) , 
+     average_adj(false) , use_nextpow2(false) 
+  {
+    N = psd.size();
+  }
   
   
   //
@@ -39,6 +39,7 @@ bool                               cmd_t::has_indiv_wildcard = false;
 
 bool                               cmd_t::plaintext_mode = false;
 std::string                        cmd_t::plaintext_root = ".";
+bool                               cmd_t::colstore_mode = false;
 
 std::map<std::string,std::string>  cmd_t::vars;
 std::map<std::string,std::map<std::string,std::string> >  cmd_t::ivars;
@@ -539,6 +539,39 @@ std::vector<std::string> Helper::char_split( const std::string & s , const char
   return strs;
 }
 
+int Helper::char_split( const std::string & s , const char c , std::vector<std::string> * strs )
+{
+  int k = 0;
+  const int n = s.size();
+  int p = 0;
+  
+  for (int j=0; j<=n; j++)
+    {
+      if ( j == n || s[j] == c )
+	{
+	  if ( j > p )
+	    {
+	      if ( k < strs->size() ) (*strs)[k].assign( s , p , j - p );
+	      else strs->push_back( s.substr( p , j - p ) );
+	      ++k;
+	    }
+	  p = j + 1;
+	}
+    }
+  
+  strs->resize( k );
+  return k;
+}
+
+int Helper::char_count_fields( const std::string & s , const char c )
+{
+  int k = 0;
+  const int n = s.size();
+  for (int j=0; j<n; j++)
+    if ( s[j] != c && ( j == 0 || s[j-1] == c ) ) ++k;
+  return k;
+}
+
 std::vector<std::string> Helper::char_split( const std::string & s , const char c , const char c2 , bool empty )
 {
   std::vector<std::string> strs;  
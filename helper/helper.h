@@ -235,6 +235,13 @@ namespace Helper
   std::vector<std::string> char_split( const std::string & s , const char c , const char c2 , bool empty );
   std::vector<std::string> char_split( const std::string & s , const char c , const char c2 , const char c3 , bool empty );
 
+  // as char_split( s, c, false ), but re-using the strings already in *strs (i.e. no
+  // allocations when called repeatedly on similar lines); returns the number of fields
+  int char_split( const std::string & s , const char c , std::vector<std::string> * strs );
+
+  // number of fields that char_split( s, c, false ) would return
+  int char_count_fields( const std::string & s , const char c );
+
   std::vector<std::string> quoted_char_split( const std::string & s , const char c , const char q , const char q2, bool empty );
   std::vector<std::string> quoted_char_split( const std::string & s , const char c , const char c2 , const char q , const char q2, bool empty );
   std::vector<std::string> quoted_char_split( const std::string & s , const char c , const char c2 , const char c3 , const char q , const char q2, bool empty );
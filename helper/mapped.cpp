@@ -0,0 +1,159 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "helper/mapped.h"
+
+#ifndef WINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+
+
+#ifdef WINDOWS
+
+// no mmap() under mingw: always read into the buffer (binary mode, so
+// that \r\n endings are seen, and handled, by getline() as elsewhere)
+
+bool mapped_file_t::open( const std::string & f )
+{
+  close();
+
+  FILE * in = fopen( f.c_str() , "rb" );
+  if ( in == NULL ) return false;
+
+  const size_t blk = 1 << 20;
+  size_t r = 0;
+  while ( 1 )
+    {
+      buffer.resize( r + blk );
+      size_t n = fread( &buffer[r] , 1 , blk , in );
+      r += n;
+      if ( n < blk ) break;
+    }
+  fclose( in );
+
+  buffer.resize( r );
+  len = r;
+  pos = 0;
+  data = len ? &buffer[0] : NULL;
+  return true;
+}
+
+#else
+
+bool mapped_file_t::open( const std::string & f )
+{
+  close();
+  
+  int fd = ::open( f.c_str() , O_RDONLY );
+  if ( fd == -1 ) return false;
+
+  struct stat st;
+  if ( fstat( fd , &st ) != 0 ) { ::close( fd ); return false; }
+  
+  len = st.st_size;
+  pos = 0;
+  
+  if ( len == 0 ) { ::close( fd ); return true; } 
+  
+  void * p = mmap( NULL , len , PROT_READ , MAP_PRIVATE , fd , 0 );
+
+  if ( p != MAP_FAILED )
+    {
+      madvise( p , len , MADV_SEQUENTIAL );
+      data = (const char*)p;
+      mapped = true;
+    }
+  else
+    {
+      // fall back to a plain read
+      buffer.resize( len );
+      size_t r = 0;
+      while ( r < len )
+	{
+	  ssize_t n = ::read( fd , &buffer[r] , len - r );
+	  if ( n <= 0 ) break;
+	  r += n;
+	}
+      len = r;
+      data = len ? &buffer[0] : NULL;
+    }
+
+  ::close( fd );
+  return true;
+}
+
+#endif
+
+
+void mapped_file_t::close()
+{
+#ifndef WINDOWS
+  if ( mapped ) munmap( (void*)data , len );
+#endif
+  mapped = false;
+  buffer.clear();
+  data = NULL;
+  len = pos = 0;
+}
+
+
+void mapped_file_t::touch() const
+{
+  volatile char c = 0;
+  for (size_t i=0; i<len; i+=4096) c += data[i];
+}
+
+
+bool mapped_file_t::getline( const char ** p , size_t * n )
+{
+  if ( pos >= len ) return false;
+
+  const size_t p0 = pos;
+  while ( pos < len && data[pos] != '\n' && data[pos] != '\r' ) ++pos;
+
+  *p = data + p0;
+  *n = pos - p0;
+  
+  // skip line ending (\n, \r or \r\n)
+  if ( pos < len )
+    {
+      if ( data[pos] == '\r' && pos + 1 < len && data[pos+1] == '\n' ) ++pos;
+      ++pos;
+    }
+
+  return true;
+}
+
+
+bool mapped_file_t::getline( std::string & line )
+{
+  const char * p;
+  size_t n;
+  if ( ! getline( &p , &n ) ) { line.clear(); return false; }
+  line.assign( p , n );
+  return true;
+}
@@ -0,0 +1,74 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_MAPPED_H__
+#define __LUNA_MAPPED_H__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// read-only view of an entire (text) file, memory-mapped where possible
+// (otherwise, and always under WINDOWS, read into a buffer); getline()
+// matches Helper::safe_getline(), i.e. \n, \r\n or \r line endings; as
+// there, a non-empty final line without a terminator is still returned
+
+struct mapped_file_t
+{
+
+  mapped_file_t() : data(NULL) , len(0) , pos(0) , mapped(false) { } 
+
+  ~mapped_file_t() { close(); }
+  
+  // nb. does not halt (can be called from worker threads)
+  bool open( const std::string & f );
+
+  void close();
+
+  // fault in all pages now (i.e. read-ahead, e.g. from a worker thread)
+  void touch() const;
+
+  // next line as pointer/length (not terminated), or false at end of file
+  bool getline( const char ** p , size_t * n );
+  
+  // as above, into a reused string (no allocation once it has capacity)
+  bool getline( std::string & line );
+
+  void rewind() { pos = 0; }
+  
+  const char * data;
+  size_t len;
+  
+ private:
+
+  size_t pos;
+
+  bool mapped;
+
+  std::vector<char> buffer;
+
+  mapped_file_t( const mapped_file_t & );
+  mapped_file_t & operator=( const mapped_file_t & );
+  
+};
+
+#endif
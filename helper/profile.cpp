@@ -0,0 +1,190 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "helper/profile.h"
+#include "helper/helper.h"
+#include "defs/defs.h"
+#include "db/db.h"
+
+#ifndef WINDOWS
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+
+extern writer_t writer;
+
+uint64_t profiler_t::records_read = 0;
+
+static std::string escape( const std::string & s )
+{
+  std::string r;
+  for (int i=0; i<s.size(); i++)
+    {
+      if ( s[i] == '"' || s[i] == '\\' ) r += '\\';
+      r += s[i];
+    }
+  return r;
+}
+
+
+double profiler_t::now()
+{
+  // usec, relative to the first call
+  static const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double,std::micro>( std::chrono::steady_clock::now() - t0 ).count();
+}
+
+void profiler_t::usage( double * cpu , double * rss )
+{
+#ifdef WINDOWS
+  // no getrusage(): CPU and RSS are reported as NA
+  *cpu = *rss = 0;
+#else
+  struct rusage ru;
+  getrusage( RUSAGE_SELF , &ru );
+  
+  *cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+    + ( ru.ru_utime.tv_usec + ru.ru_stime.tv_usec ) / 1e6;
+
+  // ru_maxrss is in bytes on macOS, KB on Linux
+#ifdef __APPLE__
+  *rss = ru.ru_maxrss / ( 1024.0 * 1024.0 );
+#else
+  *rss = ru.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+
+void profiler_t::start( const std::string & cmd , const int n )
+{
+  cmd_profile_t p;
+  p.cmd = cmd;
+  p.n = n;
+  cmds.push_back( p );
+
+  usage( &cpu0 , &rss0 );
+  recs0 = records_read;
+  nout0 = writer.nvalues;
+  bout0 = writer.nbytes;
+  wall0 = now();
+}
+
+
+void profiler_t::stop()
+{
+  if ( cmds.size() == 0 ) return;
+
+  const double wall1 = now();
+  double cpu1, rss1;
+  usage( &cpu1 , &rss1 );
+  
+  cmd_profile_t & p = cmds.back();
+  p.ts = wall0;
+  p.wall = ( wall1 - wall0 ) / 1e6;
+  p.cpu = cpu1 - cpu0;
+  p.rss = rss1;
+  p.drss = rss1 - rss0;
+  p.nrecs = records_read - recs0;
+  p.nout = writer.nvalues - nout0;
+  p.bout = writer.nbytes - bout0;
+}
+
+
+void profiler_t::report( const std::string & id , const int cmdn )
+{
+  
+  if ( cmds.size() == 0 ) return;
+
+  writer.cmd( "PROF" , cmdn , "" );
+  writer.level( "PROF" , "_PROF" );
+
+  for (int i=0; i<cmds.size(); i++)
+    {
+      const cmd_profile_t & p = cmds[i];
+
+      writer.level( p.n , "CMD" );
+      writer.value( "NAME" , p.cmd );
+      writer.value( "WALL" , p.wall );
+#ifdef WINDOWS
+      writer.missing_value( "CPU" );
+      writer.missing_value( "RSS" );
+      writer.missing_value( "DRSS" );
+#else
+      writer.value( "CPU" , p.cpu );
+      writer.value( "RSS" , p.rss );
+      writer.value( "DRSS" , p.drss );
+#endif
+      writer.value( "NREC" , (int)p.nrecs );
+      writer.value( "NOUT" , (int)p.nout );
+      writer.value( "BOUT" , (double)p.bout );
+
+      if ( globals::profile_trace != "" )
+	trace( id , p );
+    }
+
+  writer.unlevel( "CMD" );
+  writer.unlevel( "_PROF" );
+  
+  cmds.clear();
+}
+
+
+void profiler_t::trace( const std::string & id , const cmd_profile_t & p )
+{
+
+  // Chrome/Perfetto 'JSON array' trace format: one complete ('X') event
+  // per command; the closing ']' is optional, so events can simply be
+  // appended as each individual completes
+  
+  static bool started = false;
+
+  std::ofstream TRACE( globals::profile_trace.c_str() ,
+		       started ? std::ios_base::app : std::ios_base::out );
+
+  if ( ! TRACE.good() )
+    Helper::halt( "could not open " + globals::profile_trace );
+  
+  TRACE << ( started ? ",\n" : "[\n" ) 
+	<< "{\"name\":\"" << p.cmd << "\",\"cat\":\"luna\",\"ph\":\"X\""
+	<< ",\"ts\":" << (uint64_t)p.ts
+	<< ",\"dur\":" << (uint64_t)( p.wall * 1e6 )
+	<< ",\"pid\":" << getpid() << ",\"tid\":1"
+	<< ",\"args\":{\"id\":\"" << escape( id ) << "\""
+	<< ",\"n\":" << p.n
+#ifndef WINDOWS
+	<< ",\"cpu\":" << p.cpu
+	<< ",\"rss\":" << p.rss
+	<< ",\"drss\":" << p.drss
+#endif
+	<< ",\"nrec\":" << p.nrecs
+	<< ",\"nout\":" << p.nout
+	<< ",\"bout\":" << p.bout
+	<< "}}";
+
+  TRACE.close();
+  
+  started = true;
+}
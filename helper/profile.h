@@ -0,0 +1,81 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_PROFILE_H__
+#define __LUNA_PROFILE_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// per-command profile: wall & CPU time, peak resident memory, EDF
+// records read and values sent to the writer, accumulated by
+// cmd_t::eval() (given profile=T) and reported as the PROF table
+
+struct cmd_profile_t
+{
+  std::string cmd;
+  int n;
+
+  double ts;       // start (usec, since first profiled command)
+  double wall;     // elapsed (sec)
+  double cpu;      // user + system (sec), all threads
+  double rss;      // peak RSS at end (MB)
+  double drss;     // increase in peak RSS (MB)
+  uint64_t nrecs;  // EDF records read from disk
+  uint64_t nout;   // values written
+  uint64_t bout;   // bytes of (variable + value) payload written
+};
+
+
+struct profiler_t
+{
+
+  // incremented by edf_record_t::read()
+  static uint64_t records_read;
+  
+  void start( const std::string & cmd , const int n );
+
+  void stop();
+
+  // write PROF table (via writer) and, optionally, append to the trace file
+  void report( const std::string & id , const int cmdn );
+
+  void clear() { cmds.clear(); }
+  
+private:
+
+  std::vector<cmd_profile_t> cmds;
+
+  // state of the command currently being profiled
+  double wall0, cpu0, rss0;
+  uint64_t recs0, nout0, bout0;
+
+  static void usage( double * cpu , double * rss );
+
+  static double now();
+
+  static void trace( const std::string & id , const cmd_profile_t & p );
+  
+};
+
+#endif
@@ -0,0 +1,101 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#include "helper/threads.h"
+#include "helper/helper.h"
+#include "defs/defs.h"
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+
+int Helper::nthreads( const int njobs )
+{
+  int nt = globals::nthreads < 1 ? 1 : globals::nthreads ;
+  if ( nt > njobs ) nt = njobs;
+  return nt < 1 ? 1 : nt ;
+}
+
+void Helper::parallel_for( const int n , const std::function<void(int)> & f , int nt )
+{
+
+  if ( n <= 0 ) return;
+
+  if ( nt < 1 ) nt = Helper::nthreads( n );
+  if ( nt > n ) nt = n;
+
+  //
+  // single-threaded: just run in order, on the calling thread
+  //
+  
+  if ( nt == 1 )
+    {
+      try
+	{
+	  for (int i=0; i<n; i++) f( i );
+	}
+      catch ( const std::exception & e )
+	{
+	  Helper::halt( e.what() );
+	}
+      return;
+    }
+
+  //
+  // otherwise, workers pull the next job index from a shared counter
+  //
+  
+  std::atomic<int> next( 0 );
+  std::atomic<bool> failed( false );
+  std::string errmsg;
+  std::mutex errlock;
+  
+  std::vector<std::thread> workers;
+  workers.reserve( nt );
+  
+  for (int t=0; t<nt; t++)
+    workers.push_back( std::thread( [&]() {
+	  while ( ! failed ) 
+	    {
+	      const int i = next++;
+	      if ( i >= n ) break;
+	      try
+		{
+		  f( i );
+		}
+	      catch ( const std::exception & e )
+		{
+		  std::lock_guard<std::mutex> lock( errlock );
+		  if ( ! failed ) errmsg = e.what();
+		  failed = true;
+		}
+	    }
+	} ) );
+  
+  for (int t=0; t<nt; t++)
+    workers[t].join();
+
+  if ( failed ) Helper::halt( errmsg );
+
+}
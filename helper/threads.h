@@ -0,0 +1,46 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_THREADS_H__
+#define __LUNA_THREADS_H__
+
+#include <functional>
+
+namespace Helper
+{
+
+  // number of worker threads to use for 'njobs' independent jobs,
+  // i.e. globals::nthreads (nthreads=N) but never more than njobs
+  
+  int nthreads( const int njobs );
+  
+  // run f(0) ... f(n-1) over up to nt threads (default, per nthreads() above);
+  // jobs are handed out in order from a shared counter, so f() must only
+  // write to its own slot of any output.  f() should not call halt(),
+  // logger or writer: instead throw a std::exception, and the (first)
+  // message will be passed to halt() once all workers have joined
+  
+  void parallel_for( const int n , const std::function<void(int)> & f , int nt = 0 );
+
+}
+
+#endif
@@ -39,7 +39,7 @@ std::map<std::string,int> Token::fn_map;
 
 void Eval::init( bool na )
 {
-  is_valid = false;
+  is_valid = parsed_valid = false;
   
   no_assignments = na;
 
@@ -960,6 +960,8 @@ bool Eval::parse( const std::string & input )
   // set pointers to all variables now construction of tokens is complete
   for (int i=0; i<etok.size(); i++)  
     locate_symbols( output[i] ); 
+
+  parsed_valid = is_valid;
   
   return is_valid;
 
@@ -979,7 +981,12 @@ void Eval::bind( const std::map<std::string,annot_map_t> & inputs ,
 {
 
   
-  if ( reset ) reset_symbols();  
+  if ( reset ) 
+    {
+      reset_symbols();  
+      // i.e. if re-using a parsed expression, clear any prior evaluation errors
+      is_valid = parsed_valid;
+    }
   
   //
   // Input: bind information from inputs and also from accumulator 
@@ -1454,6 +1461,30 @@ void Eval::delete_symbols()
 }
 
 
+std::vector<std::string> Eval::referenced( const std::vector<std::string> & annots ) const
+{
+  // variable names as made in bind(): annot, annot_sec and annot.meta
+  std::vector<std::string> r;
+  for (int a=0; a<annots.size(); a++)
+    {
+      const std::string & name = annots[a];
+      std::map<std::string,std::set<Token*> >::const_iterator ii = vartb.begin();
+      while ( ii != vartb.end() )
+	{
+	  const std::string & v = ii->first;
+	  if ( v == name || v == name + "_sec" 
+	       || ( v.size() > name.size() && v[ name.size() ] == '.' && v.compare( 0 , name.size() , name ) == 0 ) )
+	    {
+	      r.push_back( name );
+	      break;
+	    }
+	  ++ii;
+	}
+    }
+  return r;
+}
+
+
 bool Eval::expand_vargs( std::string * s )
 {
   // change vec(22,23,24) to vec(22,23,24,3)
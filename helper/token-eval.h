@@ -104,6 +104,10 @@ struct Eval {
   Token::tok_type rtype() const;
   Token value() const;
 
+  // of these annotation classes, which are referenced by the (parsed)
+  // expression, i.e. as 'A', 'A_sec' or 'A.var' in bind() below?
+  std::vector<std::string> referenced( const std::vector<std::string> & annots ) const;
+  
   // get symbol table
   std::set<std::string> symbols() const
   {
@@ -135,6 +139,10 @@ struct Eval {
   
   // keep track of state (errors?)
   bool is_valid;
+
+  // state after parse(), restored by each (resetting) bind(), so that a
+  // single parsed Eval can be bound and evaluated repeatedly
+  bool parsed_valid;
   std::string errs;
   
   // slot for final expression value
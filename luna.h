@@ -36,6 +36,7 @@
 #include "helper/token-eval.h"
 #include "helper/token.h"
 #include "helper/logger.h"
+#include "helper/profile.h"
 #include "helper/xml-parser.h"
 #include "helper/json.h"
 #include "helper/mapper.h"
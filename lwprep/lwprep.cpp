@@ -57,6 +57,7 @@ extern logger_t logger;
 //   stage-summary.db        from 'HYPNO' ; baseline and cycle level only 
 //   psd-epoch.db            assumes 0.5 hz bins (0.5 .. 20Hz)
 //   psd-band-epoch.db       log(abs) band power per epoch
+//                           (both also as packed epoch arrays, per channel)
 //   mask.db
 
 //   Annotations
@@ -299,10 +300,14 @@ lw_prep_t::lw_prep_t( edf_t & edf , param_t & param )
 
   sstore_t psd_spec( folder + "/psd-epoch-spec.db" );
 
+  psd_spec.begin();
+
   insert_psd_spec( ret , edf.id , &psd_spec );
   
   psd_spec.index();  
 
+  psd_spec.commit();
+
   psd_spec.dettach();
   
 
@@ -595,6 +600,9 @@ void  lw_prep_t::insert_psd_band( retval_t & ret ,
   // insert as CH x STAGE only
 
   std::map<std::string,std::map<std::string,std::vector<double> > > pows;
+
+  // as above, also as (packed) epoch arrays, one per CH x B
+  std::map<std::string,std::map<std::string,std::map<int,std::vector<double> > > > arrays;
   
   while ( ii != dat1.end() )
     {
@@ -623,6 +631,7 @@ void  lw_prep_t::insert_psd_band( retval_t & ret ,
 		  pows[ channel_lvl.str_level ][ band_lvl.str_level ].push_back( log( jj->second.d )  );
 		  // insert at epoch level 
 		  ss->insert_epoch( e , "PSD" , log( jj->second.d ) , &(channel_lvl.str_level) , &(band_lvl.str_level) );
+		  arrays[ channel_lvl.str_level ][ band_lvl.str_level ][ e ].assign( 1 , log( jj->second.d ) );
 		}
 	    }      
 	}
@@ -649,6 +658,7 @@ void  lw_prep_t::insert_psd_band( retval_t & ret ,
 	    dsptools::TV1D_denoise( kk->second , lambda );
 
 	  ss->insert_base( "PSD" , kk->second , &(jj->first) , &(kk->first) );
+	  ss->insert_epoch_array( "PSD" , arrays[ jj->first ][ kk->first ] , &(jj->first) , &(kk->first) );
 	  ++cnt;
 	  ++kk;
 	}
@@ -713,6 +723,10 @@ void  lw_prep_t::insert_psd_spec( retval_t & ret ,
   
   int cnt = 0;
 
+  // also collate by channel, to insert as (packed) epoch arrays, i.e. so
+  // that a range of epochs can be fetched in a single read
+  std::map<std::string,std::map<int,std::vector<double> > > arrays;
+  
   std::map<int,std::map<std::string,std::vector<double> > >::const_iterator ee = psds.begin();
   while ( ee != psds.end() )
     {
@@ -721,13 +735,21 @@ void  lw_prep_t::insert_psd_spec( retval_t & ret ,
 	{
 	  //	  std::cout << ee->first << "\t" << jj->second.size() << " " << jj->first << "\n";
 	  ss->insert_epoch( ee->first  , "PSD" , jj->second , &(jj->first) , NULL );
+	  arrays[ jj->first ][ ee->first ] = jj->second;
 	  ++jj;
 	  ++cnt;
 	}
       ++ee;            
     }
 
-  logger << " ... inserted " << cnt << " PSDs\n";
+  std::map<std::string,std::map<int,std::vector<double> > >::const_iterator aa = arrays.begin();
+  while ( aa != arrays.end() )
+    {
+      ss->insert_epoch_array( "PSD" , aa->second , &(aa->first) , NULL );
+      ++aa;
+    }
+  
+  logger << " ... inserted " << cnt << " PSDs (and " << arrays.size() << " epoch arrays)\n";
 }
 
 
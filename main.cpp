@@ -28,6 +28,17 @@
 
 #include "utils/cgi-utils.h"
 
+#ifndef WINDOWS
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+
 extern globals global;
 
 extern writer_t writer;
@@ -307,6 +318,12 @@ int main(int argc , char ** argv )
   bool cmdline_proc_cperm_test   = false;
   bool cmdline_proc_lgbm         = false;
   bool cmdline_proc_pops         = false;
+  bool cmdline_proc_serve        = false;
+
+  // --serve mode: socket path and number of concurrent workers
+  std::string serve_socket = "";
+  int serve_workers = 1;
+  
     
   //
   // parse command line
@@ -355,6 +372,8 @@ int main(int argc , char ** argv )
 	    cmdline_proc_lgbm = true;
 	  else if ( strcmp( argv[1] , "--pops" ) == 0 )
 	    cmdline_proc_pops = true;
+	  else if ( strcmp( argv[1] , "--serve" ) == 0 )
+	    cmdline_proc_serve = true;
 	}
       
       // otherwise, first element will be treated as a file list
@@ -378,8 +397,24 @@ int main(int argc , char ** argv )
       // var=value
       
       int specified = 0;
+
+      int first_arg = 2;
       
-      for (int i=2;i<argc;i++)
+      // luna --serve socket-path {n-workers} ... 
+      
+      if ( cmdline_proc_serve )
+	{
+	  if ( argc < 3 ) Helper::halt( "expecting socket path after --serve" );
+	  serve_socket = argv[2];
+	  first_arg = 3;
+	  if ( argc > 3 && Helper::str2int( argv[3] , &serve_workers ) ) 
+	    {
+	      if ( serve_workers < 1 ) Helper::halt( "expecting 1 or more workers for --serve" );
+	      first_arg = 4;
+	    }
+	}
+      
+      for (int i=first_arg;i<argc;i++)
 	{
 	  
 	  std::vector<std::string> tok = 
@@ -412,6 +447,16 @@ int main(int argc , char ** argv )
 	      cmd_t::plaintext_root = argv[ ++i ];
 	      cmd_t::plaintext_mode = true;
 	    }
+
+	  // columnar binary tables (read with destrat)
+
+	  else if ( Helper::iequals( tok[0] , "-b" ) )
+	    {
+	      // next arg will be root (folder) for .lcol tables
+	      if ( i + 1 >= argc ) Helper::halt( "expecting folder name after -b" );
+	      cmd_t::plaintext_root = argv[ ++i ];
+	      cmd_t::colstore_mode = true;
+	    }
 	  
 	  // luna-script from command line
 	  
@@ -593,6 +638,11 @@ int main(int argc , char ** argv )
     {
       writer.use_plaintext( cmd_t::plaintext_root );
     }
+  // columnar binary tables?
+  else if ( cmd_t::colstore_mode )
+    {
+      writer.use_colstore( cmd_t::plaintext_root );
+    }
   // was an output db specified?
   else if ( cmd_t::stout_file != "" )
     {
@@ -1239,6 +1289,26 @@ int main(int argc , char ** argv )
   
   
   
+  //
+  // resident server: load the script (and any POPS/SUDS models) once, 
+  // then process jobs received over a Unix socket
+  //
+
+  if ( cmdline_proc_serve )
+    {
+      if ( cmd_t::stout_file != "" || cmd_t::plaintext_mode || cmd_t::colstore_mode )
+	Helper::halt( "cannot specify -o, -a, -t or -b with --serve (output returned per job)" );
+      
+      cmd_t cmd;
+      
+      if ( cmd.empty() || ! cmd.valid() )
+	Helper::halt( "no valid command script for --serve" );
+      
+      proc_serve( cmd , serve_socket , serve_workers );
+      std::exit(0);
+    }
+  
+  
   //
   // iterate through the primary sample-list
   //
@@ -1531,6 +1601,8 @@ void process_edfs( cmd_t & cmd )
 
 	  if ( cmd_t::plaintext_mode ) Helper::halt( "cannot specify -t and have ^ wild card" );
 
+	  if ( cmd_t::colstore_mode ) Helper::halt( "cannot specify -b and have ^ wild card" );
+
 	  cmd_t::stout_file = cmd_t::resolved_outdb( rootname , cmd_t::stout_template );
 
 	  // if not append-mode, first wipe it
@@ -1675,6 +1747,7 @@ void process_edfs( cmd_t & cmd )
 		  struct dirent *ent;
 		  if ( (dir = opendir ( fname.c_str() ) ) != NULL )
 		    {
+		      std::vector<std::string> afiles;
 		      /* print all the files and directories within directory */
 		      while ((ent = readdir (dir)) != NULL)
 			{
@@ -1687,10 +1760,15 @@ void process_edfs( cmd_t & cmd )
 			       Helper::file_extension( fname2 , "stages" ) ||
 			       Helper::file_extension( fname2 , "eannot" ) )   
 			    {
-			      edf.load_annotations( fname + fname2 );	 			   
+			      afiles.push_back( fname + fname2 );
 			    }
 			}
 		      closedir (dir);
+
+		      // read all files in parallel, then attach (in order)
+		      annot_t::prefetch( afiles );
+		      for (int a=0; a<afiles.size(); a++)
+			edf.load_annotations( afiles[a] );
 		    }
 		  else 
 		    Helper::halt( "could not open folder " + fname );
@@ -1937,6 +2015,253 @@ void process_edfs( cmd_t & cmd )
 }
 
 
+//
+// Resident server (luna --serve socket {n-workers} -s script)
+//
+
+// Models attached by POPS or SUDS commands in the script are read once,
+// in the parent; each job is then run by a forked worker (which shares
+// those models, copy-on-write).  A job is a single line, written to the
+// socket: tab-delimited fields, either as a sample-list row (ID, EDF,
+// optional annotations) or key=value variables for that job only.  The
+// standard (text) output for that job is written back to the socket,
+// which is then closed.
+
+#ifndef WINDOWS
+
+// self-pipe: the SIGCHLD handler writes a byte, which wakes up the
+// poll() in proc_serve(), which then reaps finished workers; unlike
+// relying on accept() returning EINTR, an exit just before poll() is
+// called is not missed
+
+static int serve_pipe[2] = { -1 , -1 };
+
+static void serve_sigchld( int )
+{
+  const int e = errno;
+  const char c = 0;
+  if ( write( serve_pipe[1] , &c , 1 ) < 0 ) { } 
+  errno = e;
+}
+
+// per-job sample-lists are written to a private folder (made by
+// mkdtemp() in proc_serve()), not to a predictable path in /tmp
+
+static std::string serve_dir;
+
+static std::string serve_job_file( const pid_t pid )
+{
+  return serve_dir + globals::folder_delimiter + Helper::int2str( (int)pid ) + ".lst";
+}
+
+static void serve_job( cmd_t & cmd , const int conn )
+{
+
+  // read the job request (up to a newline)
+  std::string line;
+  char c;
+  while ( read( conn , &c , 1 ) == 1 && c != '\n' ) line += c;
+  if ( line.size() && line[ line.size() - 1 ] == '\r' ) line.resize( line.size() - 1 );
+  
+  // all text output goes back to the client
+  if ( dup2( conn , STDOUT_FILENO ) < 0 )
+    Helper::halt( "problem attaching job connection" );
+  close( conn );
+
+  std::vector<std::string> tok = Helper::parse( line , "\t" );
+  std::vector<std::string> row;
+  for (int i=0; i<tok.size(); i++)
+    {
+      std::vector<std::string> kv = Helper::quoted_parse( tok[i] , "=" );
+      if ( kv.size() == 2 ) cmd_t::parse_special( kv[0] , kv[1] );
+      else row.push_back( tok[i] );
+    }
+  
+  if ( row.size() < 2 )
+    Helper::halt( "bad --serve job, requires (ID) | EDF file | (optional ANNOT files)" );
+  
+  // one-line sample-list for this job
+  const std::string slist = serve_job_file( getpid() );
+  std::ofstream O1( slist.c_str() , std::ios::out );
+  for (int i=0; i<row.size(); i++)
+    O1 << ( i ? "\t" : "" ) << row[i];
+  O1 << "\n";
+  O1.close();
+
+  cmd_t::input = slist;
+  
+  process_edfs( cmd );
+
+  Helper::deleteFile( slist );
+
+  std::cout.flush();
+
+  std::exit( globals::retcode );
+}
+
+#endif
+
+void proc_serve( cmd_t & cmd , const std::string & sockname , const int workers )
+{
+
+#ifdef WINDOWS
+  Helper::halt( "--serve not supported on Windows" );
+#else
+
+  //
+  // attach any models up front (unless they depend on the individual ID)
+  //
+
+  //  nb. commands using variables (which may be set per job) are
+  //  skipped here, and so will load their models in each job
+  
+  cmd_t pre = cmd;
+  pre.literal_commands();
+  
+  for (int c=0; c<pre.num_cmds(); c++)
+    {
+      if ( pre.is( c , "POPS" ) )
+	proc_pops_preload( pre.param(c) );
+      else if ( pre.is( c , "SUDS" ) && ! pre.param(c).has( "clear" ) )
+	proc_suds_preload( pre.param(c) );
+    }
+
+  
+  //
+  // private (0700) folder for the per-job sample-lists
+  //
+
+  std::string dtemplate = std::string( P_tmpdir ) + globals::folder_delimiter + "luna-serve-XXXXXX";
+  std::vector<char> dbuf( dtemplate.begin() , dtemplate.end() );
+  dbuf.push_back( '\0' );
+  if ( mkdtemp( &dbuf[0] ) == NULL )
+    Helper::halt( "could not create a temporary folder for --serve jobs" );
+  serve_dir = &dbuf[0];
+
+  
+  //
+  // set up socket
+  //
+
+  struct sockaddr_un addr;
+  if ( sockname.size() >= sizeof( addr.sun_path ) )
+    Helper::halt( "socket path too long: " + sockname );
+  
+  memset( &addr , 0 , sizeof( addr ) );
+  addr.sun_family = AF_UNIX;
+  strncpy( addr.sun_path , sockname.c_str() , sizeof( addr.sun_path ) - 1 );
+
+  int sock = socket( AF_UNIX , SOCK_STREAM , 0 );
+  if ( sock < 0 ) Helper::halt( "could not create socket" );
+
+  // remove any stale socket
+  unlink( sockname.c_str() );
+
+  // jobs can set arbitrary variables, so only this user may connect:
+  // create the socket owner-only (rather than chmod() after binding)
+  const mode_t umask0 = umask( 0077 );
+  const int bound = bind( sock , (struct sockaddr*)&addr , sizeof( addr ) );
+  umask( umask0 );
+  
+  if ( bound < 0 ) 
+    Helper::halt( "could not bind to " + sockname );
+
+  if ( chmod( sockname.c_str() , S_IRUSR | S_IWUSR ) < 0 )
+    Helper::halt( "could not set permissions on " + sockname );
+
+  if ( listen( sock , 64 ) < 0 )
+    Helper::halt( "could not listen on " + sockname );
+
+  logger << "  serving on " << sockname << " with " << workers << " worker(s)\n";
+
+  
+  //
+  // accept jobs
+  //
+
+  if ( pipe( serve_pipe ) < 0 )
+    Helper::halt( "could not create pipe" );
+  for (int i=0; i<2; i++)
+    fcntl( serve_pipe[i] , F_SETFL , fcntl( serve_pipe[i] , F_GETFL ) | O_NONBLOCK );
+  
+  struct sigaction sa;
+  memset( &sa , 0 , sizeof( sa ) );
+  sa.sa_handler = serve_sigchld;
+  sigemptyset( &sa.sa_mask );
+  sa.sa_flags = SA_NOCLDSTOP | SA_RESTART;
+  if ( sigaction( SIGCHLD , &sa , NULL ) < 0 )
+    Helper::halt( "could not install SIGCHLD handler" );
+  
+  int running = 0;
+  int jobs = 0;
+  
+  while ( true )
+    {
+
+      // reap finished workers; block if all are busy
+      while ( running > 0 )
+	{
+	  int status;
+	  pid_t pid = waitpid( -1 , &status , running >= workers ? 0 : WNOHANG );
+	  if ( pid <= 0 ) break;
+	  --running;
+	  unlink( serve_job_file( pid ).c_str() );
+	}
+
+      // wait for either a new job or a finished worker
+      struct pollfd pfd[2];
+      pfd[0].fd = sock;
+      pfd[0].events = POLLIN;
+      pfd[1].fd = serve_pipe[0];
+      pfd[1].events = POLLIN;
+      
+      if ( poll( pfd , 2 , -1 ) < 0 )
+	{
+	  if ( errno == EINTR ) continue;
+	  Helper::halt( "problem waiting for connections on " + sockname );
+	}
+
+      if ( pfd[1].revents & POLLIN )
+	{
+	  char buf[64];
+	  while ( read( serve_pipe[0] , buf , sizeof( buf ) ) > 0 ) { } 
+	}
+      
+      if ( ! ( pfd[0].revents & POLLIN ) ) continue;
+      
+      int conn = accept( sock , NULL , NULL );
+      if ( conn < 0 ) 
+	{
+	  if ( errno == EINTR ) continue;
+	  Helper::halt( "problem accepting connection on " + sockname );
+	}
+
+      std::cout.flush();
+      
+      pid_t pid = fork();
+
+      if ( pid < 0 ) 
+	Helper::halt( "could not fork worker" );
+
+      if ( pid == 0 ) 
+	{
+	  signal( SIGCHLD , SIG_DFL );
+	  close( serve_pipe[0] );
+	  close( serve_pipe[1] );
+	  close( sock );
+	  serve_job( cmd , conn );
+	}
+      
+      close( conn );
+      ++running;
+      ++jobs;
+      logger << "  job " << jobs << " started (pid " << pid << ")\n";
+    }
+  
+#endif
+}
+
+
 
 // EVAL expresions
 
@@ -39,6 +39,7 @@ void NoMem();
 void proc_dummy( const std::string & , const std::string & p2 );
 void proc_eval_tester( const bool );
 void process_edfs(cmd_t&);
+void proc_serve(cmd_t&, const std::string & , const int );
 void list_cmds();
 
 void build_param_from_cmdline( param_t * );
@@ -46,6 +46,22 @@ long int MiscMath::nextpow2( const int a )
   return 0;
 }
 
+long int MiscMath::nextsmooth( const int a )
+{
+  // smallest n >= a with no prime factors other than 2, 3, 5 and 7,
+  // i.e. cheap FFT sizes (typically within a few % of a)
+  for (long int t = a < 1 ? 1 : a ; ; t++)
+    {
+      long int r = t;
+      while ( r % 2 == 0 ) r /= 2;
+      while ( r % 3 == 0 ) r /= 3;
+      while ( r % 5 == 0 ) r /= 5;
+      while ( r % 7 == 0 ) r /= 7;
+      if ( r == 1 ) return t;
+    }
+  return 0;
+}
+
 
 //
 // logspace function
@@ -1728,6 +1744,114 @@ double MiscMath::betacf(const double a, const double b, const double x)
 
 
 
+// fused SIGSTATS kernel (centres x in place)
+void MiscMath::sigstats( double * x , const int n , sigstats_t * r ,
+			 const bool calc_clipped , const bool calc_flat , const double flat_eps ,
+			 const bool calc_maxxed , const double max_value , const bool calc_pfd )
+{
+
+  r->clipped = r->flat = r->maxxed = r->rms = r->pfd = 0;
+  r->activity = r->mobility = r->complexity = 0;
+
+  if ( n == 0 ) return;
+  
+  //
+  // pass 1: raw data -- sum, range (as clipped(), from 0), flat and max counts
+  //
+
+  double s = 0 , mn = 0 , mx = 0;
+  int cflat = 0 , cmax = 0;
+  
+  for (int i=0; i<n; i++)
+    {
+      const double xi = x[i];
+      s += xi;
+      mx = xi > mx ? xi : mx;
+      mn = xi < mn ? xi : mn;
+      cmax += fabs( xi ) > max_value ;
+      if ( i ) cflat += fabs( xi - x[i-1] ) < flat_eps ;
+    }
+
+  const double mean = s / (double)n;
+
+  //
+  // pass 2: clipped counts (raw), then centre in place and accumulate
+  // sums of squares of x, and first/second differences (Hjorth), and
+  // sign changes of the first difference (PFD)
+  //
+
+  const double rng = mx - mn;
+  const double tol = rng * 0.0001;
+  
+  int cclip = 0 , n_delta = 0;
+
+  double sx2 = 0 , sdx2 = 0 , sddx2 = 0;
+  double prev = 0 , dprev = 0;
+  bool bprev = false;
+  
+  for (int i=0; i<n; i++)
+    {
+      const double xi = x[i];
+      cclip += ( fabs( xi - mx ) < tol ) + ( fabs( xi - mn ) < tol );
+      
+      const double y = xi - mean;
+      x[i] = y;
+      sx2 += y * y;
+      
+      if ( i )
+	{
+	  const double dy = y - prev;
+	  sdx2 += dy * dy;
+	  const bool b = dy > 0;
+	  if ( i > 1 )
+	    {
+	      const double ddy = dy - dprev;
+	      sddx2 += ddy * ddy;
+	      n_delta += b != bprev;
+	    }
+	  dprev = dy;
+	  bprev = b;
+	}
+      prev = y;
+    }
+
+  if ( calc_clipped )
+    {
+      if ( rng < 1e-12 ) r->clipped = 1.0;
+      else
+	{
+	  cclip -= 2;
+	  if ( cclip < 0 ) cclip = 0;
+	  r->clipped = cclip / (double)(n-2);
+	}
+    }
+  
+  if ( calc_flat ) r->flat = cflat / (double)(n-1);
+
+  if ( calc_maxxed ) r->maxxed = cmax / (double)n;
+  
+  r->rms = sqrt( sx2 / (double)n );
+
+  if ( calc_pfd && n >= 3 )
+    r->pfd = log10(n) / ( log10(n) + log10( n / (double)( n + 0.4 * n_delta ) ) ) ;
+  
+  // Hjorth, as hjorth()
+  const double mx2 = sx2 / (double)n;
+  const double mdx2 = n > 1 ? sdx2 / (double)(n-1) : 0 ;
+  const double mddx2 = n > 2 ? sddx2 / (double)(n-2) : 0 ;
+
+  r->activity = mx2;
+  double mobility = mdx2 / mx2;
+  r->complexity = sqrt( mddx2 / mdx2 - mobility );
+  r->mobility = sqrt( mobility );
+
+  if ( ! Helper::realnum( r->activity ) ) r->activity = 0;
+  if ( ! Helper::realnum( r->mobility ) ) r->mobility = 0;
+  if ( ! Helper::realnum( r->complexity ) ) r->complexity = 0;
+  
+}
+
+
 // second-order Hjorth parameters (window, inc)
 void MiscMath::hjorth2( const std::vector<double> * x , double * r , int w , int inc )
 {
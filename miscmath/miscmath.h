@@ -37,6 +37,8 @@ namespace MiscMath
   
   // next pow2
   long int nextpow2( const int a );
+
+  long int nextsmooth( const int a );
   std::vector<double> logspace(double a, double b, int n);
   std::vector<double> linspace(double a, double b, int n);
   
@@ -192,6 +194,19 @@ namespace MiscMath
   // second-order Hjorth parameters (window, inc)
   void hjorth2( const std::vector<double> * , double * , int w , int inc = 0 );
 
+  // fused SIGSTATS kernel: clipped(), flat(), max(), centre(), rms(),
+  // petrosian_FD() and hjorth() in two passes and without temporaries;
+  // x is mean-centred in place, as by centre()
+  struct sigstats_t
+  {
+    double clipped, flat, maxxed, rms, pfd;
+    double activity, mobility, complexity;
+  };
+  
+  void sigstats( double * x , const int n , sigstats_t * r ,
+		 const bool calc_clipped , const bool calc_flat , const double flat_eps ,
+		 const bool calc_maxxed , const double max_value , const bool calc_pfd );
+
   // turning rate
   double turning_rate( const std::vector<double> * , int , int , int , std::vector<double> * sub );
 
@@ -25,6 +25,10 @@
 #include "pops/pops.h"
 #include "helper/helper.h"
 #include "helper/logger.h"
+#include "helper/mapped.h"
+
+#include <cstring>
+#include <stdint.h>
 
 extern logger_t logger;
 
@@ -49,79 +53,308 @@ void pops_indiv_t::save1( const std::string & id , const std::string & f )
 }
 
 
+// level-1 library: a 64-byte header, followed by 64-byte aligned blocks
+// (ID offsets + IDs, then E, S as int32 and X1 as column-major doubles),
+// such that X1 can be mapped directly from the file as an Eigen matrix
+
+static const char pops_lib_magic[8] = { 'P','O','P','S','L','I','B','\0' };
+
+static const uint32_t pops_lib_version = 1;
+
+struct pops_lib_header_t
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t n1;
+  uint64_t n_indiv;
+  uint64_t ne;
+  uint64_t off_id;
+  uint64_t off_E;
+  uint64_t off_S;
+  uint64_t off_X;
+};
+
+static uint64_t pops_lib_align( const uint64_t x )
+{
+  return ( x + 63 ) & ~((uint64_t)63);
+}
+
+// T if the block of n * sz bytes at off is (8-byte aligned and) inside
+// [lo,hi), written so as not to overflow for arbitrary header values
+
+static bool pops_lib_within( const uint64_t off , const uint64_t n , const uint64_t sz ,
+			     const uint64_t lo , const uint64_t hi )
+{
+  if ( off < lo || off > hi || off % 8 != 0 ) return false;
+  return sz == 0 || n <= ( hi - off ) / sz;
+}
+
+static void pops_lib_pad( std::ofstream & O , const uint64_t x )
+{
+  const uint64_t n = pops_lib_align( x ) - x;
+  if ( n == 0 ) return;
+  std::vector<char> z( n , 0 );
+  O.write( &z[0] , n );
+}
+
+
+void pops_t::save1lib( const std::string & f ) const
+{
+  
+  const uint64_t ne = X1.rows();
+  const uint64_t ni = Istart.size();
+  const uint32_t n1 = pops_t::specs.n1;
+  
+  if ( X1.cols() < n1 || S.size() != ne || E.size() != ne || Iend.size() != ni )
+    Helper::halt( "internal error in pops_t::save1lib()" );
+
+  // IDs: (ni+1) int64 offsets into a packed character block
+  std::vector<uint64_t> idx( ni + 1 , 0 );
+  std::string idblock;
+  for (int i=0; i<ni; i++)
+    {
+      idx[i] = idblock.size();
+      if ( i < ids.size() ) idblock += ids[i];
+    }
+  idx[ni] = idblock.size();
+
+  // start/stop epoch per individual (as int64)
+  std::vector<uint64_t> bounds( 2 * ni );
+  for (int i=0; i<ni; i++)
+    {
+      bounds[ 2*i ]     = Istart[i];
+      bounds[ 2*i + 1 ] = Iend[i];
+    }
+  
+  pops_lib_header_t hdr;
+  memcpy( hdr.magic , pops_lib_magic , 8 );
+  hdr.version = pops_lib_version;
+  hdr.n1      = n1;
+  hdr.n_indiv = ni;
+  hdr.ne      = ne;
+  hdr.off_id  = pops_lib_align( sizeof( pops_lib_header_t ) );
+  const uint64_t id_bytes = ( 3 * ni + 1 ) * sizeof(uint64_t) + idblock.size();
+  hdr.off_E   = pops_lib_align( hdr.off_id + id_bytes );
+  hdr.off_S   = pops_lib_align( hdr.off_E + ne * sizeof(int32_t) );
+  hdr.off_X   = pops_lib_align( hdr.off_S + ne * sizeof(int32_t) );
+  
+  std::ofstream OUT1( Helper::expand( f ).c_str() , std::ios::binary | std::ios::out );
+  if ( ! OUT1.good() )
+    Helper::halt( "could not open " + f );
+  
+  OUT1.write( (const char*)&hdr , sizeof( pops_lib_header_t ) );
+  pops_lib_pad( OUT1 , sizeof( pops_lib_header_t ) );
+
+  OUT1.write( (const char*)&bounds[0] , bounds.size() * sizeof(uint64_t) );
+  OUT1.write( (const char*)&idx[0] , idx.size() * sizeof(uint64_t) );
+  OUT1.write( idblock.data() , idblock.size() );
+  pops_lib_pad( OUT1 , hdr.off_id + id_bytes );
+  
+  std::vector<int32_t> buf( ne );
+  for (int i=0; i<ne; i++) buf[i] = E[i];
+  OUT1.write( (const char*)&buf[0] , ne * sizeof(int32_t) );
+  pops_lib_pad( OUT1 , hdr.off_E + ne * sizeof(int32_t) );
+
+  for (int i=0; i<ne; i++) buf[i] = S[i];
+  OUT1.write( (const char*)&buf[0] , ne * sizeof(int32_t) );
+  pops_lib_pad( OUT1 , hdr.off_S + ne * sizeof(int32_t) );
+
+  // column-major, i.e. as Eigen stores it
+  for (int j=0; j<n1; j++)
+    OUT1.write( (const char*)X1.col(j).data() , ne * sizeof(double) );
+  
+  if ( ! OUT1.good() )
+    Helper::halt( "problem writing " + f );
+  
+  OUT1.close();
+
+  logger << "  wrote level-1 library (" << ne << " epochs, "
+	 << ni << " individuals) to " << f << "\n";
+  
+}
+
+
 void pops_t::load1( const std::string & f )
 {
-  std::ifstream IN1( Helper::expand( f ).c_str() , std::ios::binary | std::ios::in );
 
+  mapped_file_t mf;
+  if ( ! mf.open( Helper::expand( f ) ) )
+    Helper::halt( "could not open " + f );
+
+  const char * p = mf.data;
+  const uint64_t len = mf.len;
+  
+  Istart.clear();
+  Iend.clear();
+  ids.clear();
+  
+  //
+  // library format: map directly
+  //
+
+  if ( len >= sizeof( pops_lib_header_t ) && memcmp( p , pops_lib_magic , 8 ) == 0 )
+    {
+      pops_lib_header_t hdr;
+      memcpy( &hdr , p , sizeof( pops_lib_header_t ) );
+
+      if ( hdr.version != pops_lib_version )
+	Helper::halt( f + " is a version " + Helper::int2str( (int)hdr.version )
+		      + " POPS library, expecting version " + Helper::int2str( (int)pops_lib_version ) );
+
+      if ( hdr.n1 != pops_t::specs.n1 )
+	Helper::halt( "data in " + f + " does not match feature-specification file" );
+
+      const uint64_t ne = hdr.ne;
+      const uint64_t ni = hdr.n_indiv;
+      
+      //
+      // validate all blocks before touching them: each must lie within
+      // the file, after the previous block (i.e. in the order written
+      // by save1lib(), and so not overlapping)
+      //
+
+      const std::string bad = f + " is truncated or not a valid POPS library";
+      
+      // (nb. epochs are indexed by int elsewhere)
+      if ( ni > len / ( 3 * sizeof(uint64_t) ) || ne > len / sizeof(int32_t) || ne > 2147483647 )
+	Helper::halt( bad );
+      
+      // bounds (2 x ni) and ID offsets (ni+1), then the ID characters
+      if ( ! pops_lib_within( hdr.off_id , 3 * ni + 1 , sizeof(uint64_t) , sizeof( pops_lib_header_t ) , len ) )
+	Helper::halt( bad );
+      const uint64_t id_end = hdr.off_id + ( 3 * ni + 1 ) * sizeof(uint64_t);
+      
+      if ( ! pops_lib_within( hdr.off_E , ne , sizeof(int32_t) , id_end , len ) )
+	Helper::halt( bad );
+
+      if ( ! pops_lib_within( hdr.off_S , ne , sizeof(int32_t) , hdr.off_E + ne * sizeof(int32_t) , len ) )
+	Helper::halt( bad );
+      
+      if ( ! pops_lib_within( hdr.off_X , ne , hdr.n1 * sizeof(double) , hdr.off_S + ne * sizeof(int32_t) , len ) )
+	Helper::halt( bad );
+      
+      const uint64_t * bounds = (const uint64_t*)( p + hdr.off_id );
+      const uint64_t * idx = bounds + 2 * ni;
+      const char * idblock = (const char*)( idx + ni + 1 );
+
+      // ID slices must be monotone and end before the E block
+      const uint64_t id_bytes = hdr.off_E - id_end;
+      if ( idx[0] != 0 || idx[ni] > id_bytes )
+	Helper::halt( bad );
+      for (uint64_t i=0; i<ni; i++)
+	if ( idx[i] > idx[i+1] ) Helper::halt( bad );
+      
+      logger << "  mapping " << ne << " epochs from " << ni << " individuals\n";
+      
+      Istart.resize( ni );
+      Iend.resize( ni );
+      ids.resize( ni );
+      // individuals must tile the epochs, in order: as level2() indexes
+      // X1 rows by these, check before accepting them
+      uint64_t next = 0;
+      for (int i=0; i<ni; i++)
+	{
+	  const uint64_t s1 = bounds[ 2*i ];
+	  const uint64_t s2 = bounds[ 2*i + 1 ];
+	  if ( s1 != next || s1 > s2 || s2 >= ne )
+	    Helper::halt( bad );
+	  next = s2 + 1;
+	  
+	  Istart[i] = s1;
+	  Iend[i]   = s2;
+	  ids[i]    = std::string( idblock + idx[i] , idblock + idx[i+1] );
+	}
+      if ( next != ne )
+	Helper::halt( bad );
+      
+      const int32_t * pE = (const int32_t*)( p + hdr.off_E );
+      const int32_t * pS = (const int32_t*)( p + hdr.off_S );
+      E.assign( pE , pE + ne );
+      S.assign( pS , pS + ne );
+
+      // nb. X1 is extended in place by level2(), so take a (bulk) copy
+      X1 = Eigen::Map<const Eigen::MatrixXd>( (const double*)( p + hdr.off_X ) , ne , hdr.n1 );
+      
+      return;
+    }
+
+  //
+  // otherwise, concatenated save1() records:
+  //  ID (uint8 length + chars), ne, nf { E , S , features (row-major) } 
+  //
+  
   int total_epochs = 0;
   int n_indiv = 0;
   
   // get size of data first 
-  while ( 1 )
+  uint64_t pos = 0;
+  while ( pos < len )
     {
-      std::string id = pops_indiv_t::bread_str( IN1 );
-      if ( IN1.eof() || IN1.bad() ) break;
-      ++n_indiv;
+      const uint8_t l = p[ pos ];
+      pos += 1 + l;
+      if ( pos + 2 * sizeof(int) > len ) break;
       
-      int ne1 = pops_indiv_t::bread_int( IN1 );
-      total_epochs += ne1;
+      int ne1 , nf1;
+      memcpy( &ne1 , p + pos , sizeof(int) );
+      memcpy( &nf1 , p + pos + sizeof(int) , sizeof(int) );
+      pos += 2 * sizeof(int);
       
-      int nf1 = pops_indiv_t::bread_int( IN1 );
       if ( nf1 != pops_t::specs.n1 )
 	Helper::halt( "data in " + f + " does not match feature-specification file" );
 
-      // skip rest (not, order diff. but obvs doesn't matter):
-      // epochs, stages
-      pops_indiv_t::bskip_int( IN1 , ne1 * 2 );
-      // skip features
-      pops_indiv_t::bskip_dbl( IN1 , ne1 * nf1 );
+      // skip epochs, stages and features
+      pos += (uint64_t)ne1 * ( 2 * sizeof(int) + nf1 * sizeof(double) );
+      if ( pos > len )
+	Helper::halt( f + " is truncated" );
 
+      ++n_indiv;
+      total_epochs += ne1;
     }
-  IN1.close();
-
+  
   logger << "  reading " << total_epochs << " epochs from " << n_indiv << " individuals\n";
   
   X1.resize( total_epochs , pops_t::specs.n1 );
   S.resize( total_epochs );
   E.resize( total_epochs );
   
-  // track when indivs start/stop
-  Istart.clear();
-  Iend.clear();
-  
   // re-read
-  std::ifstream IN2( Helper::expand( f ).c_str() , std::ios::binary | std::ios::in );
   total_epochs = 0;
+  pos = 0;
   
-  while ( 1 )
+  for (int k=0; k<n_indiv; k++)
     {
-      std::string id = pops_indiv_t::bread_str( IN2 );
-      if ( IN2.eof() || IN2.bad() ) break;
+      const uint8_t l = p[ pos ];
+      ids.push_back( std::string( p + pos + 1 , p + pos + 1 + l ) );
+      pos += 1 + l;
       
-      int ne1 = pops_indiv_t::bread_int( IN2 );      
-      int nf1 = pops_indiv_t::bread_int( IN2 );
+      int ne1;
+      memcpy( &ne1 , p + pos , sizeof(int) );
+      pos += 2 * sizeof(int);
       
       Istart.push_back( total_epochs );
-	    
+      
       for (int i=0; i<ne1; i++)
 	{
-
-	  // epoch
-	  E[ total_epochs ] = pops_indiv_t::bread_int( IN2 );
-
-	  // stage
-	  S[ total_epochs ] = pops_indiv_t::bread_int( IN2 );
+	  // epoch, stage
+	  memcpy( &E[ total_epochs ] , p + pos , sizeof(int) );
+	  memcpy( &S[ total_epochs ] , p + pos + sizeof(int) , sizeof(int) );
+	  pos += 2 * sizeof(int);
 
 	  // features
 	  for (int j=0; j<pops_t::specs.n1; j++)
-	    X1( total_epochs , j ) = pops_indiv_t::bread_dbl( IN2 );	  
+	    {
+	      double d;
+	      memcpy( &d , p + pos , sizeof(double) );
+	      X1( total_epochs , j ) = d;
+	      pos += sizeof(double);
+	    }
+	  
 	  ++total_epochs;
 	}
       
       Iend.push_back( total_epochs - 1 );
       
     }
-  IN2.close();
   
 }
 
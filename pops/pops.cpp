@@ -90,6 +90,10 @@ void pops_t::make_level2_library( param_t & param )
   // this will populate: X1, S, E and Istart/Iend
   load1( data_file );
 
+  // optionally, save as a (memory-mappable) library for faster reloads
+  if ( param.has( "lib" ) )
+    save1lib( param.value( "lib" ) );
+
   // expand X1 to include space for level-2 features
   X1.conservativeResize( Eigen::NoChange , pops_t::specs.na );
   
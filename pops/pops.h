@@ -61,9 +61,13 @@ struct pops_t {
   // i.e. for trainer and/or validation library
   void make_level2_library( param_t & );
 
-  // load level 1 data
+  // load level 1 data (either concatenated save1() records, or a
+  // library previously written by save1lib(), which is memory-mapped)
   void load1( const std::string & f );
 
+  // write the current level 1 data as a single, aligned binary library
+  void save1lib( const std::string & f ) const;
+
   // derive level 2 stats (from pops_t::specs)
   // this is also co-opted by prediction mode 
   void level2( const bool training = true );
@@ -91,6 +95,7 @@ struct pops_t {
   std::vector<int> S;
   std::vector<int> E;
   std::vector<int> Istart, Iend;
+  std::vector<std::string> ids;
 
   //
   // helpers
@@ -35,6 +35,7 @@
 #include "stats/eigen_ops.h"
 
 #include <deque>
+#include <set>
 
 extern writer_t writer;
 extern logger_t logger;
@@ -541,7 +542,13 @@ hb_t::hb_t( edf_t & edf , param_t & param )
    
    logger << "  estimating hypoxic burden for all events";
    
-   hb_find_burden_t burden = find_burden( SaO2Ve , SpO2Mean , t_sp , res.TST , MaxWin );
+   // per-event areas/baselines (given the search window from each
+   // ensemble-average) are computed once, and re-used below for all
+   // stage- and desat-specific subsets of events
+   
+   hb_event_burden_t eb_all = event_burden( SaO2Ve , SpO2Mean , t_sp , MaxWin );
+   
+   hb_find_burden_t burden = find_burden( eb_all , res.TST );
 
    //
    // Overall output
@@ -604,6 +611,13 @@ hb_t::hb_t( edf_t & edf , param_t & param )
    if ( denom_nrem > 0 )
      SpO2Mean_NREM /= denom_nrem;
    
+   hb_event_burden_t eb_nrem = event_burden( SaO2Ve , SpO2Mean_NREM , t_sp , MaxWin );
+   
+   hb_event_burden_t eb_rem;
+   eb_rem.valid = false;
+   if ( denom_rem )
+     eb_rem = event_burden( SaO2Ve , SpO2Mean_REM , t_sp , MaxWin );
+   
 
    //
    // Repeat burden analysis conditional on each stage
@@ -618,7 +632,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
 
    // N1
    std::vector<bool> incl = which_events( ss_mode , "N1" );
-   hb_find_burden_t hb_n1  = find_burden( SaO2Ve , SpO2Mean_NREM , t_sp , res.TST_N1   , MaxWin , &incl );
+   hb_find_burden_t hb_n1  = find_burden( eb_nrem , res.TST_N1 , &incl );
    if ( hb_n1.valid )
      {
        writer.level( "N1" , globals::stage_strat );
@@ -632,7 +646,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
    
    // N2
    incl = which_events( ss_mode , "N2" );
-   hb_find_burden_t hb_n2  = find_burden( SaO2Ve , SpO2Mean_NREM , t_sp , res.TST_N2   , MaxWin , &incl );
+   hb_find_burden_t hb_n2  = find_burden( eb_nrem , res.TST_N2 , &incl );
    if ( hb_n2.valid )
      {
        writer.level( "N2" , globals::stage_strat );
@@ -645,7 +659,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
    
    // N3
    incl = which_events( ss_mode , "N3" );
-   hb_find_burden_t hb_n3  = find_burden( SaO2Ve , SpO2Mean_NREM , t_sp , res.TST_N3   , MaxWin , &incl );
+   hb_find_burden_t hb_n3  = find_burden( eb_nrem , res.TST_N3 , &incl );
    if ( hb_n3.valid )
      {
        writer.level( "N3" , globals::stage_strat );
@@ -658,7 +672,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
    
    // NREM
    incl = which_events( ss_mode , "NREM" );
-   hb_find_burden_t hb_nr  = find_burden( SaO2Ve , SpO2Mean_NREM , t_sp , res.TST_NREM , MaxWin , &incl );
+   hb_find_burden_t hb_nr  = find_burden( eb_nrem , res.TST_NREM , &incl );
    if ( hb_nr.valid )
      {      
        writer.level( "NREM" , globals::stage_strat );
@@ -673,7 +687,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
    if ( denom_rem )
      {
        incl = which_events( ss_mode , "REM" );
-       hb_find_burden_t hb_rem = find_burden( SaO2Ve , SpO2Mean_REM  , t_sp , res.TST_REM  , MaxWin , &incl );
+       hb_find_burden_t hb_rem = find_burden( eb_rem , res.TST_REM , &incl );
        if ( hb_rem.valid )
 	 {
 	   writer.level( "REM" , globals::stage_strat );
@@ -864,7 +878,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
 
   if ( enough( incl_3pct ) )
     {
-      hb_find_burden_t hb = find_burden( SaO2Ve , SpO2Mean  , t_sp , res.TST  , MaxWin , &incl_3pct );
+      hb_find_burden_t hb = find_burden( eb_all , res.TST , &incl_3pct );
       if ( hb.valid )
 	{
 	  writer.value( "HB" ,  hb.HB );
@@ -879,7 +893,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
   incl = which_events( ss_mode , "REM" , &incl_3pct );
   if ( enough( incl ) )
     {
-      hb_find_burden_t hb = find_burden( SaO2Ve , SpO2Mean_REM  , t_sp , res.TST_REM  , MaxWin , &incl );
+      hb_find_burden_t hb = find_burden( eb_rem , res.TST_REM , &incl );
       if ( hb.valid )
 	{
 	  writer.level( "REM" , globals::stage_strat );
@@ -895,7 +909,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
   incl = which_events( ss_mode , "NREM" , &incl_3pct );
   if ( enough( incl ) )
     {
-      hb_find_burden_t hb = find_burden( SaO2Ve , SpO2Mean_NREM  , t_sp , res.TST_NREM  , MaxWin , &incl );
+      hb_find_burden_t hb = find_burden( eb_nrem , res.TST_NREM , &incl );
       if ( hb.valid )
 	{
 	  writer.level( "NREM" , globals::stage_strat );
@@ -924,7 +938,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
 
   if ( enough( incl_4pct ) )
     {
-      hb_find_burden_t hb = find_burden( SaO2Ve , SpO2Mean  , t_sp , res.TST  , MaxWin , &incl_4pct );
+      hb_find_burden_t hb = find_burden( eb_all , res.TST , &incl_4pct );
       if ( hb.valid )
 	{
 	  writer.value( "HB" ,  hb.HB );
@@ -939,7 +953,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
   incl = which_events( ss_mode , "REM" , &incl_4pct );
   if ( enough( incl ) )
     {
-      hb_find_burden_t hb = find_burden( SaO2Ve , SpO2Mean_REM  , t_sp , res.TST_REM  , MaxWin , &incl );
+      hb_find_burden_t hb = find_burden( eb_rem , res.TST_REM , &incl );
       if ( hb.valid )
 	{
 	  writer.level( "REM" , globals::stage_strat );
@@ -955,7 +969,7 @@ hb_t::hb_t( edf_t & edf , param_t & param )
   incl = which_events( ss_mode , "NREM" , &incl_4pct );
   if ( enough( incl ) )
     {
-      hb_find_burden_t hb = find_burden( SaO2Ve , SpO2Mean_NREM  , t_sp , res.TST_NREM  , MaxWin , &incl );
+      hb_find_burden_t hb = find_burden( eb_nrem , res.TST_NREM , &incl );
       if ( hb.valid )
 	{
 	  writer.level( "NREM" , globals::stage_strat );
@@ -1155,24 +1169,30 @@ hb_peakdet_t hb_t::peakdet( const Eigen::ArrayXd & v ,
   return r;
 }
 
-hb_find_burden_t hb_t::find_burden( const Eigen::MatrixXd & SpO2Mtx_orig ,
-				    const Eigen::ArrayXd & SpO2Mean_orig ,
+hb_find_burden_t hb_t::find_burden( const Eigen::MatrixXd & SpO2Mtx ,
+				    const Eigen::ArrayXd & SpO2Mean ,
 				    const std::vector<double> Time ,
 				    const double TST , 
 				    const int MaxWin ,
 				    const std::vector<bool> * incl )
 {
+  return find_burden( event_burden( SpO2Mtx , SpO2Mean , Time , MaxWin ) , TST , incl );
+}
 
-  hb_find_burden_t r;
-  r.valid = false;
-  
-  // r.HB
-  // r.BaselineSat
-  // r.SpO2MtxDiff
-  // r.BaselineSatAll ,
-  // r.searchWin
 
-  // CHECK: HypoxicBurdenAll == SpO2MtxDiff ?
+hb_event_burden_t hb_t::event_burden( const Eigen::MatrixXd & SpO2Mtx ,
+				      const Eigen::ArrayXd & SpO2Mean_orig ,
+				      const std::vector<double> & Time ,
+				      const int MaxWin )
+{
+
+  // the search window depends only on the ensemble-average, so
+  // derive it (and each event's area/baseline within it) once per
+  // mean; stage- or desat-specific burdens are then simple sums over
+  // subsets of events, see find_burden( hb_event_burden_t , ... )
+  
+  hb_event_burden_t r;
+  r.valid = false;
   
   //
   // take desats as +ve
@@ -1180,54 +1200,6 @@ hb_find_burden_t hb_t::find_burden( const Eigen::MatrixXd & SpO2Mtx_orig ,
   
   Eigen::ArrayXd SpO2Mean = 100 - SpO2Mean_orig;
 
-
-  //
-  // ... also, transpose to rows=time, cols=events
-  //
-  
-  Eigen::MatrixXd SpO2Mtx = 100 - SpO2Mtx_orig.transpose().array();
-
-  //
-  // Keep means as supplied, but if we have an incl[], then splice out these rows
-  //
-
-  if ( incl != NULL )
-    {
-      if ( incl->size() != SpO2Mtx.cols() )
-	Helper::halt( "problem in find_burden()" );
-
-      int nn = 0;
-      for (int i=0; i<incl->size(); i++)
-	if ( (*incl)[i] ) ++nn;
-
-      // no valid events
-      if ( nn == 0 )
-	{
-	  logger << "  no valid events in find_burden()\n";
-	  return r;
-	}
-      
-      const int rows = SpO2Mtx.rows();
-      
-      Eigen::MatrixXd copy = SpO2Mtx;      
-      SpO2Mtx.resize( rows , nn );
-      
-       nn = 0;
-      for (int i=0; i<incl->size(); i++)
-	{
-	  if ( (*incl)[i] )
-	    {
-	      for (int r=0 ; r<rows; r++)
-		SpO2Mtx(r,nn) = copy(r,i);
-	      ++nn;
-	    }
-	}
-    }
-  
-
-  // std::cerr << "Mean\n"
-  // 	    << SpO2Mean << "\n\n";
-  
   // Q. how NaNs get here..
   //    currently, no artifact removal on SaO2
   //    and out-of-range values replaced w/ the last/first value
@@ -1248,7 +1220,7 @@ hb_find_burden_t hb_t::find_burden( const Eigen::MatrixXd & SpO2Mtx_orig ,
   // Q. flag here?
   if ( peaks.minX.size() == 0 || peaks.maxX.size() == 0 )
     {
-      logger << "  problem finding min/max peaks\n";
+      r.problem = "problem finding min/max peaks";
       return r;
     }
   
@@ -1272,7 +1244,7 @@ hb_find_burden_t hb_t::find_burden( const Eigen::MatrixXd & SpO2Mtx_orig ,
   // not found, bail
   if ( max_resp_idx == -1 )
     {
-      logger << "  no minimum found in SpO2 average\n";
+      r.problem = "no minimum found in SpO2 average";
       return r; 
     }
 
@@ -1307,60 +1279,108 @@ hb_find_burden_t hb_t::find_burden( const Eigen::MatrixXd & SpO2Mtx_orig ,
 
   if ( min_pre < 0 || min_post < 0 )
     {
-      logger << "  requires both pre/post minima are defined\n";
+      r.problem = "requires both pre/post minima are defined";
       return r;
     }
   
   // Spo2 Matrix during search window : only consider rows within min_pre/post
   //  SpO2MtxSrchWin=SpO2Mtx(Time>=min_pre(1,1) & Time <= min_post(1,1),:); 
 
-  int rows = 0;
+  // Time[] is ascending, so the window is a contiguous block of
+  // columns of SpO2Mtx (rows=events, cols=time): take it directly,
+  // w/out any transposed or spliced copy of the whole matrix
   
-  for (int t=0; t<Time.size(); t++)
-    if ( Time[t] >= min_pre_idx && Time[t] <= min_post_idx ) ++rows;
-    
-  // extract matrix w/ only the new data
+  int t0 = 0;
+  while ( t0 < Time.size() && Time[t0] < min_pre_idx ) ++t0;
+  int t1 = t0;
+  while ( t1 < Time.size() && Time[t1] <= min_post_idx ) ++t1;
   
-  const int cols = SpO2Mtx.cols();
-
-  Eigen::MatrixXd SpO2MtxSrchWin = Eigen::MatrixXd::Zero( rows , cols );
-  
-  rows = 0;
-  for (int t=0; t<Time.size(); t++)
-    if ( Time[t] >= min_pre_idx && Time[t] <= min_post_idx )
-      {
-	for (int j=0;j<cols;j++)
-	  SpO2MtxSrchWin( rows , j ) = SpO2Mtx( t , j );
-	++rows;
-      }
-
-  // SpO2MtxSrchWin [ search-window/samples x events ] 
+  // SpO2MtxSrchWin [ events x search-window/samples ]   (desats as +ve)
+  Eigen::ArrayXXd SpO2MtxSrchWin = 100 - SpO2Mtx.middleCols( t0 , t1 - t0 ).array();
   
   // Maximum SpO2 during search window is defined as baseline SpO2
   // for each event
-
   //  SpO2BaslineMtx=repmat(min(SpO2MtxSrchWin),size(SpO2MtxSrchWin,1),1); 
-
-  Eigen::ArrayXd SpO2BaslineMtx = SpO2MtxSrchWin.colwise().minCoeff(); 
   
-  // return matrix window x events  (but all 
+  Eigen::ArrayXd SpO2BaslineMtx = SpO2MtxSrchWin.rowwise().minCoeff();
   
   // Baseline Sat for each event
   //  r.BaselineSatAll=100-mean(SpO2BaslineMtx);
-  r.BaselineSatAll = 100 - SpO2BaslineMtx;
+  r.baseline = 100 - SpO2BaslineMtx;
+  
+  // Remove baseline from SpO2 curve during search window, and get
+  // area under desat for each event
+  //  r.SpO2MtxDiff=SpO2MtxSrchWin-SpO2BaslineMtx; 
+  r.area = ( SpO2MtxSrchWin.colwise() - SpO2BaslineMtx ).rowwise().sum();
+  
+  // return search window
+  r.searchWin_lwr = min_pre_idx ;
+  r.searchWin_upr = min_post_idx;
 
-  // Mean Baseline Sat all events
-  //  r.BaselineSat=mean(100-mean(SpO2BaslineMtx)); 
-  r.BaselineSat = ( 100 - SpO2BaslineMtx ).mean();
+  r.valid = true;
+  
+  return r;
+}
 
-  // Remove baseline from SpO2 curve during search window
-  //  r.SpO2MtxDiff=SpO2MtxSrchWin-SpO2BaslineMtx; 
 
-  r.SpO2MtxDiff = SpO2MtxSrchWin;
+hb_find_burden_t hb_t::find_burden( const hb_event_burden_t & eb , 
+				    const double TST ,
+				    const std::vector<bool> * incl )
+{
+
+  hb_find_burden_t r;
+  r.valid = false;
+
+  //
+  // Keep means as supplied, but if we have an incl[], then only
+  // these events contribute
+  //
+
+  const int ne = eb.area.size();
   
-  for (int i=0; i < r.SpO2MtxDiff.rows(); i++) 
-    for (int j=0; j < r.SpO2MtxDiff.cols() ; j++) 
-      r.SpO2MtxDiff(i,j) = r.SpO2MtxDiff(i,j) - SpO2BaslineMtx[j];
+  int nn = ne;
+  
+  if ( incl != NULL )
+    {
+      // nb. if the mean was invalid, area[] is empty: only check
+      // size when we actually have per-event values
+      if ( eb.valid && incl->size() != ne )
+	Helper::halt( "problem in find_burden()" );
+      
+      nn = 0;
+      for (int i=0; i<incl->size(); i++)
+	if ( (*incl)[i] ) ++nn;
+
+      // no valid events
+      if ( nn == 0 )
+	{
+	  logger << "  no valid events in find_burden()\n";
+	  return r;
+	}
+    }
+
+  if ( ! eb.valid )
+    {
+      if ( eb.problem != "" ) 
+	logger << "  " << eb.problem << "\n";
+      return r;
+    }
+  
+  r.BaselineSatAll.resize( nn );
+  r.SpO2MtxDiff.resize( 1 , nn );
+
+  nn = 0;
+  for (int i=0; i<ne; i++)
+    {
+      if ( incl != NULL && ! (*incl)[i] ) continue;
+      r.BaselineSatAll[nn] = eb.baseline[i];
+      r.SpO2MtxDiff(0,nn) = eb.area[i];
+      ++nn;
+    }
+  
+  // Mean Baseline Sat all events
+  //  r.BaselineSat=mean(100-mean(SpO2BaslineMtx)); 
+  r.BaselineSat = r.BaselineSatAll.mean();
   
   // Hypoxic burden
   // Q. where do NAN come in?
@@ -1368,14 +1388,11 @@ hb_find_burden_t hb_t::find_burden( const Eigen::MatrixXd & SpO2Mtx_orig ,
   r.HB = r.SpO2MtxDiff.array().sum() / TST;
 
   // track number of events included here
-  r.ne = r.BaselineSatAll.size();
-  
-  // Area under desat for each event
-  r.SpO2MtxDiff = r.SpO2MtxDiff.colwise().sum(); 
+  r.ne = nn;
   
   // return search window
-  r.searchWin_lwr = min_pre_idx ;
-  r.searchWin_upr = min_post_idx;
+  r.searchWin_lwr = eb.searchWin_lwr;
+  r.searchWin_upr = eb.searchWin_upr;
 
   // all good
   r.valid = true;
@@ -1522,32 +1539,39 @@ hb_find_desats_t hb_t::find_desats( const Eigen::ArrayXd & s ,
   // these should be the same; guess that must be
   // guaranteed by peakdet()
   
-  std::vector<double> MagDown, MagUp, MagAv;  
+  //
+  // Iterate: repeatedly drop the smallest down (or up) swing until
+  // all exceed MagAv_thres; as only the neighbours of a dropped
+  // MIN change, keep the current swings in ordered sets (ties broken
+  // by position, i.e. the first (leftmost) instance of the smallest)
+  // rather than rescanning/recalculating all swings each time
+  //
+
+  if ( n_min > n_max - 1 ) n_min = n_max - 1;
+  
+  // MIN k sits between MAX at positions L[k] and R[k] 
+  std::vector<int> L( n_min ) , R( n_min ) , prv( n_min ) , nxt( n_min );
+  std::vector<bool> dropped_max( n_max , false );
+  std::vector<bool> dropped_min( n_min , false );
+  
+  std::set<std::pair<double,int> > MagDown, MagUp;
+  
   for (int i=0; i<n_min; i++ )    
     {
-      double md = s[ SaO2MaxIdx[i] ]   - s[ SaO2MinIdx[i] ] ;
-      double mu = s[ SaO2MaxIdx[i+1] ] - s[ SaO2MinIdx[i] ] ;
-      MagDown.push_back( md );
-      MagUp.push_back( mu );
-      MagAv.push_back( md+mu / 2.0 );      
+      L[i] = i; R[i] = i+1;
+      prv[i] = i-1; nxt[i] = i+1 < n_min ? i+1 : -1;
+      MagDown.insert( std::make_pair( s[ SaO2MaxIdx[i] ]   - s[ SaO2MinIdx[i] ] , i ) );
+      MagUp.insert( std::make_pair( s[ SaO2MaxIdx[i+1] ] - s[ SaO2MinIdx[i] ] , i ) );
     }
-
   
-  //
-  // Iterate
-  //
-
-  while ( 1 )
+  while ( MagDown.size() != 0 )
     {
       // [minVTinspexp,minVTinspexp_i] = min(MagDown);
       // [minVTinverted,minVTinverted_i] = min(MagUp);
       // [minVT,VTpattern] = min([minVTinspexp,minVTinverted]);
-      
-      int minVTinspexp_i = -1;
-      double minVTinspexp = min( MagDown , &minVTinspexp_i );
-      
-      int minVTinverted_i = -1;
-      double minVTinverted = min( MagUp , &minVTinverted_i );
+
+      const double minVTinspexp = MagDown.begin()->first;
+      const double minVTinverted = MagUp.begin()->first;
       
       double minVT = minVTinspexp <= minVTinverted ? minVTinspexp : minVTinverted;
       int VTpattern = minVTinspexp <= minVTinverted ? 1 : 2 ;
@@ -1555,14 +1579,27 @@ hb_find_desats_t hb_t::find_desats( const Eigen::ArrayXd & s ,
       // all done?
       if ( minVT > MagAv_thres ) break;
 
+      const int k = VTpattern == 1 ? MagDown.begin()->second : MagUp.begin()->second;
+      const int p = prv[k];
+      const int q = nxt[k];
+      
+      MagDown.erase( std::make_pair( s[ SaO2MaxIdx[L[k]] ] - s[ SaO2MinIdx[k] ] , k ) );
+      MagUp.erase( std::make_pair( s[ SaO2MaxIdx[R[k]] ] - s[ SaO2MinIdx[k] ] , k ) );
+      
       if ( VTpattern == 1 ) // down
 	{
 	  // i=minVTinspexp_i;
 	  // SaO2MaxIdx(i)=[];
 	  // SaO2MinIdx(i)=[];
-	  
-	  SaO2MaxIdx.erase( SaO2MaxIdx.begin() + minVTinspexp_i );
-	  SaO2MinIdx.erase( SaO2MinIdx.begin() + minVTinspexp_i );
+
+	  // previous MIN now rises to this MIN's right MAX
+	  dropped_max[ L[k] ] = true;
+	  if ( p != -1 )
+	    {
+	      MagUp.erase( std::make_pair( s[ SaO2MaxIdx[R[p]] ] - s[ SaO2MinIdx[p] ] , p ) );
+	      R[p] = R[k];
+	      MagUp.insert( std::make_pair( s[ SaO2MaxIdx[R[p]] ] - s[ SaO2MinIdx[p] ] , p ) );
+	    }
 	}
       else if ( VTpattern == 2 ) // %up
 	{
@@ -1570,51 +1607,38 @@ hb_find_desats_t hb_t::find_desats( const Eigen::ArrayXd & s ,
 	  // SaO2MaxIdx(i+1)=[];
 	  // SaO2MinIdx(i)=[];
 
-	  SaO2MaxIdx.erase( SaO2MaxIdx.begin()+minVTinverted_i+1 );
-	  SaO2MinIdx.erase( SaO2MinIdx.begin()+minVTinverted_i  );
-
-	}
-
-      // recalculate
-      n_min = SaO2MinIdx.size();
-
-      MagDown.clear();
-      MagUp.clear();
-      MagAv.clear();
-      for (int i=0; i<n_min; i++ )    
-	{
-	  double md = s[ SaO2MaxIdx[i] ] - s[ SaO2MinIdx[i] ] ;
-	  double mu = s[ SaO2MaxIdx[i+1] ] - s[ SaO2MinIdx[i] ] ;
-	  MagDown.push_back( md );
-	  MagUp.push_back( mu );
-	  MagAv.push_back( md+mu / 2.0 );      
+	  // next MIN now falls from this MIN's left MAX
+	  dropped_max[ R[k] ] = true;
+	  if ( q != -1 )
+	    {
+	      MagDown.erase( std::make_pair( s[ SaO2MaxIdx[L[q]] ] - s[ SaO2MinIdx[q] ] , q ) );
+	      L[q] = L[k];
+	      MagDown.insert( std::make_pair( s[ SaO2MaxIdx[L[q]] ] - s[ SaO2MinIdx[q] ] , q ) );
+	    }
 	}
 
+      dropped_min[k] = true;
+      if ( p != -1 ) nxt[p] = q;
+      if ( q != -1 ) prv[q] = p;
+      
       // if isempty(SaO2MaxIdx) || isempty(SaO2MinIdx)
       //      break
       //  end
-      
-      if ( SaO2MaxIdx.size() == 0 || SaO2MinIdx.size() == 0 ) break;
-      
     }
 
-  
-  // MagDown = SaO2(SaO2MaxIdx(1:end-1))-SaO2(SaO2MinIdx(1:end));
-  // MagUp = SaO2(SaO2MaxIdx(2:end))-SaO2(SaO2MinIdx(1:end));
+  //
+  // retained MAX/MIN
+  //
 
-  n_min = SaO2MinIdx.size();
-  MagDown.clear();
-  MagUp.clear();
-  MagAv.clear();
+  std::deque<int> kept_max, kept_min;
+  for (int i=0; i<n_max; i++)
+    if ( ! dropped_max[i] ) kept_max.push_back( SaO2MaxIdx[i] );
+  for (int i=0; i<n_min; i++)
+    if ( ! dropped_min[i] ) kept_min.push_back( SaO2MinIdx[i] );
+  SaO2MaxIdx = kept_max;
+  SaO2MinIdx = kept_min;
   
-  for (int i=0; i<n_min; i++ )
-    {
-      double md = s[ SaO2MaxIdx[i] ] - s[ SaO2MinIdx[i] ] ;
-      double mu = s[ SaO2MaxIdx[i+1] ] - s[ SaO2MinIdx[i] ] ;
-      MagDown.push_back( md );
-      MagUp.push_back( mu );
-      MagAv.push_back( md+mu / 2.0 );
-    }
+  n_min = SaO2MinIdx.size();
 
   // constants
   
@@ -1723,19 +1747,6 @@ bool hb_t::enough( const std::vector<bool> & x , int th )
   return c >= th;
 }
 
-double hb_t::min( const std::vector<double> & s , int * idx )
-{
-  const int n = s.size();
-  double m = s[n-1];
-  // go backwards, so we get the first instance of the min if ties
-  for (int i=n-1; i>=0; i--)
-    if ( s[i] <= m ) { m = s[i]; *idx = i; }
-  return m;
-}
-
-
-
-
  delta_hr_t hb_t::SummarizeHR_AA( const Eigen::MatrixXd & HRVe ,
  				 const std::vector<double> & Start ,
  				 const std::vector<double> & End ,
@@ -42,6 +42,17 @@ struct hb_find_burden_t {
   int searchWin_lwr, searchWin_upr;
 };
 
+// event_burden() return value: per-event areas and baselines for
+// the search window implied by one ensemble-average; find_burden()
+// then only sums over whichever subset of events is requested
+struct hb_event_burden_t {
+  bool valid;
+  std::string problem;
+  Eigen::ArrayXd area;
+  Eigen::ArrayXd baseline;
+  int searchWin_lwr, searchWin_upr;
+};
+
 // peakdet() return value
 struct hb_peakdet_t {
   std::vector<double> maxV; 
@@ -166,6 +177,15 @@ struct hb_t {
 				       const double TST , 
 				       const int MaxWin ,
 				       const std::vector<bool> * incl = NULL );
+
+  static hb_event_burden_t event_burden( const Eigen::MatrixXd & SpO2Mtx ,
+					 const Eigen::ArrayXd & SpO2Mean ,
+					 const std::vector<double> & Time ,
+					 const int MaxWin );
+
+  static hb_find_burden_t find_burden( const hb_event_burden_t & eb ,
+				       const double TST ,
+				       const std::vector<bool> * incl = NULL );
   
 
   static sleep_stage_t modal_stage( const Eigen::ArrayXi & );
@@ -177,8 +197,6 @@ struct hb_t {
   
   static hb_find_desats_t find_desats( const Eigen::ArrayXd & , int , double );
 
-  static double min( const std::vector<double> & s , int * idx );
-
   static delta_hr_t SummarizeHR_AA( const Eigen::MatrixXd & HRVe ,
 				    const std::vector<double> & Start ,
 				    const std::vector<double> & End , 
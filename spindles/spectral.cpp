@@ -178,6 +178,12 @@ annot_t * spectral_power( edf_t & edf ,
   //
 
   const bool use_nextpow2 = param.has( "pow2" );
+
+  //
+  // Persistent cache of epoch-level spectra (cache-dir=folder), unless no-cache
+  //
+  
+  const bool use_dcache = dcache_t::active() && ! param.has( "no-cache" );
   
   //
   // Define standard band summaries
@@ -284,6 +290,49 @@ annot_t * spectral_power( edf_t & edf ,
       // store spectral slope per epoch for this channel?
       std::vector<double> slopes;
       
+
+      //
+      // Persistent cache: key on the Welch parameters, and the set of
+      // epochs being analysed; rows are freqs, then PSD (and CV) per epoch
+      //
+      
+      uint64_t dkey = 0;
+      
+      std::vector<std::vector<double> > dcached;
+
+      bool dhit = false;
+
+      if ( use_dcache )
+	{
+	  uint64_t esig = cache_hash_init;
+	  edf.timeline.first_epoch();
+	  while ( 1 )
+	    {
+	      int epoch = edf.timeline.next_epoch();
+	      if ( epoch == -1 ) break;
+	      interval_t interval = edf.timeline.epoch( epoch );
+	      esig = cache_hash( interval.start , esig );
+	      esig = cache_hash( interval.stop , esig );
+	    }
+	  
+	  std::stringstream pp;
+	  pp << Fs[s] << " " << fft_segment_size << " " << fft_segment_overlap << " " 
+	     << window_function << " " << use_seg_median << " " << calc_seg_sd << " " 
+	     << average_adj << " " << use_nextpow2 << " " << mean_centre_epoch;
+	  
+	  dkey = edf.timeline.cache.disk.key( edf.filename , "PSD" , signals.label(s) , pp.str() , esig );
+	  
+	  dhit = edf.timeline.cache.disk.fetch( dkey , &dcached );
+	  
+	  if ( dhit ) 
+	    logger << "  using cached spectra for " << signals.label(s) << "\n";
+	  else
+	    dcached.push_back( std::vector<double>() ); // freqs, set below
+	}
+
+      // which cached row are we on?
+      int drow = 1;
+      
       
       //
       // Set first epoch
@@ -313,54 +362,71 @@ annot_t * spectral_power( edf_t & edf ,
 	  if ( epoch_level_output )
 	    writer.epoch( edf.timeline.display_epoch( epoch ) );
 
-	   //
-	   // Get data
-	   //
+	   PWELCH * ppwelch = NULL;
 
-	   slice_t slice( edf , signals(s) , interval );
-	   
-	   std::vector<double> * d = slice.nonconst_pdata();
+	   if ( dhit && drow + ( calc_seg_sd ? 1 : 0 ) < dcached.size() )
+	     {
+	       //
+	       // restore from the persistent cache
+	       //
 
-	   //
-	   // mean centre epoch?
-	   //
+	       const std::vector<double> & cpsd = dcached[ drow++ ];
+	       const std::vector<double> & cpsdsd = calc_seg_sd ? dcached[ drow++ ] : cpsd;
+	       ppwelch = new PWELCH( dcached[0] , cpsd , calc_seg_sd ? cpsdsd : std::vector<double>() );	       
+	     }
+	   else
+	     {
+	       
+	       //
+	       // Get data
+	       //
+	       
+	       slice_t slice( edf , signals(s) , interval );
+	       
+	       std::vector<double> * d = slice.nonconst_pdata();
+	       
+	       //
+	       // mean centre epoch?
+	       //
+	       
+	       if ( mean_centre_epoch ) 
+		 MiscMath::centre( d );
+	       
+	       //
+	       // pwelch() to obtain full PSD
+	       //
+	       
+	       const double overlap_sec = fft_segment_overlap;
+	       const double segment_sec  = fft_segment_size;
+	       
+	       const int total_points = d->size();
+	       const int segment_points = segment_sec * Fs[s];
+	       const int noverlap_points  = overlap_sec * Fs[s];
+	       
+	       // implied number of segments
+	       int noverlap_segments = floor( ( total_points - noverlap_points) 
+					      / (double)( segment_points - noverlap_points ) );
+	       
+	       ppwelch = new PWELCH( *d , 
+				     Fs[s] , 
+				     segment_sec , 
+				     noverlap_segments , 
+				     window_function , 
+				     use_seg_median,
+				     calc_seg_sd,
+				     average_adj ,
+				     use_nextpow2 );
+
+	       // track for the persistent cache
+	       if ( use_dcache && ! dhit ) 
+		 {
+		   if ( dcached[0].size() == 0 ) dcached[0] = ppwelch->freq;
+		   dcached.push_back( ppwelch->psd );
+		   if ( calc_seg_sd ) dcached.push_back( ppwelch->psdsd );
+		 }
+	     }
 
-	   if ( mean_centre_epoch ) 
-	     MiscMath::centre( d );
-	   
-	   //
-	   // pwelch() to obtain full PSD
-	   //
-	   
-	   const double overlap_sec = fft_segment_overlap;
-	   const double segment_sec  = fft_segment_size;
-	   
-	   const int total_points = d->size();
-	   const int segment_points = segment_sec * Fs[s];
-	   const int noverlap_points  = overlap_sec * Fs[s];
-	   
-	   // implied number of segments
-	   int noverlap_segments = floor( ( total_points - noverlap_points) 
-					  / (double)( segment_points - noverlap_points ) );
-	   
-	   
-// 	   logger << "total_points = " << total_points << "\n";
-// 	   logger << "nooverlap_segments = " << noverlap_segments << "\n";
-// 	   logger << "noverlap_points = " << noverlap_points << "\n";
-// 	   logger << "segment_points = " << segment_points << "\n";
-	   
-// 	   std::cout << "about to fly...\n";
-// 	   std::cout << "Fs = " << Fs[s] << "\n";
-
-	   PWELCH pwelch( *d , 
-			  Fs[s] , 
-			  segment_sec , 
-			  noverlap_segments , 
-			  window_function , 
-			  use_seg_median,
-			  calc_seg_sd,
-			  average_adj ,
-			  use_nextpow2 );
+	   PWELCH & pwelch = *ppwelch;
 	   
 
 	   double this_slowwave   = pwelch.psdsum( SLOW )  ;      /// globals::band_width( SLOW );
@@ -567,12 +633,22 @@ annot_t * spectral_power( edf_t & edf ,
 
 	   if ( epoch_level_output )
 	     writer.unepoch();
+
+	   delete ppwelch;
 	   
 	   //
 	   // next epoch
 	   //
 
 	}
+
+      //
+      // save to the persistent cache
+      //
+      
+      if ( use_dcache && ! dhit )
+	edf.timeline.cache.disk.store( dkey , dcached );
+      
       
       
       //
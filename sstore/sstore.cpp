@@ -23,6 +23,8 @@
 #include "db/sqlwrap.h"
 #include "helper/helper.h"
 
+#include <limits>
+
 sstore_t::sstore_t( const std::string & f1  ) 
 {
   
@@ -62,6 +64,15 @@ sstore_t::sstore_t( const std::string & f1  )
             "   n    INTEGER , "
 	    "   val  VARCHAR(20) );" );
 
+  sql.query(" CREATE TABLE IF NOT EXISTS epoch_arrays ("
+            "   ch   VARCHAR(2) , "
+            "   id   VARCHAR(8) NOT NULL , "
+	    "   lvl  VARCHAR(8) , "
+	    "   e0   INTEGER , "
+	    "   ne   INTEGER , "
+            "   n    INTEGER , "
+	    "   val  BLOB );" );
+
   init();
   
 }
@@ -75,6 +86,8 @@ bool sstore_t::init()
   stmt_insert_base      = sql.prepare(" INSERT OR REPLACE INTO base ( ch , id , lvl , n , val ) values( :ch, :id, :lvl , :n , :val ); " );
   stmt_insert_epoch     = sql.prepare(" INSERT OR REPLACE INTO epochs ( epoch , ch , id , lvl , n , val ) values( :epoch, :ch, :id, :lvl , :n , :val ); " );
   stmt_insert_interval  = sql.prepare(" INSERT OR REPLACE INTO intervals ( start , stop , ch , id , lvl , n , val ) values( :start , :stop, :ch, :id, :lvl , :n , :val ); " );
+  stmt_insert_array     = sql.prepare(" INSERT INTO epoch_arrays ( ch , id , lvl , e0 , ne , n , val ) values( :ch, :id, :lvl , :e0 , :ne , :n , :val ); " );
+  stmt_delete_array     = sql.prepare(" DELETE FROM epoch_arrays WHERE id == :id AND ch IS :ch AND lvl IS :lvl ; " );
 
   // gets
   stmt_fetch_base = sql.prepare( "SELECT * FROM base;" );
@@ -84,10 +97,13 @@ bool sstore_t::init()
 
   stmt_fetch_interval = sql.prepare( "SELECT * FROM intervals WHERE start BETWEEN :a AND :b " );
   stmt_fetch_all_intervals = sql.prepare( "SELECT * FROM intervals; " );
+
+  stmt_fetch_array = sql.prepare( "SELECT rowid , e0 , ne , n FROM epoch_arrays WHERE id == :id AND ch IS :ch AND lvl IS :lvl ; " );
    
   stmt_fetch_keys = sql.prepare( "SELECT id, ch, lvl , COUNT(1) FROM base GROUP BY id, ch, lvl ;" );
   stmt_fetch_keys_epochs = sql.prepare( "SELECT id, ch, lvl , COUNT(1) FROM epochs GROUP BY id, ch, lvl ;" );
   stmt_fetch_keys_intervals = sql.prepare( "SELECT id, ch, lvl , COUNT(1) FROM intervals GROUP BY id, ch, lvl ;" );
+  stmt_fetch_keys_arrays = sql.prepare( "SELECT id, ch, lvl , SUM(ne) FROM epoch_arrays GROUP BY id, ch, lvl ;" );
 
   return true;
 }
@@ -99,16 +115,20 @@ bool sstore_t::release()
   sql.finalise( stmt_insert_base );
   sql.finalise( stmt_insert_epoch );
   sql.finalise( stmt_insert_interval );
+  sql.finalise( stmt_insert_array );
+  sql.finalise( stmt_delete_array );
   
   sql.finalise( stmt_fetch_base );
   sql.finalise( stmt_fetch_epoch );
   sql.finalise( stmt_fetch_all_epochs );
   sql.finalise( stmt_fetch_interval );
   sql.finalise( stmt_fetch_all_intervals );
+  sql.finalise( stmt_fetch_array );
 
   sql.finalise( stmt_fetch_keys );
   sql.finalise( stmt_fetch_keys_epochs );
   sql.finalise( stmt_fetch_keys_intervals );
+  sql.finalise( stmt_fetch_keys_arrays );
 
   return true;
 }
@@ -120,6 +140,7 @@ bool sstore_t::index()
   
   sql.query( "CREATE INDEX IF NOT EXISTS e_idx ON epochs( epoch ); " );
   sql.query( "CREATE INDEX IF NOT EXISTS i_idx ON intervals( start , stop ); " );
+  sql.query( "CREATE INDEX IF NOT EXISTS a_idx ON epoch_arrays( id , ch , lvl ); " );
   
   // schema changed, so update prepared queries
   release();
@@ -133,6 +154,7 @@ bool sstore_t::drop_index()
   if ( ! attached() ) return false;
   sql.query( "DROP INDEX IF EXISTS e_idx;" );
   sql.query( "DROP INDEX IF EXISTS i_idx;" );
+  sql.query( "DROP INDEX IF EXISTS a_idx;" );
   // schema changed, so update prepared queries
   release();
   init(); 
@@ -456,6 +478,127 @@ void sstore_t::insert_interval( const double a , const double b , const std::str
 
 
 
+
+//
+// Packed epoch arrays
+//
+
+void sstore_t::bind_key( sqlite3_stmt * stmt , const std::string & id , const std::string * ch , const std::string * lvl )
+{
+  sql.bind_text( stmt , ":id" , id );
+
+  if ( ch == NULL ) 
+    sql.bind_null( stmt , ":ch" );
+  else
+    sql.bind_text( stmt , ":ch" , *ch );
+
+  if ( lvl == NULL ) 
+    sql.bind_null( stmt , ":lvl" );
+  else
+    sql.bind_text( stmt , ":lvl" , *lvl );
+}
+
+
+void sstore_t::insert_epoch_array( const std::string & id , const std::map<int,std::vector<double> > & values , const std::string * ch , const std::string * lvl )
+{
+  
+  if ( values.size() == 0 ) return;
+
+  // epoch range and values per epoch
+
+  const int e0 = values.begin()->first;
+  const int ne = values.rbegin()->first - e0 + 1;
+  const int n  = values.begin()->second.size();
+
+  std::vector<float> buf( (size_t)ne * n , std::numeric_limits<float>::quiet_NaN() );
+
+  std::map<int,std::vector<double> >::const_iterator ee = values.begin();
+  while ( ee != values.end() )
+    {
+      if ( ee->second.size() != n ) 
+	Helper::halt( "sstore_t::insert_epoch_array(), all epochs must have the same number of values" );
+      float * p = &buf[ (size_t)( ee->first - e0 ) * n ];
+      for (int i=0; i<n; i++) p[i] = ee->second[i];
+      ++ee;
+    }
+
+  // replace any existing array for this key
+  
+  bind_key( stmt_delete_array , id , ch , lvl );
+  sql.step( stmt_delete_array );
+  sql.reset( stmt_delete_array );
+  
+  bind_key( stmt_insert_array , id , ch , lvl );
+  sql.bind_int( stmt_insert_array , ":e0" , e0 );
+  sql.bind_int( stmt_insert_array , ":ne" , ne );
+  sql.bind_int( stmt_insert_array , ":n" , n );
+
+  // as for vectors, stored in native byte order
+  sqlite3_bind_blob( stmt_insert_array , 
+		     sqlite3_bind_parameter_index( stmt_insert_array , ":val" ) , 
+		     &(buf[0]) , 
+		     buf.size() * sizeof(float) , 
+		     0 );
+
+  sql.step( stmt_insert_array );
+  sql.reset( stmt_insert_array );
+  
+}
+
+
+bool sstore_t::fetch_epoch_array( sstore_array_t * arr , const std::string & id , const std::string * ch , const std::string * lvl , 
+				  const int e1 , const int e2 )
+{
+
+  bind_key( stmt_fetch_array , id , ch , lvl );
+
+  if ( ! sql.step( stmt_fetch_array ) ) 
+    {
+      sql.reset( stmt_fetch_array );
+      return false;
+    }
+  
+  const sqlite3_int64 rowid = sqlite3_column_int64( stmt_fetch_array , 0 );
+  const int e0 = sql.get_int( stmt_fetch_array , 1 );
+  const int ne = sql.get_int( stmt_fetch_array , 2 );
+  const int n  = sql.get_int( stmt_fetch_array , 3 );
+  
+  sql.reset( stmt_fetch_array );
+
+  // requested range (clipped to what is stored)
+  
+  const int a = e1 == -1 || e1 < e0 ? e0 : e1;
+  const int b = e2 == -1 || e2 > e0 + ne - 1 ? e0 + ne - 1 : e2;
+  
+  arr->e0 = a;
+  arr->ne = b >= a ? b - a + 1 : 0;
+  arr->n  = n;
+  arr->data.resize( (size_t)arr->ne * n );
+
+  if ( arr->ne == 0 || n == 0 ) return true;
+
+  // read only this (contiguous) range of epochs from the blob
+  
+  sqlite3_blob * blob;
+  
+  if ( sqlite3_blob_open( sql.pointer() , "main" , "epoch_arrays" , "val" , rowid , 0 , &blob ) != SQLITE_OK )
+    Helper::halt( "problem opening epoch array in " + filename );
+
+  const int rc = sqlite3_blob_read( blob , 
+				    &(arr->data[0]) , 
+				    arr->data.size() * sizeof(float) , 
+				    (size_t)( a - e0 ) * n * sizeof(float) );
+  
+  sqlite3_blob_close( blob );
+
+  if ( rc != SQLITE_OK ) 
+    Helper::halt( "problem reading epoch array in " + filename );
+
+  return true;
+}
+
+
+
 //
 // Epoch and interval level fetches
 //
@@ -763,3 +906,19 @@ std::map<sstore_key_t,int> sstore_t::keys_interval()
 
 }
 
+std::map<sstore_key_t,int> sstore_t::keys_epoch_array()
+{
+  std::map<sstore_key_t,int> keys;
+  while ( sql.step( stmt_fetch_keys_arrays ) )
+    {
+      sstore_key_t key;
+      key.id  = sql.get_text( stmt_fetch_keys_arrays , 0 );
+      key.ch  = sql.get_text( stmt_fetch_keys_arrays , 1 );
+      key.lvl = sql.get_text( stmt_fetch_keys_arrays , 2 );            
+      if ( key.ch == "" ) key.ch = ".";
+      if ( key.lvl == "" ) key.lvl = ".";
+      keys[ key ] += sql.get_int( stmt_fetch_keys_arrays , 3 );
+    }
+  sql.reset( stmt_fetch_keys_arrays );
+  return keys;
+}
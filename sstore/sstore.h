@@ -68,6 +68,25 @@ struct sstore_data_t {
 };
 
 
+// packed epoch-level values: a single row per id/lvl/ch, holding all
+// epochs as one float array ( ne epochs x n values, epoch-major ) 
+
+struct sstore_array_t { 
+
+  sstore_array_t() : e0(0) , ne(0) , n(0) { } 
+
+  // first (1-based) epoch, number of epochs, values per epoch
+  int e0;
+  int ne;
+  int n;
+
+  std::vector<float> data;
+
+  const float * epoch( const int e ) const { return &data[ (size_t)( e - e0 ) * n ]; } 
+};
+
+
+
 struct sstore_t { 
 
   sstore_t( const std::string & );
@@ -98,6 +117,9 @@ struct sstore_t {
   void insert_epoch( const int e , const std::string & id , const double      & value , const std::string * ch = NULL , const std::string * lvl = NULL);
   void insert_epoch( const int e , const std::string & id , const std::vector<double> & value , const std::string * ch = NULL , const std::string * lvl = NULL);
 
+  // packed epoch arrays (epochs not present are set to NaN) 
+  void insert_epoch_array( const std::string & id , const std::map<int,std::vector<double> > & values , const std::string * ch = NULL , const std::string * lvl = NULL );
+
   // tp-based interval codes (in seconnds)
   void insert_interval( const double a , const double b , const std::string & id , const std::string & value , const std::string * ch = NULL , const std::string * lvl = NULL);  
   void insert_interval( const double a , const double b , const std::string & id , const double      & value , const std::string * ch = NULL , const std::string * lvl = NULL);  
@@ -109,6 +131,10 @@ struct sstore_t {
   sstore_data_t fetch_epoch( const int e ); 
   std::map<int,sstore_data_t> fetch_epochs(); 
 
+  // epochs e1 to e2 (1-based, inclusive; -1 for all) of a packed array
+  bool fetch_epoch_array( sstore_array_t * , const std::string & id , const std::string * ch = NULL , const std::string * lvl = NULL , 
+			  const int e1 = -1 , const int e2 = -1 );
+
   sstore_data_t fetch_interval( const interval_t & ); 
   std::map<interval_t,sstore_data_t> fetch_intervals(); 
   
@@ -116,6 +142,7 @@ struct sstore_t {
   std::map<sstore_key_t,int> keys();
   std::map<sstore_key_t,int> keys_epoch();
   std::map<sstore_key_t,int> keys_interval();
+  std::map<sstore_key_t,int> keys_epoch_array();
       
 private:
 
@@ -134,6 +161,8 @@ private:
   sqlite3_stmt * stmt_insert_base;
   sqlite3_stmt * stmt_insert_epoch;
   sqlite3_stmt * stmt_insert_interval;    
+  sqlite3_stmt * stmt_insert_array;
+  sqlite3_stmt * stmt_delete_array;
 
   // gets
 
@@ -145,10 +174,15 @@ private:
   sqlite3_stmt * stmt_fetch_interval;
   sqlite3_stmt * stmt_fetch_all_intervals;
 
+  sqlite3_stmt * stmt_fetch_array;
+  
 
   sqlite3_stmt * stmt_fetch_keys;
   sqlite3_stmt * stmt_fetch_keys_epochs;
   sqlite3_stmt * stmt_fetch_keys_intervals;
+  sqlite3_stmt * stmt_fetch_keys_arrays;
+
+  void bind_key( sqlite3_stmt * stmt , const std::string & id , const std::string * ch , const std::string * lvl );
 
   // helper functiosn to 
 
@@ -921,3 +921,82 @@ double GLM::linear_hypothesis( Data::Matrix<double> & H, Data::Vector<double> &
     
 }
 
+
+
+//
+// Mass-univariate linear models
+//
+
+bool mass_glm_t::set( const Eigen::MatrixXd & X0 )
+{
+
+  X = X0;
+  n = X.rows();
+  np = X.cols();
+  okay = false;
+  
+  if ( np == 0 || n <= np ) return false;
+  
+  qr.compute( X );
+
+  if ( qr.rank() < np ) return false;
+
+  // (X'X)^-1 = P R^-1 R^-T P' , given XP = QR
+  
+  Eigen::MatrixXd Ri = qr.matrixR().topLeftCorner( np , np ).triangularView<Eigen::Upper>().solve( Eigen::MatrixXd::Identity( np , np ) );
+
+  Eigen::VectorXd d = Ri.rowwise().squaredNorm();
+  
+  S0.resize( np );
+  for (int j=0; j<np; j++)
+    S0[ qr.colsPermutation().indices()[j] ] = d[j];
+  
+  okay = true;
+  return true;
+}
+
+
+bool mass_glm_t::fit( const Eigen::MatrixXd & Y )
+{
+
+  if ( ! okay ) return false;
+
+  if ( Y.rows() != n ) 
+    Helper::halt( "internal error in mass_glm_t::fit(), Y and X rows do not match" );
+
+  const int m = Y.cols();
+
+  // all outcomes solved jointly, given the single factorization
+  
+  B = qr.solve( Y );
+
+  E = Y;
+  E.noalias() -= X * B;
+
+  RSS = E.colwise().squaredNorm().transpose();
+
+  Eigen::VectorXd SSY = ( Y.rowwise() - Y.colwise().mean() ).colwise().squaredNorm().transpose();
+  
+  SE.resize( np , m );
+  P.resize( np , m );
+  R2.resize( m );
+  
+  const double df = n - np;
+  
+  for (int k=0; k<m; k++)
+    {
+      const double sigma = RSS[k] / df;
+
+      for (int j=0; j<np; j++)
+	{
+	  SE(j,k) = sqrt( S0[j] * sigma );
+	  P(j,k) = SE(j,k) < 1e-20 || ! Helper::realnum( SE(j,k) ) 
+	    ? 1.0 : Statistics::t_prob( B(j,k) / SE(j,k) , df );
+	}
+      
+      const double r = SSY[k] > 0 ? ( SSY[k] - RSS[k] ) / SSY[k] : 0 ;
+      R2[k] = r > 0 ? ( r > 1 ? 1 : r ) : 0;
+    }
+
+  return true;
+}
@@ -24,6 +24,7 @@
 #define __GLM_H__
 
 #include "matrix.h"
+#include "stats/Eigen/Dense"
 #include <vector>
 
 class GLM {
@@ -188,4 +189,53 @@ class GLM {
 
 };
 
+
+//
+// Mass-univariate linear models: a single design X (n x p) is
+// factorized (QR) once, and shared by all outcomes (the m columns of Y)
+// which are then fit jointly; i.e. as GLM::fit_linear() for each column
+// (OLS variance, no clustering) but without refitting the design
+//
+
+class mass_glm_t {
+
+ public:
+
+  mass_glm_t() : n(0) , np(0) , okay(false) { } 
+
+  // factorize design; returns false if rank-deficient
+  bool set( const Eigen::MatrixXd & X );
+
+  // fit all columns of Y (n x m)
+  bool fit( const Eigen::MatrixXd & Y );
+
+  bool valid() const { return okay; } 
+
+  // coefficients, standard errors and p-values (p x m)
+  Eigen::MatrixXd B;
+  Eigen::MatrixXd SE;
+  Eigen::MatrixXd P;
+
+  // residuals (n x m)
+  Eigen::MatrixXd E;
+
+  // residual sum of squares, R-squared (m)
+  Eigen::VectorXd RSS;
+  Eigen::VectorXd R2;
+  
+ private:
+
+  int n, np;
+
+  bool okay;
+  
+  Eigen::MatrixXd X;
+  
+  Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr;
+
+  // diagonal of (X'X)^-1
+  Eigen::VectorXd S0;
+  
+};
+
 #endif
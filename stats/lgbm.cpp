@@ -216,6 +216,7 @@ bool lgbm_t::create_booster( )
     Helper::halt( "problem creating this file" );
 
   has_booster = true;
+  model_file = "";
   
   //
   // add validation data 
@@ -429,12 +430,24 @@ bool lgbm_t::attach_validation_matrix( const Eigen::MatrixXd & X )
 bool lgbm_t::load_model( const std::string & f )
 {
   std::string filename = Helper::expand( f );  
+
+  // already attached (e.g. repeated POPS calls, or --serve mode)?
+  if ( has_booster && filename == model_file ) return true;
+  
   if ( ! Helper::fileExists( filename ) ) Helper::halt( "could not open " + filename );
+
+  // swap out any prior booster
+  if ( has_booster && LGBM_BoosterFree( booster ) )
+    Helper::halt( "problem freeing LGBM booster" );
+  has_booster = false;
+  
   int out_num_iterations;  
   int temp = LGBM_BoosterCreateFromModelfile( filename.c_str() ,
 					      &out_num_iterations ,
 					      &booster );
+  if ( temp ) Helper::halt( "problem reading model from " + filename );
   has_booster = true;  
+  model_file = filename;
   logger << "  read model from " << filename << " ( " << out_num_iterations << " iterations)\n";
   return true;
 }
@@ -442,11 +455,17 @@ bool lgbm_t::load_model( const std::string & f )
 // load model from a string
 bool lgbm_t::load_model_string( const std::string & str )
 {  
+  if ( has_booster && LGBM_BoosterFree( booster ) )
+    Helper::halt( "problem freeing LGBM booster" );
+  has_booster = false;
+  
   int out_num_iterations;  
   int res = LGBM_BoosterLoadModelFromString( str.c_str() ,
 					     &out_num_iterations ,
 					     &booster );
   if ( res ) Helper::halt( "problem in lgmb_t::load_model()" );
+  has_booster = true;
+  model_file = "";
   logger << "  attached model (" << out_num_iterations << " iterations)\n";  
   return true;
 }
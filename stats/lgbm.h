@@ -166,6 +166,9 @@ struct lgbm_t {
   // booster
   bool has_booster;  
   BoosterHandle booster;
+
+  // file the booster was read from (to skip reloading the same model)
+  std::string model_file;
   
   // training data
   bool has_training;
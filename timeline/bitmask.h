@@ -0,0 +1,193 @@
+
+//    --------------------------------------------------------------------
+//
+//    This file is part of Luna.
+//
+//    LUNA is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Luna is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Luna. If not, see <http://www.gnu.org/licenses/>.
+//
+//    Please see LICENSE.txt for more details.
+//
+//    --------------------------------------------------------------------
+
+#ifndef __LUNA_BITMASK_H__
+#define __LUNA_BITMASK_H__
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <stdint.h>
+
+//
+// Dense, growable bitset (64-bit words): used for epoch-level masks, where
+// bit 'i' is an epoch; combining and counting are done a word at a time
+//
+
+struct bitvec_t
+{
+
+  bool test( const int i ) const
+  {
+    const int k = i >> 6;
+    return k < w.size() && ( w[k] >> ( i & 63 ) & 1ULL );
+  }
+
+  void set( const int i )
+  {
+    const int k = i >> 6;
+    if ( k >= w.size() ) w.resize( k + 1 , 0ULL );
+    w[k] |= 1ULL << ( i & 63 );
+  }
+
+  // returns T if the bit was set
+  bool reset( const int i )
+  {
+    if ( ! test( i ) ) return false;
+    w[ i >> 6 ] &= ~( 1ULL << ( i & 63 ) );
+    return true;
+  }
+
+  int count() const
+  {
+    int c = 0;
+    for (int k=0; k<w.size(); k++) c += __builtin_popcountll( w[k] );
+    return c;
+  }
+
+  bool any() const
+  {
+    for (int k=0; k<w.size(); k++) if ( w[k] ) return true;
+    return false;
+  }
+
+  void clear() { w.clear(); }
+  
+  bitvec_t & operator|=( const bitvec_t & rhs )
+  {
+    if ( rhs.w.size() > w.size() ) w.resize( rhs.w.size() , 0ULL );
+    for (int k=0; k<rhs.w.size(); k++) w[k] |= rhs.w[k];
+    return *this;
+  }
+
+  bitvec_t & operator&=( const bitvec_t & rhs )
+  {
+    if ( w.size() > rhs.w.size() ) w.resize( rhs.w.size() );
+    for (int k=0; k<w.size(); k++) w[k] &= rhs.w[k];
+    return *this;
+  }
+
+  // all set bits, in order
+  std::vector<int> members() const
+  {
+    std::vector<int> r;
+    for (int k=0; k<w.size(); k++)
+      {
+	uint64_t x = w[k];
+	while ( x )
+	  {
+	    r.push_back( ( k << 6 ) + __builtin_ctzll( x ) );
+	    x &= x - 1;
+	  }
+      }
+    return r;
+  }
+  
+  std::vector<uint64_t> w;
+  
+};
+
+
+//
+// Channel x epoch (CHEP) mask: one bit-row per channel label, where epochs
+// are in the 1-based display encoding
+//
+
+struct chep_mask_t
+{
+
+  void set( const int e , const std::string & ch ) { rows[ row( ch ) ].set( e ); }
+
+  // returns T if anything was unset
+  bool unset( const int e , const std::string & ch )
+  {
+    std::map<std::string,int>::const_iterator ii = idx.find( ch );
+    return ii != idx.end() && rows[ ii->second ].reset( e );
+  }
+
+  bool test( const int e , const std::string & ch ) const
+  {
+    std::map<std::string,int>::const_iterator ii = idx.find( ch );
+    return ii != idx.end() && rows[ ii->second ].test( e );
+  }
+
+  // all epochs for this channel
+  const bitvec_t * channel( const std::string & ch ) const
+  {
+    std::map<std::string,int>::const_iterator ii = idx.find( ch );
+    return ii == idx.end() ? NULL : &rows[ ii->second ];
+  }
+
+  // epochs with 1+ masked channel
+  bitvec_t epochs() const
+  {
+    bitvec_t r;
+    for (int c=0; c<rows.size(); c++) r |= rows[c];
+    return r;
+  }
+
+  // number of masked channels (of those given) in epoch e
+  int count( const int e , const std::vector<std::string> & chs ) const
+  {
+    int c = 0;
+    for (int i=0; i<chs.size(); i++) c += test( e , chs[i] );
+    return c;
+  }
+
+  bool empty() const
+  {
+    for (int c=0; c<rows.size(); c++) if ( rows[c].any() ) return false;
+    return true;
+  }
+
+  void clear() { idx.clear(); labels.clear(); rows.clear(); }
+
+  void merge( const chep_mask_t & rhs )
+  {
+    for (int c=0; c<rhs.rows.size(); c++)
+      rows[ row( rhs.labels[c] ) ] |= rhs.rows[c];
+  }
+
+  // channel labels (in order first seen)
+  std::vector<std::string> labels;
+
+  std::vector<bitvec_t> rows;
+  
+ private:
+
+  int row( const std::string & ch )
+  {
+    std::map<std::string,int>::const_iterator ii = idx.find( ch );
+    if ( ii != idx.end() ) return ii->second;
+    const int r = rows.size();
+    idx[ ch ] = r;
+    labels.push_back( ch );
+    rows.resize( r + 1 );
+    return r;
+  }
+  
+  std::map<std::string,int> idx;
+
+};
+
+#endif
@@ -24,6 +24,12 @@
 
 #include "db/db.h"
 #include "helper/logger.h"
+#include "defs/defs.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
 
 extern writer_t writer;
 extern logger_t logger;
@@ -273,3 +279,172 @@ void caches_t::import( const std::string & filename ,
 }
 
 
+
+
+
+//
+// dcache_t : persistent on-disk cache
+//
+
+static const char * dcache_magic = "LUNADC01";
+
+bool dcache_t::active()
+{
+  return globals::cache_folder != "";
+}
+
+
+uint64_t dcache_t::edf_signature( const std::string & f )
+{
+  
+  std::map<std::string,uint64_t>::const_iterator ii = edfsigs.find( f );
+  if ( ii != edfsigs.end() ) return ii->second;
+
+  // header, file size and first/last 64kb of the file: i.e. any edit
+  // to the header, or any re-written/truncated file, will change the
+  // signature, without reading the whole file; also fold in the
+  // modification time and inode, so that an in-place edit of the
+  // records (same size) is not missed
+
+  uint64_t h = cache_hash_init;
+
+  struct stat st;
+  if ( stat( f.c_str() , &st ) == 0 )
+    {
+      h = cache_hash( (uint64_t)st.st_mtime , h );
+      h = cache_hash( (uint64_t)st.st_ino , h );
+    }
+  
+  FILE * in = fopen( f.c_str() , "rb" );
+  if ( in != NULL )
+    {
+      const size_t blk = 65536;
+      std::vector<char> buf( blk );
+      
+      fseek( in , 0 , SEEK_END );
+      const uint64_t sz = ftell( in );
+      h = cache_hash( sz , h );
+      
+      fseek( in , 0 , SEEK_SET );
+      size_t n = fread( &buf[0] , 1 , blk , in );
+      h = cache_hash( &buf[0] , n , h );
+      
+      if ( sz > blk )
+	{
+	  fseek( in , sz > 2 * blk ? sz - blk : blk , SEEK_SET );
+	  n = fread( &buf[0] , 1 , blk , in );
+	  h = cache_hash( &buf[0] , n , h );
+	}
+      fclose( in );
+    }
+  else // e.g. in-memory EDF: nothing to key on but the name
+    h = cache_hash( f , h );
+  
+  edfsigs[ f ] = h;
+  return h;
+}
+
+
+uint64_t dcache_t::key( const std::string & edf_filename , 
+			const std::string & cmd , 
+			const std::string & ch , 
+			const std::string & params , 
+			const uint64_t state )
+{
+  uint64_t h = edf_signature( edf_filename );
+  h = cache_hash( hist , h );
+  h = cache_hash( cmd , h );
+  h = cache_hash( ch , h );
+  h = cache_hash( params , h );
+  h = cache_hash( state , h );
+  return h;
+}
+
+
+std::string dcache_t::filename( const uint64_t key , bool mk ) const
+{
+  char hex[17];
+  snprintf( hex , 17 , "%016llx" , (unsigned long long)key );
+  const std::string sub = globals::cache_folder + globals::folder_delimiter + std::string( hex , 2 );
+  
+  if ( mk && ! Helper::fileExists( sub ) )
+    {
+      std::string syscmd = globals::mkdir_command + " " + sub ;
+      int dummy = system( syscmd.c_str() );
+    }
+  
+  return sub + globals::folder_delimiter + hex + ".dcache";
+}
+
+
+bool dcache_t::fetch( const uint64_t key , std::vector<std::vector<double> > * data ) const
+{
+  
+  data->clear();
+  
+  FILE * in = fopen( filename( key ).c_str() , "rb" );
+  if ( in == NULL ) return false;
+
+  // format: magic, key, nrows, then for each row: length + values
+
+  char magic[8];
+  uint64_t key2 = 0 , nrows = 0;
+  bool okay = fread( magic , 1 , 8 , in ) == 8 
+    && memcmp( magic , dcache_magic , 8 ) == 0 
+    && fread( &key2 , sizeof(uint64_t) , 1 , in ) == 1 
+    && key2 == key 
+    && fread( &nrows , sizeof(uint64_t) , 1 , in ) == 1 ;
+  
+  if ( okay )
+    {
+      data->resize( nrows );
+      for (uint64_t r=0; r<nrows && okay; r++)
+	{
+	  uint64_t n = 0;
+	  okay = fread( &n , sizeof(uint64_t) , 1 , in ) == 1;
+	  if ( ! okay ) break;
+	  (*data)[r].resize( n );
+	  if ( n ) okay = fread( &(*data)[r][0] , sizeof(double) , n , in ) == n;
+	}
+    }
+  
+  fclose( in );
+  
+  // a truncated/bad entry is treated as a miss (and will be rewritten)
+  if ( ! okay ) data->clear();
+  
+  return okay;
+}
+
+
+void dcache_t::store( const uint64_t key , const std::vector<std::vector<double> > & data ) const
+{
+
+  // write to a temporary, then rename, so that concurrent runs never
+  // see a partial entry
+  
+  const std::string f = filename( key , true );
+  const std::string tmp = f + "." + Helper::int2str( (int)getpid() ) + ".tmp";
+
+  FILE * out = fopen( tmp.c_str() , "wb" );
+  if ( out == NULL ) 
+    {
+      logger << "  ** warning: could not write to cache-dir " << globals::cache_folder << "\n";
+      return;
+    }
+
+  fwrite( dcache_magic , 1 , 8 , out );
+  fwrite( &key , sizeof(uint64_t) , 1 , out );
+  const uint64_t nrows = data.size();
+  fwrite( &nrows , sizeof(uint64_t) , 1 , out );
+  for (uint64_t r=0; r<nrows; r++)
+    {
+      const uint64_t n = data[r].size();
+      fwrite( &n , sizeof(uint64_t) , 1 , out );
+      if ( n ) fwrite( &data[r][0] , sizeof(double) , n , out );
+    }
+  
+  fclose( out );
+
+  rename( tmp.c_str() , f.c_str() );
+}
@@ -27,7 +27,9 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <stdint.h>
 #include "helper/helper.h"
 
 // a temporary store that can be used for different commands to communicate to each other
@@ -51,41 +53,107 @@
 
 void ctest();
 
+
+//
+// 64-bit FNV-1a hashes, used to intern cache keys (ckey_t) and to key the
+// persistent on-disk cache (dcache_t)
+//
+
+static const uint64_t cache_hash_init = 14695981039346656037ULL;
+
+inline uint64_t cache_hash( const void * p , const size_t n , uint64_t h = cache_hash_init )
+{
+  const unsigned char * c = (const unsigned char*)p;
+  for (size_t i=0; i<n; i++) { h ^= c[i]; h *= 1099511628211ULL; }
+  return h;
+}
+
+inline uint64_t cache_hash( const std::string & s , uint64_t h = cache_hash_init )
+{
+  // include length, so that ("ab","c") and ("a","bc") differ
+  const uint64_t n = s.size();
+  h = cache_hash( &n , sizeof(uint64_t) , h );
+  return cache_hash( s.data() , s.size() , h );
+}
+
+inline uint64_t cache_hash( const uint64_t x , uint64_t h = cache_hash_init )
+{
+  return cache_hash( &x , sizeof(uint64_t) , h );
+}
+
+
 struct ckey_t {
   
   ckey_t( const std::string & name , const std::map<std::string,std::string> & stratum )
     : name( name ) , stratum( stratum )
   {
+    rehash();
   }
   
   ckey_t( const std::string & name ) : name( name )
   {
+    rehash();
   }
   
   void add( const std::string & key , const std::string & val )
   {
     stratum[key] = val;
+    rehash();
   }
   
   void add( const std::string & key , const int & val )
   {
     stratum[key] = Helper::int2str( val );
+    rehash();
   }
   
   void add( const std::string & key , const double & val )
   {
     stratum[key] = Helper::dbl2str( val );
+    rehash();
   }
   
   void add( const std::string & key , const bool val )
   {
     stratum[key] = Helper::int2str( val );
+    rehash();
   } 
   
   std::string name;
 
+  const std::map<std::string,std::string> & strata() const { return stratum; }
+  
+private:
+  
+  // only set via the ctor or add(), so that h is always current
   std::map<std::string,std::string> stratum;
+
+  // interned key: hash of name + stratum, set on any change
+  uint64_t h;
+
+  void rehash()
+  {
+    h = cache_hash( name );
+    std::map<std::string,std::string>::const_iterator ii = stratum.begin();
+    while ( ii != stratum.end() )
+      {
+	h = cache_hash( ii->first , h );
+	h = cache_hash( ii->second , h );
+	++ii;
+      }
+  }
+
+public:
   
+  // interned hash, for lookups (see cache_t::find())
+  uint64_t hash() const { return h; }
+  
+  bool operator==(const ckey_t & rhs ) const {
+    return h == rhs.h && name == rhs.name && stratum == rhs.stratum;
+  }
+
+  // nb. keep (label-based) lexicographic order, as callers iterate over
+  // keys, e.g. to emit strata in a fixed order
   bool operator<(const ckey_t & rhs ) const {
     if ( name < rhs.name ) return true;
     if ( name > rhs.name ) return false;
@@ -115,15 +183,30 @@ struct cache_t {
 
   cache_t( const std::string & name ) : name(name) { }   
 
+  cache_t( const cache_t & rhs ) : name( rhs.name ) , store( rhs.store ) { reindex(); } 
+
+  cache_t & operator=( const cache_t & rhs )
+  {
+    name = rhs.name;
+    store = rhs.store;
+    reindex();
+    return *this;
+  }
+  
   std::string name;
 
+  typedef typename std::map<ckey_t,std::vector<T> >::const_iterator store_iterator;
+  
   std::map<ckey_t,std::vector<T> > store;
 
   // member functions
   
   void add( const ckey_t & key , const std::vector<T> & value )
   {
-    store[key] = value;
+    std::pair<typename std::map<ckey_t,std::vector<T> >::iterator,bool> ii 
+      = store.insert( std::make_pair( key , value ) );
+    if ( ii.second ) index.insert( std::make_pair( key.hash() , store_iterator( ii.first ) ) );
+    else ii.first->second = value;
   }
 
   void add( const ckey_t & key , const T & value )
@@ -136,6 +219,17 @@ struct cache_t {
   void clear()
   {
     store.clear();
+    index.clear();
+  }
+
+  // lookup via the interned hash (only comparing keys on a hash match)
+  store_iterator find( const ckey_t & key ) const
+  {
+    typedef typename std::unordered_multimap<uint64_t,store_iterator>::const_iterator index_iterator;
+    std::pair<index_iterator,index_iterator> range = index.equal_range( key.hash() );
+    for ( index_iterator ii = range.first ; ii != range.second ; ++ii )
+      if ( ii->second->first == key ) return ii->second;
+    return store.end();
   }
 
   // get all keys matching a particular label
@@ -151,14 +245,14 @@ struct cache_t {
   }
 
   std::vector<T> size( const ckey_t & key ) const {
-    typename std::map<ckey_t,std::vector<T> >::const_iterator ii = store.find( key );
+    store_iterator ii = find( key );
     if ( ii == store.end() ) return 0;
     return ii->second.size();
   }
   
   
   std::vector<T> fetch( const ckey_t & key ) const {
-    typename std::map<ckey_t,std::vector<T> >::const_iterator ii = store.find( key );
+    store_iterator ii = find( key );
     if ( ii == store.end() )
       {
 	std::vector<T> dummy; return dummy; 
@@ -174,8 +268,8 @@ struct cache_t {
     while ( ss != store.end() )
       {
 	//	oo << "\t" << ss->first.name << "\n";
-	std::map<std::string,std::string>::const_iterator kk = ss->first.stratum.begin();
-	while ( kk != ss->first.stratum.end() )
+	std::map<std::string,std::string>::const_iterator kk = ss->first.strata().begin();
+	while ( kk != ss->first.strata().end() )
 	  {
 	    oo << "strata: " << kk->first << "=" << kk->second << "\n";
 	    ++kk;
@@ -188,18 +282,84 @@ struct cache_t {
       }
     return oo.str();
   }
-  
+
+private:
+
+  // interned hash --> entry in store (map iterators stay valid on insert)
+  std::unordered_multimap<uint64_t,store_iterator> index;
+
+  void reindex()
+  {
+    index.clear();
+    for ( store_iterator ii = store.begin() ; ii != store.end() ; ++ii )
+      index.insert( std::make_pair( ii->first.hash() , ii ) );
+  }
   
 };
 
 
 
+
+//
+// Persistent, content-addressed cache for expensive intermediates
+// (e.g. epoch-level PSD), opt-in via cache-dir=folder
+//
+
+// entries are keyed by a hash of: the EDF content signature (header
+// plus first/last data blocks, file size, mtime and inode), the
+// history of prior commands in this run (which determine the in-memory
+// signals and masks), the command, channel and any computation-specific
+// parameters; values are (ragged) matrices of doubles, stored one per file as
+// folder/ab/abcdef0123456789.dcache
+
+struct dcache_t {
+  
+  dcache_t() : hist( cache_hash_init ) { } 
+
+  // is a cache folder set?
+  static bool active();
+  
+  // reset command history (i.e. new EDF)
+  void reset() { hist = cache_hash_init; } 
+
+  // track each command in this run
+  void add_history( const std::string & cmd ) { hist = cache_hash( cmd , hist ); } 
+
+  // make key for (EDF, history, command, channel, parameters)
+  uint64_t key( const std::string & edf_filename , 
+		const std::string & cmd , 
+		const std::string & ch , 
+		const std::string & params , 
+		const uint64_t state = 0 );
+
+  // T if found; rows are returned in 'data'
+  bool fetch( const uint64_t key , std::vector<std::vector<double> > * data ) const;
+  
+  void store( const uint64_t key , const std::vector<std::vector<double> > & data ) const;
+
+private:
+
+  std::string filename( const uint64_t key , bool mk = false ) const;
+
+  // content signature for the EDF (memoized)
+  uint64_t edf_signature( const std::string & filename );
+  
+  std::map<std::string,uint64_t> edfsigs;
+
+  uint64_t hist;
+
+};
+
+
 //
 // hihgest level interface for caches (member of timeline_t)
 //
 
 struct caches_t {
 
+  // persistent (on-disk) cache; this is not cleared by clear()
+  dcache_t disk;
+
   std::map<std::string, cache_t<int> > cache_int;
   std::map<std::string, cache_t<double> > cache_num;  
   std::map<std::string, cache_t<std::string> > cache_str;  
@@ -1258,13 +1258,9 @@ std::vector<std::string> timeline_t::masked_channels( const int e0 , const signa
   //  std::cerr << " e , e0 = " << e << " " << e0 << "\n";
   std::vector<std::string> m;
   const int ns = signals.size();
-  bool any_masked = chep.find( e ) != chep.end() ;
-  if ( ! any_masked ) return m; // all good
-
-  const std::set<std::string> & masked = chep.find(e)->second ;
   for (int s=0; s<ns; s++) 
     {
-      if ( masked.find( signals.label(s) ) != masked.end() )
+      if ( chep.test( e , signals.label(s) ) )
 	m.push_back( signals.label(s) );
     }
   return m;
@@ -1278,18 +1274,9 @@ std::vector<std::string> timeline_t::unmasked_channels( const int e0 , const sig
 
   std::vector<std::string> u;
   const int ns = signals.size();
-  bool any_masked = chep.find( e ) != chep.end() ;
-  if ( ! any_masked ) 
-    {
-      // all good
-      for (int s=0; s<ns; s++) u.push_back( signals.label(s) );
-      return u; 
-    }
-
-  const std::set<std::string> & masked = chep.find(e)->second ;
   for (int s=0; s<ns; s++) 
     {
-      if ( masked.find( signals.label(s) ) == masked.end() )
+      if ( ! chep.test( e , signals.label(s) ) )
 	u.push_back( signals.label(s) );
     }
   return u;
@@ -1309,21 +1296,28 @@ void timeline_t::collapse_chep2epoch( signal_list_t signals , const double pct ,
   // if more than pct channels are masked --> set epoch mask [ default 0 ]
   // automatically adjust main 'mask' (using set_mask(), i.e. respecting mask_mode etc)
   
-  int epoch = 0; 
   int masked = 0;
-  int masks_set = 0;
 
-  std::map<int,std::set<std::string> >::iterator ee = chep.begin();
-  while ( ee != chep.end() )
+  // number of masked channels per (display) epoch, a row at a time
+  std::vector<int> sz;
+  for (int c=0; c<chep.rows.size(); c++)
+    {
+      const std::vector<int> eps = chep.rows[c].members();
+      for (int i=0; i<eps.size(); i++)
+	{
+	  if ( eps[i] >= sz.size() ) sz.resize( eps[i] + 1 , 0 );
+	  ++sz[ eps[i] ];
+	}
+    }
+  
+  for (int epoch=0; epoch<sz.size(); epoch++)
     {
       // **assume** same signals overlap
-
-      int sz = ee->second.size();
-
-      int epoch = ee->first;
-
-      if ( ( k != 0 && sz >= k ) || 
-	   ( sz / (double)signals.size() > pct ) ) 
+      
+      if ( sz[epoch] == 0 ) continue;
+      
+      if ( ( k != 0 && sz[epoch] >= k ) || 
+	   ( sz[epoch] / (double)signals.size() > pct ) ) 
 	{
 	  // change main epoch mask
 	  int epoch0 = display2curr_epoch( epoch );
@@ -1333,13 +1327,9 @@ void timeline_t::collapse_chep2epoch( signal_list_t signals , const double pct ,
 	    if ( set_epoch_mask( epoch0 ) ) ++masked;
 	  
 	  // and also set all CHEP masks (to signals) for this epoch
-	  for (int s=0;s<signals.size();s++) ee->second.insert( signals.label(s) );
+	  for (int s=0;s<signals.size();s++) chep.set( epoch , signals.label(s) );
 	  
 	}
-      
-      if ( mask[epoch] ) ++masks_set; 
-    
-      ++ee;
     }
   
   logger << masked << " epochs\n";
@@ -1380,16 +1370,10 @@ signal_list_t timeline_t::collapse_chep2ch( signal_list_t signals ,
     l2s[ signals.label(i) ] = signals(i);
 
 
-  std::map<int,std::set<std::string> >::const_iterator ee = chep.begin();
-  while ( ee != chep.end() )
+  for (int i=0; i<ns; i++)
     {
-      std::set<std::string>::const_iterator ss = ee->second.begin();
-      while ( ss != ee->second.end() )
-	{
-	  if ( c.find( *ss ) != c.end() ) c[ *ss ]++;
-	  ++ss;
-	}
-      ++ee;
+      const bitvec_t * b = chep.channel( signals.label(i) );
+      if ( b != NULL ) c[ signals.label(i) ] = b->count();
     }
   
   signal_list_t good_signals;
@@ -1425,7 +1409,7 @@ signal_list_t timeline_t::collapse_chep2ch( signal_list_t signals ,
 	  if ( good_sigs.find( label ) == good_sigs.end() ) 
 	    {
 	      logger << " " << label;
-	      for (int e=0;e<ne;e++) chep[ display_epoch( e ) ].insert( label );
+	      for (int e=0;e<ne;e++) chep.set( display_epoch( e ) , label );
 	    }
 	}
     }
@@ -1438,11 +1422,7 @@ signal_list_t timeline_t::collapse_chep2ch( signal_list_t signals ,
 	  const std::string label = signals.label(i);
 	  if ( good_sigs.find( label ) != good_sigs.end() ) 
 	    for (int e=0;e<ne;e++) 
-	      {
-		int e1 = display_epoch( e );
-		std::set<std::string>::iterator ii = chep[ e1 ].find( label );
-		if ( ii != chep[e1].end() ) chep[ e1 ].erase( ii );
-	      }
+	      chep.unset( display_epoch( e ) , label );
 	}
     }
 
@@ -1468,6 +1448,9 @@ void timeline_t::dump_chep_mask( signal_list_t signals , bool write_out )
   const int ns = signals.size();
   
   std::map<std::string,int> chtots;
+
+  // epochs with 1+ masked channel
+  const bitvec_t any = chep.epochs();
   
   while ( 1 ) 
     {
@@ -1485,7 +1468,7 @@ void timeline_t::dump_chep_mask( signal_list_t signals , bool write_out )
       if ( write_out )
 	writer.epoch( depoch );
 
-      if ( chep.find( depoch ) == chep.end() )
+      if ( ! any.test( depoch ) )
 	{
 	  for (int s=0;s<ns;s++)     
 	    {
@@ -1509,8 +1492,6 @@ void timeline_t::dump_chep_mask( signal_list_t signals , bool write_out )
 	  
 	  track_epochs[ depoch ]++;
 
-	  const std::set<std::string> & ss = chep.find( depoch )->second;
-
 	  for (int s=0;s<ns;s++)     
 	    {
 	      
@@ -1519,7 +1500,7 @@ void timeline_t::dump_chep_mask( signal_list_t signals , bool write_out )
 	      // track total
 	      ++total_total;
 	      
-	      bool masked = ss.find( label ) != ss.end() ;
+	      bool masked = chep.test( depoch , label );
 		  
 	      if ( write_out )
 		{
@@ -1629,7 +1610,7 @@ void timeline_t::read_chep_file( const std::string & f , bool reset )
       if ( FIN.eof() ) break;
       if ( ch == "" ) break;      
       int chn = edf->header.signal( ch , silent_mode );      
-      if ( chn != -1 ) chep[ e ].insert( ch );  // i.e. expecting display epoch encoding (1-based)
+      if ( chn != -1 ) chep.set( e , ch );  // i.e. expecting display epoch encoding (1-based)
     }
   
   FIN.close();
@@ -1639,19 +1620,20 @@ void timeline_t::write_chep_file( const std::string & f ) const
 {
   std::ofstream FOUT( f.c_str() , std::ios::out );
   if ( FOUT.bad() ) Helper::halt( "could not open " + f );
-  std::map<int,std::set<std::string> >::const_iterator ee = chep.begin();
-  while ( ee != chep.end() )
+
+  // by epoch, then channel label
+  std::set<std::string> chs( chep.labels.begin() , chep.labels.end() );
+  const std::vector<int> eps = chep.epochs().members();
+  for (int i=0; i<eps.size(); i++)
     {
-      const std::set<std::string> & chs = ee->second;
       std::set<std::string>::const_iterator cc = chs.begin();
       while ( cc != chs.end() )
 	{
-	  FOUT << ee->first << "\t" 
-	       << *cc << "\n";
-	  //	       << edf->header.label[ *cc ] << "\n";
+	  if ( chep.test( eps[i] , *cc ) )
+	    FOUT << eps[i] << "\t" 
+		 << *cc << "\n";
 	  ++cc;
 	}
-      ++ee;
     }
   FOUT.close();
 }
@@ -2420,7 +2402,7 @@ void timeline_t::annotate_epochs( const std::string & label ,
 	  if ( values.find( instance_idx.id ) != values.end() )
 	    {	      
 	      // nb. store w.r.t. original epoch encoding e0
-	      eannots[ label ][ e0 ] = true;
+	      eannots[ label ].set( e0 );
 	      break;
 	    }	      
 	  
@@ -3936,10 +3918,21 @@ void timeline_t::apply_eval_mask( const std::string & str , int mask_mode , cons
   
 
   //
-  // Get all existing annotations (overkill...)
+  // Parse the expression once (re-bound and evaluated for each epoch
+  // below); this is set to not allow any assignments.... this makes it
+  // cleaner and easier to spot bad//undefined variables as errors.
+  //
+
+  const bool no_assignments = true;
+      
+  Eval tok( expression , no_assignments );
+
+  
+  //
+  // Only extract annotations that the expression actually references
   //
   
-  std::vector<std::string> names = annotations.names();
+  std::vector<std::string> names = tok.referenced( annotations.names() );
 
 
   //
@@ -4002,15 +3995,9 @@ void timeline_t::apply_eval_mask( const std::string & str , int mask_mode , cons
       instance_t dummy;
       
       //
-      // evaluate the expression, but note, this is set to not 
-      // allow any assignments.... this makes it cleaner and easier 
-      // to spot bad//undefined variables as errors.
+      // evaluate the (pre-parsed) expression
       //
 
-      const bool no_assignments = true;
-      
-      Eval tok( expression , no_assignments );
-
       tok.bind( inputs , &dummy );
 
       bool is_valid = tok.evaluate( verbose );
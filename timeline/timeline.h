@@ -35,6 +35,7 @@
 #include "helper/logger.h"
 #include "timeline/hypno.h"
 #include "timeline/cache.h"
+#include "timeline/bitmask.h"
 
 #include "edf/signal-list.h"
 #include "defs/defs.h"
@@ -438,51 +439,22 @@ struct timeline_t
   
   static void proc_chep( edf_t & edf , param_t & param );
 
-  bool is_chep_mask_set() const { return chep.size() != 0; } 
+  bool is_chep_mask_set() const { return ! chep.empty(); } 
   
   void clear_chep_mask() { chep.clear(); } 
 
-  std::map<int,std::set<std::string> > make_chep_copy() const { return chep; }
+  chep_mask_t make_chep_copy() const { return chep; }
 
-  void set_chep_mask( const int e , const std::string & s ) { chep[ display_epoch( e ) ].insert(s); } 
+  void set_chep_mask( const int e , const std::string & s ) { chep.set( display_epoch( e ) , s ); } 
 
-  void merge_chep_mask( const std::map<int,std::set<std::string> > & m ) 
-  {
-    if ( chep.size() == 0 ) { chep = m ; return; } 
-    std::map<int,std::set<std::string> >::const_iterator ii = m.begin();
-    while ( ii != m.end() )
-      {
-	std::set<std::string>::const_iterator jj = ii->second.begin();
-	while ( jj != ii->second.end() )
-	  {
-	    chep[ ii->first ].insert( *jj );
-	    ++jj;
-	  }
-	++ii;
-      }
-  }
+  void merge_chep_mask( const chep_mask_t & m ) { chep.merge( m ); }
   
-
-  bool unset_chep_mask( const int e , const std::string & s ) 
-  { 
-    // return T if anything removed
-    int e1 = display_epoch( e );    
-    std::map<int,std::set<std::string> >::iterator ii = chep.find( e1 ) ;
-    if ( ii == chep.end() ) return false;
-    std::set<std::string>::iterator jj = ii->second.find( s );
-    if ( jj == ii->second.end() ) return false;
-    ii->second.erase( jj );
-    return true; 
-  } 
+  // return T if anything removed
+  bool unset_chep_mask( const int e , const std::string & s ) { return chep.unset( display_epoch( e ) , s ); } 
 
   void dump_chep_mask( signal_list_t , bool );
   
-  bool masked( const int e , const std::string & s ) const 
-  {
-    std::map<int,std::set<std::string> >::const_iterator ee = chep.find( display_epoch( e ) );
-    if ( ee == chep.end() ) return false;
-    return ee->second.find( s ) != ee->second.end() ;
-  }
+  bool masked( const int e , const std::string & s ) const { return chep.test( display_epoch( e ) , s ); }
 
   // save/load cheps
   void read_chep_file( const std::string & f , bool reset = true );
@@ -578,7 +550,7 @@ struct timeline_t
         e = epoch_curr2orig.find( e )->second;
       }
 
-    eannots[ label ][ e ] = true;
+    eannots[ label ].set( e );
   }
 
 
@@ -604,7 +576,7 @@ struct timeline_t
   std::set<std::string> epoch_annotations() const
   {
     std::set<std::string> r;
-    std::map<std::string,std::map<int,bool> >::const_iterator ii = eannots.begin();
+    std::map<std::string,bitvec_t>::const_iterator ii = eannots.begin();
     while ( ii != eannots.end() )
       {
 	r.insert( ii->first );
@@ -628,7 +600,7 @@ struct timeline_t
   {
 
     // look up this annotation 'k'
-    std::map<std::string,std::map<int,bool> >::const_iterator ii = eannots.find( k );
+    std::map<std::string,bitvec_t>::const_iterator ii = eannots.find( k );
 
     // annotation k does not exist anywhere
     if ( ii == eannots.end() ) return false;
@@ -642,12 +614,8 @@ struct timeline_t
 	e = epoch_curr2orig.find( e )->second;
       }
     
-    // now we have the correct original-EDF epoch number, do
-    // we have an flag? if not, means FALSE
-    if ( ii->second.find( e ) == ii->second.end() ) return false;
-
-    // return the boolean value (i.e. could still be set FALSE explicitly)
-    return ii->second.find( e )->second; 
+    // now we have the correct original-EDF epoch number
+    return ii->second.test( e );
   }
   
 
@@ -742,8 +710,8 @@ struct timeline_t
   
   int mask_mode;
   
-  // epoch -> ch ; presence implies mask set
-  std::map<int,std::set<std::string> > chep;
+  // ch x epoch bitmask (display epochs)
+  chep_mask_t chep;
   
   // epoch to record mapping
   std::map<int,std::set<int> > epoch2rec;
@@ -760,8 +728,8 @@ struct timeline_t
   // type --> [ epoch-2-bool ]
   // where epoch is *always* with regard to the original value
   
-  // boolean epoch-based annotations
-  std::map<std::string,std::map<int,bool> > eannots;
+  // boolean epoch-based annotations (bit per epoch)
+  std::map<std::string,bitvec_t> eannots;
   
 };
 
@@ -165,3 +165,299 @@ void XML::parse( TiXmlNode* pNode , element_t * pGrandParent )
     }
 }
 
+
+
+//
+// Streaming reader
+//
+
+#include "helper/mapped.h"
+
+#include <cstring>
+
+static inline bool xml_space( const char c )
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static void xml_utf8( unsigned long ucs , std::string * out )
+{
+  if ( ucs < 0x80 ) 
+    *out += (char)ucs;
+  else if ( ucs < 0x800 )
+    {
+      *out += (char)( 0xC0 | ( ucs >> 6 ) );
+      *out += (char)( 0x80 | ( ucs & 0x3F ) );
+    }
+  else if ( ucs < 0x10000 )
+    {
+      *out += (char)( 0xE0 | ( ucs >> 12 ) );
+      *out += (char)( 0x80 | ( ( ucs >> 6 ) & 0x3F ) );
+      *out += (char)( 0x80 | ( ucs & 0x3F ) );
+    }
+  else
+    {
+      *out += (char)( 0xF0 | ( ( ucs >> 18 ) & 0x07 ) );
+      *out += (char)( 0x80 | ( ( ucs >> 12 ) & 0x3F ) );
+      *out += (char)( 0x80 | ( ( ucs >> 6 ) & 0x3F ) );
+      *out += (char)( 0x80 | ( ucs & 0x3F ) );
+    }
+}
+
+// decode the entity at p (*p == '&'), appending to out; returns the
+// number of characters consumed (unknown entities pass through as '&')
+static size_t xml_entity( const char * p , const char * end , std::string * out )
+{
+
+  const char * q = p + 1;
+  while ( q < end && q - p < 12 && *q != ';' && *q != '<' && *q != '&' ) ++q;
+
+  if ( q < end && *q == ';' )
+    {
+      const std::string ent( p + 1 , q );
+      
+      if      ( ent == "amp" )  { *out += '&';  return q - p + 1; }
+      else if ( ent == "lt" )   { *out += '<';  return q - p + 1; }
+      else if ( ent == "gt" )   { *out += '>';  return q - p + 1; }
+      else if ( ent == "quot" ) { *out += '"';  return q - p + 1; }
+      else if ( ent == "apos" ) { *out += '\''; return q - p + 1; }
+      else if ( ent.size() > 1 && ent[0] == '#' )
+	{
+	  const bool hex = ent[1] == 'x';
+	  unsigned long ucs = 0;
+	  bool okay = ent.size() > ( hex ? 2 : 1 );
+	  for (int i = hex ? 2 : 1 ; i < ent.size() ; i++)
+	    {
+	      const char c = ent[i];
+	      if ( c >= '0' && c <= '9' ) ucs = ucs * ( hex ? 16 : 10 ) + ( c - '0' );
+	      else if ( hex && c >= 'a' && c <= 'f' ) ucs = ucs * 16 + ( c - 'a' + 10 );
+	      else if ( hex && c >= 'A' && c <= 'F' ) ucs = ucs * 16 + ( c - 'A' + 10 );
+	      else { okay = false; break; }
+	    }
+	  if ( okay ) 
+	    {
+	      xml_utf8( ucs , out );
+	      return q - p + 1;
+	    }
+	}
+    }
+
+  *out += '&';
+  return 1;
+}
+
+// character data between tags: leading/trailing whitespace removed, and
+// internal runs of whitespace condensed to a single space (as TinyXML)
+static void xml_text( const char * p , const char * end , std::string * out )
+{
+  bool ws = false;
+  while ( p < end )
+    {
+      if ( xml_space( *p ) ) { ws = true; ++p; continue; }
+      if ( ws && out->size() ) *out += ' ';
+      ws = false;
+      if ( *p == '&' ) p += xml_entity( p , end , out );
+      else *out += *p++;
+    }
+}
+
+// position just past the next occurrence of tag (or NULL)
+static const char * strstr_end( const char * p , const char * end , const char * tag )
+{
+  const size_t n = strlen( tag );
+  while ( p + n <= end )
+    {
+      const char * q = (const char*)memchr( p , tag[0] , end - p );
+      if ( q == NULL || q + n > end ) return NULL;
+      if ( memcmp( q , tag , n ) == 0 ) return q + n;
+      p = q + 1;
+    }
+  return NULL;
+}
+
+bool xml_stream_t::read( const std::string & filename , xml_handler_t * handler )
+{
+
+  mapped_file_t mf;
+  if ( ! mf.open( filename ) ) return false;
+
+  const char * p = mf.data;
+  const char * end = mf.data + mf.len;
+
+  // skip any UTF-8 byte-order mark
+  if ( mf.len >= 3 && (unsigned char)p[0] == 0xEF && (unsigned char)p[1] == 0xBB && (unsigned char)p[2] == 0xBF ) 
+    p += 3;
+  
+  element_t root( "Document" );
+  element_t * current = &root;
+
+  // reused for text and attributes
+  std::string text;
+  
+  bool okay = true;
+  
+  while ( p < end )
+    {
+
+      //
+      // character data
+      //
+      
+      if ( *p != '<' )
+	{
+	  const char * q = (const char*)memchr( p , '<' , end - p );
+	  if ( q == NULL ) q = end;
+	  if ( current != &root )
+	    {
+	      text.clear();
+	      xml_text( p , q , &text );
+	      if ( text.size() ) current->value = text;
+	    }
+	  p = q;
+	  continue;
+	}
+
+      //
+      // markup
+      //
+
+      const size_t left = end - p;
+      
+      // declaration / processing instruction
+      if ( left > 1 && p[1] == '?' )
+	{
+	  const char * q = strstr_end( p + 2 , end , "?>" );
+	  if ( q == NULL ) { okay = false; break; }
+	  p = q;
+	  continue;
+	}
+
+      // comment
+      if ( left > 3 && p[1] == '!' && p[2] == '-' && p[3] == '-' )
+	{
+	  const char * q = strstr_end( p + 4 , end , "-->" );
+	  if ( q == NULL ) { okay = false; break; }
+	  p = q;
+	  continue;
+	}
+
+      // CDATA (kept verbatim)
+      if ( left > 8 && strncmp( p , "<![CDATA[" , 9 ) == 0 )
+	{
+	  const char * q = strstr_end( p + 9 , end , "]]>" );
+	  if ( q == NULL ) { okay = false; break; }
+	  if ( current != &root )
+	    current->value = std::string( p + 9 , q - 3 );
+	  p = q;
+	  continue;
+	}
+
+      // DOCTYPE etc: skipped
+      if ( left > 1 && p[1] == '!' )
+	{
+	  const char * q = (const char*)memchr( p , '>' , left );
+	  if ( q == NULL ) { okay = false; break; }
+	  p = q + 1;
+	  continue;
+	}
+      
+      // end-tag
+      if ( left > 1 && p[1] == '/' )
+	{
+	  const char * n = p + 2;
+	  const char * q = n;
+	  while ( q < end && *q != '>' && ! xml_space( *q ) ) ++q;
+	  if ( current == &root || current->name.compare( 0 , std::string::npos , n , q - n ) != 0 ) 
+	    { okay = false; break; }
+	  q = (const char*)memchr( q , '>' , end - q );
+	  if ( q == NULL ) { okay = false; break; }
+	  p = q + 1;
+
+	  element_t * e = current;
+	  current = e->parent;
+	  if ( ! handler->close( e ) )
+	    {
+	      current->child.pop_back();
+	      delete e;
+	    }
+	  continue;
+	}
+
+      //
+      // start-tag: name, then attributes
+      //
+
+      const char * n = p + 1;
+      const char * q = n;
+      while ( q < end && *q != '>' && *q != '/' && ! xml_space( *q ) ) ++q;
+      if ( q == n || q == end ) { okay = false; break; }
+
+      element_t * e = new element_t( std::string( n , q ) , current );
+      
+      bool empty = false;
+
+      while ( 1 )
+	{
+	  while ( q < end && xml_space( *q ) ) ++q;
+	  if ( q == end ) { okay = false; break; }
+	  if ( *q == '>' ) { ++q; break; }
+	  if ( *q == '/' ) 
+	    {
+	      if ( q + 1 == end || q[1] != '>' ) { okay = false; break; }
+	      q += 2;
+	      empty = true;
+	      break;
+	    }
+
+	  // key = "value" or 'value'
+	  const char * k = q;
+	  while ( q < end && *q != '=' && *q != '>' && *q != '/' && ! xml_space( *q ) ) ++q;
+	  const std::string key( k , q );
+	  while ( q < end && xml_space( *q ) ) ++q;
+	  if ( q == end || *q != '=' ) { okay = false; break; }
+	  ++q;
+	  while ( q < end && xml_space( *q ) ) ++q;
+	  if ( q == end || ( *q != '"' && *q != '\'' ) ) { okay = false; break; }
+	  const char quote = *q++;
+	  const char * v = (const char*)memchr( q , quote , end - q );
+	  if ( v == NULL ) { okay = false; break; }
+
+	  // attribute values keep whitespace, but entities are decoded
+	  text.clear();
+	  while ( q < v ) 
+	    {
+	      if ( *q == '&' ) q += xml_entity( q , v , &text );
+	      else text += *q++;
+	    }
+	  e->attr.add( key , text );
+	  q = v + 1;
+	}
+
+      if ( ! okay ) break;
+
+      p = q;
+      
+      handler->open( e );
+
+      if ( empty )
+	{
+	  if ( ! handler->close( e ) )
+	    {
+	      current->child.pop_back();
+	      delete e;
+	    }
+	}
+      else
+	current = e;
+      
+    }
+
+  // all elements closed?
+  if ( current != &root ) okay = false;
+
+  // anything kept is still attached under root
+  if ( okay ) handler->finish( &root );
+  
+  return okay;
+  
+}
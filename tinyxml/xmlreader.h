@@ -69,6 +69,36 @@ class XML
   
 };
 
+//
+// Streaming (SAX-style) alternative to XML: no document is held in
+// memory; each element is assembled only while it is open, and is
+// handed to the handler when its end-tag is reached
+//
+
+struct xml_handler_t
+{
+  virtual ~xml_handler_t() { }
+
+  // start-tag seen: name and attributes are set, but no value/children yet
+  virtual void open( const element_t * e ) { }
+
+  // end-tag seen: return true to keep this element attached to its
+  // parent (i.e. the parent will see it on close); otherwise it is
+  // freed immediately
+  virtual bool close( element_t * e ) { return true; }
+
+  // end of (well-formed) document: root holds all kept elements
+  virtual void finish( element_t * root ) { }
+  
+};
+
+struct xml_stream_t
+{
+  // false if the file cannot be read, or is not well-formed; element values
+  // follow XML/TinyXML (whitespace condensed, entities decoded)
+  static bool read( const std::string & filename , xml_handler_t * handler );
+};
+
 struct attr_t 
 {
   void add( const std::string & key , const std::string & value )
@@ -38,9 +38,10 @@ int main(int argc , char ** argv )
   
   if ( argc != 3 ) 
     { 
-      std::cerr << "usage: ./loadss {ss.db} {-a|-e|-i|index|unindex} < input\n"
+      std::cerr << "usage: ./loadss {ss.db} {-a|-e|-p|-i|index|unindex} < input\n"
 		<< "where ss.db      --> sstore_t database file\n"
 		<< "      [-a|-e|-i] --> to specify baseline/epoch-level/interval-level data\n"	
+		<< "      -p         --> epoch-level numeric data, packed as one array per ID/LVL/CH\n"	
 		<< "      input      --> as prepared by prepss\n"
 		<< "\n";          
       std::exit(1); 
@@ -52,7 +53,7 @@ int main(int argc , char ** argv )
   //
   
   // all      :   ID LVL CH              N VALUE(S)
-  // epoch    :   ID LVL CH  E           N VALUE(S)
+  // epoch    :   ID LVL CH  E           N VALUE(S)   [ also -p ]
   // interval :   ID LVL CH  START STOP  N VALUE(S)
   
   
@@ -82,11 +83,15 @@ int main(int argc , char ** argv )
   bool mode_baseline = mode == "-a";
   bool mode_epoch    = mode == "-e";
   bool mode_interval = mode == "-i";
+  bool mode_packed   = mode == "-p";
   
-  if ( ! ( mode_baseline || mode_epoch || mode_interval ) ) 
+  if ( ! ( mode_baseline || mode_epoch || mode_interval || mode_packed ) ) 
     {
-      Helper::halt( "mode argument should be -a, -e or -i" );
+      Helper::halt( "mode argument should be -a, -e, -p or -i" );
     }
+
+  // packed mode: collate all epochs (per key) then insert as single rows
+  std::map<sstore_key_t,std::map<int,std::vector<double> > > packed;
   
   //
   // Open/create sstore_t
@@ -164,7 +169,7 @@ int main(int argc , char ** argv )
       // Epoch-level inputs 
       //
 
-      if ( mode_epoch ) 
+      if ( mode_epoch || mode_packed ) 
 	{
 	  
 	  if ( t < 6 ) Helper::halt( "format problem:\n" + line );
@@ -186,8 +191,17 @@ int main(int argc , char ** argv )
 
 	  const std::string * level_ptr = has_level ? &(tok)[1] : NULL ; 
 	  const std::string * channel_ptr = has_channel ? &(tok)[2] : NULL ; 
-	  
-	  if ( n == 0 ) // text
+
+	  if ( mode_packed )
+	    {
+	      if ( n == 0 ) Helper::halt( "expecting numeric values for -p:\n" + line );
+	      std::vector<double> & d = packed[ sstore_key_t( tok[0] , tok[1] , tok[2] ) ][ e ];
+	      d.resize( n );
+	      for (int i=0;i<n;i++)
+		if ( ! Helper::str2dbl( tok[5+i] , &(d)[i] ) ) 
+		  Helper::halt( "format problem, expecting double:\n" + line );
+	    }
+	  else if ( n == 0 ) // text
 	    {
 	      ss.insert_epoch( e , tok[0] , tok[5] , channel_ptr , level_ptr );	      
 	    }
@@ -274,6 +288,15 @@ int main(int argc , char ** argv )
       
       // next row of input
     }
+
+  std::map<sstore_key_t,std::map<int,std::vector<double> > >::const_iterator kk = packed.begin();
+  while ( kk != packed.end() )
+    {
+      const std::string * level_ptr = kk->first.lvl != "." ? &(kk->first.lvl) : NULL ; 
+      const std::string * channel_ptr = kk->first.ch != "." ? &(kk->first.ch) : NULL ; 
+      ss.insert_epoch_array( kk->first.id , kk->second , channel_ptr , level_ptr );
+      ++kk;
+    }
     
   std::cerr << "indexing... ";
     
@@ -32,6 +32,11 @@
 #include <fstream>
 #include <iomanip>
 #include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+#include <sstream>
+#include <unistd.h>
 
 int fn_process_data_dictionary( const char * fpath, const struct stat *ptr, int type );
 
@@ -39,6 +44,8 @@ int fn_process_study_data( const char * fpath, const struct stat *ptr, int type
 
 dataset_t data;
 
+std::vector<std::string> study_files;
+
 options_t options;
 
 int main( int argc , char ** argv )
@@ -101,6 +108,31 @@ int main( int argc , char ** argv )
 	  // enforce numeric strata encoding
 	  if ( key == "ns" )
 	    options.numeric_strata_encoding = true;
+
+	  // worker threads for parsing data files
+	  if ( key == "t" )
+	    {
+	      if ( n != 2 || ! str2int( val , &options.nthreads ) || options.nthreads < 1 )
+		halt("problem with format of option " + t );
+	    }
+
+	  // bounded memory: spill values to disk (-stream, -tmp=DIR, -mem=N)
+	  if ( key == "stream" )
+	    options.stream = true;
+
+	  if ( key == "tmp" )
+	    {
+	      if ( n != 2 ) halt("problem with format of option " + t );
+	      options.tmp_root = val;
+	      options.stream = true;
+	    }
+	  
+	  if ( key == "mem" )
+	    {
+	      if ( n != 2 || ! str2int( val , &options.max_values ) || options.max_values < 1 )
+		halt("problem with format of option " + t );
+	      options.stream = true;
+	    }
 	}
 
     }
@@ -121,17 +153,32 @@ int main( int argc , char ** argv )
   //
   // Step 2. Read data-files
   //
+
+  // nb. runs are named by PID, so that concurrent dmerge jobs can share
+  // the same -tmp folder
+  
+  if ( options.stream )
+    {
+      std::stringstream ss;
+      ss << ( options.tmp_root != "" 
+	      ? expand( options.tmp_root ) + "/dmerge" 
+	      : outfile + ".tmp" ) 
+	 << "." << getpid();
+      data.spill = new spill_t( ss.str() , options.max_values );
+    }
   
   if ( ftw( expand( study_dir ).c_str() , fn_process_study_data, 10 ) != 0 )
     halt( "problem traversing folder " + study_dir );
 
+  data.read( study_files );
+  
   
   //
   // Step 3. Output
   //
 
   // nothing to do?
-  if ( data.xvars.size() == 0 || data.indivs.size() == 0 )
+  if ( data.xvars.size() == 0 || data.n_indivs() == 0 )
     halt( "no data (variables and/or individuals) available for output" );
 
   // enforce varl length check ( -ml=999, default is 100)
@@ -145,7 +192,7 @@ int main( int argc , char ** argv )
   // All done
   //
 
-  std::cerr << "finished: processed " << data.indivs.size() 
+  std::cerr << "finished: processed " << data.n_indivs() 
 	    << " individuals across " << data.files.size() 
 	    << " files, yielding " << data.xvars.size() 
 	    << " (expanded) variables\n";
@@ -188,7 +235,7 @@ int fn_process_study_data( const char * fpath, const struct stat *ptr, int type
       // ignore back up files ending ~
       if ( filename[ filename.size() - 1 ] != '~' )
 	{      	  
-	  data.read( filename );
+	  study_files.push_back( filename );
 	}
     }  
   return 0;
@@ -349,8 +396,131 @@ int domain_t::read( const std::string & filename )
 //
 
 void dataset_t::read( const std::string & filename )
+{
+  parsed_file_t pf( filename );
+  parse_file( &pf );
+  add( pf );
+}
+
+
+void dataset_t::read( const std::vector<std::string> & filenames )
+{
+
+  const int nt = options.nthreads;
+  
+  if ( nt == 1 )
+    {
+      for (int i=0; i<filenames.size(); i++)
+	read( filenames[i] );
+      return;
+    }
+
+  //
+  // files are parsed concurrently, in batches (to bound memory), and
+  // then added in their original order, so that the output (including
+  // any numeric strata encoding) is as for a single thread
+  //
+  
+  const int batch = 4 * nt;
+
+  for (int b=0; b<filenames.size(); b+=batch)
+    {
+      
+      const int n = std::min( batch , (int)filenames.size() - b );
+      
+      std::vector<parsed_file_t*> pf( n );
+      for (int i=0; i<n; i++)
+	pf[i] = new parsed_file_t( filenames[ b + i ] );
+      
+      std::vector<std::thread> workers;
+      for (int t=0; t<nt && t<n; t++)
+	workers.push_back( std::thread( [this,&pf,t,nt,n]() {
+	      for (int i=t; i<n; i+=nt)
+		parse_file( pf[i] );
+	    } ) );
+      
+      for (int t=0; t<workers.size(); t++)
+	workers[t].join();
+      
+      for (int i=0; i<n; i++)
+	{
+	  add( *pf[i] );
+	  delete pf[i];
+	}
+    }
+}
+
+
+void dataset_t::add( parsed_file_t & pf )
 {
 
+  std::cerr << pf.log.str();
+  
+  //
+  // track files actually read
+  //
+
+  if ( pf.tracked )
+    files.insert( pf.filename );
+  
+  if ( ! pf.added ) return;
+
+  //
+  // add values, either directly or to the spill store
+  //
+  
+  indiv_t indiv( pf.id );
+
+  const int id = spill != NULL ? spill->id( pf.id ) : 0 ;
+  
+  for (int r=0; r<pf.rows.size(); r++)
+    {
+      const parsed_row_t & row = pf.rows[r];
+      
+      for (int i=0; i<row.cells.size(); i++)
+	{
+	  const parsed_cell_t & cell = row.cells[i];
+
+	  // get expanded variable
+	  var_t xv = xvar( *cell.var , pf.facs , row.lvls );
+
+	  // missing value?
+	  if ( cell.missing ) continue;
+	  
+	  // insert
+	  if ( spill != NULL )
+	    spill->add( id , spill->var( xv.name ) , cell.value );
+	  else
+	    indiv.add( xv , value_t( cell.value ) );
+
+	  // and track
+	  obscount[ xv.name ]++;
+	}
+    }
+
+  //
+  // merge new data w/ existing
+  //
+  
+  if ( spill == NULL )
+    add( indiv );
+
+  std::cerr << pf.report.str();
+  
+}
+
+
+void dataset_t::parse_file( parsed_file_t * pf ) const
+{
+
+  // nb. as this may be called from worker threads, only the
+  // dictionaries and options are read here, and all messages are
+  // buffered; everything else is done in add( parsed_file_t & )
+
+  const std::string & filename = pf->filename;
+  std::stringstream & log = pf->log;
+  
+
 
   //
   // Only consider .txt files?
@@ -363,7 +533,7 @@ void dataset_t::read( const std::string & filename )
 
 
   if ( options.verbose )
-    std::cerr << "reading " << filename << "\n";
+    log << "reading " << filename << "\n";
 
   // expecting 
   
@@ -389,7 +559,7 @@ void dataset_t::read( const std::string & filename )
 
   if ( options.skip_folders.find( folder_indiv_id ) != options.skip_folders.end() )
     {
-      std::cerr << " -- skipping " << filename << "\n";
+      log << " -- skipping " << filename << "\n";
       return;
     }
   
@@ -408,14 +578,14 @@ void dataset_t::read( const std::string & filename )
 
   if ( tok3.size() < 3 )
     {
-      std::cerr << "found " << tok3.size() << " '_'-delimited items, expecting at least 3: " << fname << "\n";
+      log << "found " << tok3.size() << " '_'-delimited items, expecting at least 3: " << fname << "\n";
       
       if ( options.strict )
 	halt( "err1: expecting {domain}_{group}_{tag-name}{_fac1}{_fac2}{_f3-l3}{.txt}\n" );
       
       // ignore this file
       if ( options.verbose )
-	std::cerr << " -- skipping (unrecognized name convention): " << filename << "\n";
+	log << " -- skipping (unrecognized name convention): " << filename << "\n";
       return;
     }
 
@@ -427,7 +597,7 @@ void dataset_t::read( const std::string & filename )
   std::string group_name = tok3[1];
 
   if ( options.verbose )
-    std::cerr << "looking for domain::group " << domain_name << "::" << group_name << "\n";
+    log << "looking for domain::group " << domain_name << "::" << group_name << "\n";
   
   const domain_t * domain = data.domain( domain_name , group_name );
   if ( domain == NULL ) {
@@ -446,7 +616,7 @@ void dataset_t::read( const std::string & filename )
 	    + "]\n --> searching for that based on data file " + filename + "\n" + ss.str() );
     
     if ( options.verbose )
-      std::cerr << "could not find a dictionary for [" << domain_name << "] :: [" << group_name << "]\n"
+      log << "could not find a dictionary for [" << domain_name << "] :: [" << group_name << "]\n"
 		<< " --> searching for that based on data file " << filename << "\n";
     
     // give up on this file
@@ -470,7 +640,7 @@ void dataset_t::read( const std::string & filename )
   // track files actually read
   //
 
-  files.insert( filename );
+  pf->tracked = true;
   
   //
   // domain-specific missing data code?
@@ -523,9 +693,9 @@ void dataset_t::read( const std::string & filename )
 	      if ( options.verbose ) 
 		{
 		  if ( factor != tokfl[0] )
-		    std::cerr << " ** when parsing " << filename << "\n  " << tokfl[0] << " ( --> " << factor<< ") not specified as a factor\n";
+		    log << " ** when parsing " << filename << "\n  " << tokfl[0] << " ( --> " << factor<< ") not specified as a factor\n";
 		  else
-		    std::cerr << " ** when parsing " << filename << "\n  " << factor << " not specified as a factor\n";		  
+		    log << " ** when parsing " << filename << "\n  " << factor << " not specified as a factor\n";		  
 		}
 	      // but either way, give up on this file
 	      return;
@@ -552,9 +722,8 @@ void dataset_t::read( const std::string & filename )
   // Read actual data
   //
 
-  std::set<var_t> vars;
-
-  indiv_t indiv( folder_indiv_id );
+  pf->id = folder_indiv_id;
+  pf->facs = facs;
   
   std::ifstream IN1( filename.c_str() , std::ios::in );
   bool had_header = false;
@@ -633,7 +802,7 @@ void dataset_t::read( const std::string & filename )
 	      // otherwise, assume this is not a valid 'results' file.. just give up on this file
 	      IN1.close();
 	      if ( options.verbose )
-		std::cerr << "  no ID header in " << filename << "... skipping\n";
+		log << "  no ID header in " << filename << "... skipping\n";
 
 	      return;
 	    }
@@ -689,7 +858,11 @@ void dataset_t::read( const std::string & filename )
 	  // get any factor levels
 	  //
 	  
-	  std::vector<std::string> lvls( facs.size() , "" );
+	  pf->rows.resize( pf->rows.size() + 1 );
+	  parsed_row_t & row = pf->rows.back();
+	  
+	  std::vector<std::string> & lvls = row.lvls;
+	  lvls.resize( facs.size() );
 	  
 	  for (int f=0;f<facs.size();f++)
 	    {
@@ -720,8 +893,10 @@ void dataset_t::read( const std::string & filename )
 
 	      if ( var == NULL ) halt( "internal error, could not relink col " + colvar[ i ] );
 	      
-	      // get expanded variable
-	      var_t xvar = data.xvar( *var , facs , lvls );
+	      // (expanded variable is registered in add(), even if missing)
+	      row.cells.resize( row.cells.size() + 1 );
+	      parsed_cell_t & cell = row.cells.back();
+	      cell.var = var;
 	      
 	      // missing value?
 	      if ( missing_code && domain->missing.find( tok[i] ) != domain->missing.end() ) continue;
@@ -729,19 +904,14 @@ void dataset_t::read( const std::string & filename )
 	      // also NA and '.' as missing codes
 	      if ( options.is_missing( tok[i] ) ) continue;
 
-	      // otheriwse, get value
-	      value_t value( tok[i] );
-
 	      // check value
 	      if ( ! type_check( tok[i] , var->type ) )
 		halt( "invalid value [" + tok[i] + "] for " + var->name
 		      + " (type " + var->print_type() + ")\n        in: " + filename );
 	      
-	      // insert	      
-	      indiv.add( xvar , value );
-
-	      // and track	      
-	      obscount[ xvar.name ]++;
+	      // otherwise, get value
+	      cell.missing = false;
+	      cell.value = tok[i];
 	    }
 	  
 	}      
@@ -756,41 +926,43 @@ void dataset_t::read( const std::string & filename )
 
   if ( ! had_header ) halt( "no header read for " + filename );
   
-  data.add( indiv );  
+  pf->added = true;
+
+  std::stringstream & report = pf->report;
   
-  std::cerr << " ++ read " << rows << " rows from data-file " << filename << "\n";
-  std::cerr << "      domain    [ " << domain_name << " ]\n"
+  report << " ++ read " << rows << " rows from data-file " << filename << "\n";
+  report << "      domain    [ " << domain_name << " ]\n"
 	    << "      group     [ " << group_name << " ]\n"
 	    << "      file-tag  [ " << tag_name << " ]\n";
 
   // report variables
 
-  std::cerr << "      variables [ ";
+  report << "      variables [ ";
   bool first = true;
   for (int i=0;i<colvar.size();i++)
     {
       if ( i == id_col ) continue;
       if ( setfac.find( colvar[i] ) != setfac.end() ) continue;
-      if ( ! first ) std::cerr << " | ";
-      std::cerr << colvar[i];
-      if ( donotread.find( i ) != donotread.end() ) std::cerr << " (skipped)";      
+      if ( ! first ) report << " | ";
+      report << colvar[i];
+      if ( donotread.find( i ) != donotread.end() ) report << " (skipped)";      
       first = false;
     }
-  std::cerr << " ]\n";
+  report << " ]\n";
 
   // report factors
   
-  std::cerr << "      factors   [";
+  report << "      factors   [";
   std::map<std::string,std::string>::const_iterator ff =  setfac.begin();
   while ( ff != setfac.end() )
     {
-      std::cerr << " " ;
-      if ( ff != setfac.begin() ) std::cerr << "| ";
-      std::cerr << ff->first;
-      if ( ff->second != "" ) std::cerr << " = " << ff->second;
+      report << " " ;
+      if ( ff != setfac.begin() ) report << "| ";
+      report << ff->first;
+      if ( ff->second != "" ) report << " = " << ff->second;
       ++ff;
     }
-  std::cerr << " ]\n";
+  report << " ]\n";
   
 }
 
@@ -866,7 +1038,7 @@ void dataset_t::write( std::ofstream & OUT1 )
   // First ID row
   //
   
-  std::cout << "1\tID\t.\t" << indivs.size() << "\t.\t.\tID\tIndividual ID";
+  std::cout << "1\tID\t.\t" << n_indivs() << "\t.\t.\tID\tIndividual ID";
 
   ff = factors.begin();
   while ( ff != factors.end() )
@@ -939,6 +1111,12 @@ void dataset_t::write( std::ofstream & OUT1 )
   //
   // Individual rows
   //
+
+  if ( spill != NULL )
+    {
+      spill->write( OUT1 , xvars );
+      return;
+    }
   
   std::set<indiv_t>::const_iterator ii = indivs.begin();
   while ( ii != indivs.end() )
@@ -963,6 +1141,217 @@ void dataset_t::write( std::ofstream & OUT1 )
 }
 
 
+//
+// Bounded-memory store
+//
+
+int spill_t::id( const std::string & s )
+{
+  std::map<std::string,int>::const_iterator ii = id2n.find( s );
+  if ( ii != id2n.end() ) return ii->second;
+  const int n = ids.size();
+  id2n[ s ] = n;
+  ids.push_back( s );
+  return n;
+}
+
+int spill_t::var( const std::string & s )
+{
+  std::map<std::string,int>::const_iterator ii = var2n.find( s );
+  if ( ii != var2n.end() ) return ii->second;
+  const int n = vars.size();
+  var2n[ s ] = n;
+  vars.push_back( s );
+  return n;
+}
+
+void spill_t::add( const int i , const int v , const std::string & value )
+{
+  buffer.resize( buffer.size() + 1 );
+  entry_t & e = buffer.back();
+  e.id = i;
+  e.var = v;
+  e.value = value;
+  if ( buffer.size() >= max_values ) flush();
+}
+
+void spill_t::flush()
+{
+
+  if ( buffer.size() == 0 ) return;
+
+  // sort by ID (as will be output)
+  const std::vector<std::string> & idx = ids;
+  std::sort( buffer.begin() , buffer.end() ,
+	     [&idx]( const entry_t & a , const entry_t & b ) { return idx[ a.id ] < idx[ b.id ]; } );
+
+  std::stringstream ss;
+  ss << root << "." << runs.size();
+  const std::string filename = ss.str();
+
+  std::ofstream OUT1( filename.c_str() , std::ios::out );
+  if ( ! OUT1.good() ) halt( "could not write to " + filename );
+  
+  for (int i=0; i<buffer.size(); i++)
+    OUT1 << ids[ buffer[i].id ] << "\t" << buffer[i].var << "\t" << buffer[i].value << "\n";
+  OUT1.close();
+  
+  std::cerr << " -- spilled " << buffer.size() << " values to " << filename << "\n";
+  
+  runs.push_back( filename );
+  std::vector<entry_t>().swap( buffer );
+
+  if ( runs.size() >= 256 ) compact();
+}
+
+void spill_t::compact()
+{
+
+  std::stringstream ss;
+  ss << root << ".m";
+  const std::string filename = ss.str();
+
+  std::ofstream OUT1( filename.c_str() , std::ios::out );
+  if ( ! OUT1.good() ) halt( "could not write to " + filename );
+  
+  const int k = runs.size();
+  std::vector<std::ifstream*> in( k );
+  std::vector<std::string> line( k ) , head_id( k );
+  std::vector<bool> head( k , false );
+  
+  for (int r=0; r<k; r++)
+    {
+      in[r] = new std::ifstream( runs[r].c_str() , std::ios::in );
+      safe_getline( *in[r] , line[r] );
+      head[r] = line[r] != "";
+      if ( head[r] ) head_id[r] = line[r].substr( 0 , line[r].find( '\t' ) );
+    }
+  
+  while ( 1 )
+    {
+      // next (lowest) ID across runs
+      int m = -1;
+      for (int r=0; r<k; r++)
+	if ( head[r] && ( m == -1 || head_id[r] < head_id[m] ) ) m = r;
+      if ( m == -1 ) break;
+
+      OUT1 << line[m] << "\n";
+      
+      safe_getline( *in[m] , line[m] );
+      head[m] = line[m] != "";
+      if ( head[m] ) head_id[m] = line[m].substr( 0 , line[m].find( '\t' ) );
+    }
+
+  OUT1.close();
+
+  for (int r=0; r<k; r++)
+    {
+      in[r]->close();
+      delete in[r];
+      std::remove( runs[r].c_str() );
+    }
+
+  // this becomes the first run
+  runs.clear();
+  runs.push_back( root + ".0" );
+  std::rename( filename.c_str() , runs[0].c_str() );
+  
+}
+
+void spill_t::write( std::ofstream & OUT1 , const std::set<var_t> & xvars )
+{
+
+  flush();
+  
+  // output column for each interned variable
+  std::vector<int> col( vars.size() , -1 );
+  int ncol = 0;
+  std::set<var_t>::const_iterator vv = xvars.begin();
+  while ( vv != xvars.end() )
+    {
+      std::map<std::string,int>::const_iterator kk = var2n.find( vv->name );
+      if ( kk != var2n.end() ) col[ kk->second ] = ncol;
+      ++ncol;
+      ++vv;
+    }
+
+  //
+  // k-way merge of the runs: each is sorted by ID, so for each ID (in
+  // order) we take all leading entries that match it
+  //
+  
+  const int k = runs.size();
+  
+  std::vector<std::ifstream*> in( k );
+  std::vector<std::string> head_id( k ) , head_value( k );
+  std::vector<int> head_var( k );
+  std::vector<bool> head( k , false );
+
+  for (int r=0; r<k; r++)
+    in[r] = new std::ifstream( runs[r].c_str() , std::ios::in );
+  
+  // read the next entry from run 'r'
+  auto advance = [&]( const int r ) {
+    head[r] = false;
+    std::string line;
+    safe_getline( *in[r] , line );
+    if ( line == "" ) return;
+    const size_t p1 = line.find( '\t' );
+    const size_t p2 = line.find( '\t' , p1 + 1 );
+    if ( p1 == std::string::npos || p2 == std::string::npos )
+      halt( "internal error, bad line in " + runs[r] );
+    head_id[r] = line.substr( 0 , p1 );
+    if ( ! str2int( line.substr( p1 + 1 , p2 - p1 - 1 ) , &head_var[r] ) )
+      halt( "internal error, bad line in " + runs[r] );
+    head_value[r] = line.substr( p2 + 1 );
+    head[r] = true;
+  };
+
+  for (int r=0; r<k; r++) advance( r );
+
+  std::vector<std::string> row( ncol );
+  std::vector<bool> obs( ncol );
+  
+  std::map<std::string,int>::const_iterator ii = id2n.begin();
+  while ( ii != id2n.end() )
+    {
+      const std::string & id = ii->first;
+
+      std::fill( obs.begin() , obs.end() , false );
+      
+      for (int r=0; r<k; r++)
+	{
+	  while ( head[r] && head_id[r] == id )
+	    {
+	      const int c = col[ head_var[r] ];
+	      if ( obs[c] )
+		halt( "multiple obervations for " + id
+		      + " for variable: " + vars[ head_var[r] ] );
+	      obs[c] = true;
+	      row[c].swap( head_value[r] );
+	      advance( r );
+	    }
+	}
+
+      OUT1 << id;
+      for (int c=0; c<ncol; c++)
+	OUT1 << "\t" << ( obs[c] ? row[c] : options.missing_data_outsymbol );
+      OUT1 << "\n";
+      
+      ++ii;
+    }
+  
+  // clean up
+  for (int r=0; r<k; r++)
+    {
+      in[r]->close();
+      delete in[r];
+      std::remove( runs[r].c_str() );
+    }
+  
+}
+
+
 void dataset_t::check_variables_across_domains()
 {
 
@@ -56,6 +56,10 @@ struct options_t {
     assume_txt = true;
     max_var_len = 100;
     numeric_strata_encoding = false;
+    nthreads = 1;
+    stream = false;
+    tmp_root = "";
+    max_values = 5000000;
   }
 
   bool verbose;
@@ -63,6 +67,10 @@ struct options_t {
   bool assume_txt; // only look at .txt files (i.e. requires that extension)
   int max_var_len;
   bool numeric_strata_encoding; // VAR.1, VAR.2 instead of VAR.FAC_LVL_FAC_LVL
+  int nthreads; // worker threads for parsing data files
+  bool stream; // bounded memory: spill values to disk, merge at the end
+  std::string tmp_root; // folder for spilled runs (default: next to output)
+  int max_values; // max. values held in memory (when streaming)
   std::set<std::string> skip_folders;
   std::string missing_data_outsymbol; // NA for output
   std::set<std::string> missing_data_symbol; // for input
@@ -343,8 +351,91 @@ struct indiv_t {
 
 
 
+//
+// A data file, parsed (possibly by a worker thread) before being
+// added to the dataset (always in file order)
+//
+
+struct parsed_cell_t {
+  parsed_cell_t() : var(NULL) , missing(true) { } 
+  const var_t * var;  // base variable
+  bool missing;
+  std::string value;
+};
+
+struct parsed_row_t {
+  std::vector<std::string> lvls; // factor levels
+  std::vector<parsed_cell_t> cells;
+};
+
+struct parsed_file_t {
+  parsed_file_t( const std::string & filename )
+    : filename(filename) , tracked(false) , added(false) { } 
+  std::string filename;
+  bool tracked; // counts as a file read
+  bool added;   // has data for this individual (even if all missing)
+  std::string id;
+  std::vector<std::string> facs;
+  std::vector<parsed_row_t> rows;
+  std::stringstream log;     // messages, as the file is parsed
+  std::stringstream report;  // summary, once added
+};
+
+
+//
+// Bounded-memory store of values (-stream): individual IDs and
+// (expanded) variable names are interned, values are buffered and
+// spilled to disk as runs sorted by ID, which are then merged in a
+// single streaming pass to give the output rows
+//
+
+struct spill_t {
+
+  spill_t( const std::string & root , const int max_values )
+    : root(root) , max_values(max_values) { } 
+
+  // interning
+  int id( const std::string & );
+  int var( const std::string & );
+  
+  void add( const int i , const int v , const std::string & value );
+
+  // sort and write buffered values as a new run
+  void flush();
+
+  // merge all runs into one (to bound the number of open files)
+  void compact();
+
+  // merge all runs, writing one row per individual, in ID order
+  void write( std::ofstream & , const std::set<var_t> & xvars );
+
+  int n_indivs() const { return ids.size(); }
+  
+private:
+
+  struct entry_t {
+    int id;
+    int var;
+    std::string value;
+  };
+  
+  std::string root;
+  int max_values;
+  
+  std::map<std::string,int> id2n;
+  std::vector<std::string> ids;
+  std::map<std::string,int> var2n;
+  std::vector<std::string> vars;
+
+  std::vector<entry_t> buffer;
+  std::vector<std::string> runs;
+};
+
+
 struct dataset_t {
 
+  dataset_t() : spill(NULL) { } 
+  
   void add( const domain_t & domain )
   {
     std::cerr << " ++ adding domain " << domain.name
@@ -354,11 +445,26 @@ struct dataset_t {
   }
   
   void read( const std::string & filename );
+
+  // all data files, parsed by options.nthreads workers
+  void read( const std::vector<std::string> & filenames );
+
+  // parse a single file: only reads dictionaries and options, so
+  // this can be called concurrently
+  void parse_file( parsed_file_t * ) const;
+
+  // add a parsed file (in order)
+  void add( parsed_file_t & );
   
   void write( std::ofstream & );
+
+  int n_indivs() const { return spill != NULL ? spill->n_indivs() : indivs.size(); }
   
   std::set<indiv_t> indivs;
 
+  // if streaming, values go here instead of 'indivs'
+  spill_t * spill;
+
   std::set<std::string> files;
 
   std::set<domain_t> domains;
@@ -30,6 +30,7 @@
 #include <cstring>
 
 #include "luna.h"
+#include "db/colstore.h"
 
 // #include "defs/defs.h"
 // #include "helper/helper.h"
@@ -272,6 +273,19 @@ int main(int argc , char ** argv )
 
   if ( argc < 2 ) 
     Helper::halt( "usage: destrat stout.db {-f|-d|-s|-v|-i|-r|-c|-n|-e}" );
+
+  //
+  // Columnar tables (luna -b) are simply decoded to text tables
+  //  destrat out/PSD_B_CH.lcol {out/PSD_F_CH.lcol ...}
+  //
+
+  if ( Helper::file_extension( argv[1] , "lcol" ) )
+    {
+      for (int i=1;i<argc;i++)
+	if ( ! colstore_t::dump( argv[i] , std::cout ) )
+	  Helper::halt( "could not open " + std::string( argv[i] ) );
+      std::exit(0);
+    }
   
   //
   // Get command line options